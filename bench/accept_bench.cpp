@@ -0,0 +1,281 @@
+// Connection storm against the chat server. Every connector loops connect -> TLS handshake -> reset for --duration
+// seconds, so this measures how fast the server accepts and handshakes, not how it moves data.
+// Compare the shared acceptor with one SO_REUSEPORT listener per worker by running with and without --reuseport.
+// --resume installs TlsResumption on both ends, so every connection after a connector's first one offers a ticket.
+// Connections then close with a TLS shutdown so the client reads the tickets the server sends after the handshake.
+// cpu_us_per_handshake covers client and server together since both run in this process.
+//
+// usage: cpp-coro-bench-accept [--reuseport] [--resume] [--threads=N] [--client-threads=N] [--connectors=64]
+//                              [--duration=5] [--port=9444]
+
+#include "bench_common.hpp"
+#include "log/logger.hpp"
+#include "socket_stuff.hpp"
+#include "tls_resumption.hpp"
+#include "utils.hpp"
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct Params
+{
+    bool m_reusePort;
+    bool m_resume;
+    size_t m_threads;
+    size_t m_clientThreads;
+    size_t m_connectors;
+    size_t m_durationSecs;
+    std::string m_port;
+};
+
+struct ConnectorStats
+{
+    size_t m_handshakes{ 0 };
+    size_t m_resumed{ 0 };
+    size_t m_failures{ 0 };
+    std::vector<double> m_connectMs{};
+    std::vector<double> m_handshakeMs{};
+};
+
+struct Result
+{
+    double m_elapsedSecs;
+    ConnectorStats m_total;
+};
+
+asio::awaitable<void> connector(
+    ssl::context& clientSsl,
+    asio::ip::tcp::endpoint ep,
+    Bench::Clock::time_point deadline,
+    ConnectorStats& stats
+)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    auto* resumption{ TlsResumption::Of(clientSsl.native_handle()) };
+    while (Bench::Clock::now() < deadline)
+    {
+        Bench::TlsStream stream{ exc, clientSsl };
+        try
+        {
+            if (resumption)
+            {
+                // the client cache is keyed by SNI
+                SSL_set_tlsext_host_name(stream.native_handle(), "localhost");
+                resumption->OfferSession(stream.native_handle(), "localhost");
+            }
+
+            const auto start{ Bench::Clock::now() };
+            co_await stream.next_layer().async_connect(ep);
+            const auto connected{ Bench::Clock::now() };
+            co_await stream.async_handshake(ssl::stream_base::client);
+            const auto done{ Bench::Clock::now() };
+
+            stats.m_handshakes++;
+            stats.m_connectMs.push_back(Bench::Millis(connected - start));
+            stats.m_handshakeMs.push_back(Bench::Millis(done - connected));
+
+            if (resumption)
+            {
+                resumption->RecordHandshake(stream.native_handle());
+                stats.m_resumed += SSL_session_reused(stream.native_handle()) == 1 ? 1 : 0;
+
+                // TLS 1.3 tickets arrive after the handshake and are read while waiting for the server's
+                // close_notify. a truncated shutdown still counts as a handshake
+                boost::system::error_code ec;
+                co_await stream.async_shutdown(asio::redirect_error(ec));
+            }
+        }
+        catch (const boost::system::system_error&)
+        {
+            stats.m_failures++;
+        }
+
+        // reset rather than close so the client side doesn't run out of ports to TIME_WAIT
+        boost::system::error_code ec;
+        stream.next_layer().set_option(asio::socket_base::linger{ true, 0 }, ec);
+        stream.next_layer().close(ec);
+    }
+}
+
+asio::awaitable<Result> run(ssl::context& clientSsl, Params params)
+{
+    const auto ep{ co_await Bench::wait_until_listening("localhost", params.m_port) };
+    auto exc{ co_await asio::this_coro::executor };
+
+    using ConnectorOp = decltype(asio::co_spawn(
+        std::declval<asio::any_io_executor>(), std::declval<asio::awaitable<void>>(), asio::deferred
+    ));
+
+    std::vector<ConnectorStats> stats(params.m_connectors);
+    std::vector<ConnectorOp> connectors{};
+    const auto start{ Bench::Clock::now() };
+    const auto deadline{ start + std::chrono::seconds{ params.m_durationSecs } };
+    for (auto& connectorStats : stats)
+    {
+        auto strand{ asio::make_strand(exc) };
+        connectors.push_back(
+            asio::co_spawn(strand, connector(clientSsl, ep, deadline, connectorStats), asio::deferred)
+        );
+    }
+
+    co_await asio::experimental::make_parallel_group(std::move(connectors))
+        .async_wait(asio::experimental::wait_for_all(), asio::deferred);
+
+    Result result{ .m_elapsedSecs = Bench::Seconds(Bench::Clock::now() - start), .m_total = {} };
+    for (auto& connectorStats : stats)
+    {
+        auto& total{ result.m_total };
+        total.m_handshakes += connectorStats.m_handshakes;
+        total.m_resumed += connectorStats.m_resumed;
+        total.m_failures += connectorStats.m_failures;
+        total.m_connectMs.insert(
+            total.m_connectMs.end(), connectorStats.m_connectMs.begin(), connectorStats.m_connectMs.end()
+        );
+        total.m_handshakeMs.insert(
+            total.m_handshakeMs.end(), connectorStats.m_handshakeMs.begin(), connectorStats.m_handshakeMs.end()
+        );
+    }
+
+    co_return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const size_t nThreads{ std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1) };
+    const Params params{
+        .m_reusePort = arg_or(args, "reuseport", false),
+        .m_resume = arg_or(args, "resume", false),
+        .m_threads = nThreads,
+        .m_clientThreads = std::max<size_t>(arg_or<size_t>(args, "client-threads", nThreads), 1),
+        .m_connectors = std::max<size_t>(arg_or<size_t>(args, "connectors", 64), 1),
+        .m_durationSecs = arg_or<size_t>(args, "duration", 5),
+        .m_port = arg_or<std::string>(args, "port", "9444"),
+    };
+
+    Sage::Logger::SetupLogger("", Sage::Logger::Level::Warning);
+
+    auto serverSsl{ Bench::MakeServerSslContext() };
+    auto clientSsl{ Bench::MakeClientSslContext() };
+    std::optional<TlsResumption> serverResumption{};
+    std::optional<TlsResumption> clientResumption{};
+    if (params.m_resume)
+    {
+        serverResumption.emplace(serverSsl);
+        clientResumption.emplace(clientSsl);
+    }
+
+    // server side, laid out the same way main() does it
+    asio::io_context serverCtx{ static_cast<int>(params.m_threads) };
+    std::vector<std::unique_ptr<asio::io_context>> workerCtxs{};
+    std::vector<asio::any_io_executor> workerExecutors{};
+    if (params.m_reusePort)
+    {
+        for (size_t idx{ 0 }; idx < params.m_threads; idx++)
+        {
+            workerCtxs.push_back(std::make_unique<asio::io_context>(1));
+            workerExecutors.push_back(workerCtxs.back()->get_executor());
+        }
+    }
+
+    asio::co_spawn(
+        serverCtx,
+        accept_client(
+            serverSsl,
+            ServerConfig{
+                .m_listenHost = "localhost",
+                .m_listenPort = params.m_port,
+                .m_shards = params.m_threads,
+                .m_reusePort = params.m_reusePort,
+            },
+            std::move(workerExecutors)
+        ),
+        detached_log_exception{ Sage::Logger::Level::Error }
+    );
+
+    std::vector<std::jthread> serverThreads{};
+    {
+        auto serverGuard{ asio::make_work_guard(serverCtx) };
+        for (size_t idx{ 0 }; idx < params.m_threads; idx++)
+        {
+            auto& runCtx{ workerCtxs.empty() ? serverCtx : *workerCtxs[idx] };
+            serverThreads.emplace_back(
+                [&runCtx]
+                {
+                    auto guard{ asio::make_work_guard(runCtx) };
+                    runCtx.run();
+                }
+            );
+        }
+        if (not workerCtxs.empty())
+        {
+            serverThreads.emplace_back([&serverCtx] { serverCtx.run(); });
+        }
+
+        asio::io_context clientCtx{ static_cast<int>(params.m_clientThreads) };
+        std::optional<Result> result{};
+        const auto cpuStart{ Bench::ProcessCpuTime() };
+        asio::co_spawn(
+            clientCtx,
+            run(clientSsl, params),
+            [&](std::exception_ptr e, Result res)
+            {
+                if (e)
+                {
+                    detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                    return;
+                }
+                result = std::move(res);
+            }
+        );
+        Bench::RunThreads(clientCtx, params.m_clientThreads);
+        const auto cpuUsed{ Bench::ProcessCpuTime() - cpuStart };
+
+        serverCtx.stop();
+        for (auto& workerCtx : workerCtxs)
+        {
+            workerCtx->stop();
+        }
+
+        if (not result)
+        {
+            return 1;
+        }
+
+        auto& total{ result->m_total };
+        const double handshakes{ static_cast<double>(total.m_handshakes) };
+        std::println(
+            R"({{"bench":"accept","backend":"{}","mode":"{}","resume":{},"threads":{},"connectors":{},)"
+            R"("elapsed_s":{:.3f},)"
+            R"("handshakes":{},"resumed":{},"failures":{},"accepts_per_s":{:.0f},"handshakes_per_s":{:.0f},)"
+            R"("cpu_us_per_handshake":{:.1f},)"
+            R"("connect_p50_ms":{:.3f},"connect_p99_ms":{:.3f},"handshake_p50_ms":{:.3f},"handshake_p99_ms":{:.3f}}})",
+            Bench::BACKEND,
+            params.m_reusePort ? "reuseport" : "shared",
+            params.m_resume,
+            params.m_threads,
+            params.m_connectors,
+            result->m_elapsedSecs,
+            total.m_handshakes,
+            total.m_resumed,
+            total.m_failures,
+            static_cast<double>(total.m_connectMs.size()) / result->m_elapsedSecs,
+            handshakes / result->m_elapsedSecs,
+            handshakes > 0 ? static_cast<double>(cpuUsed.count()) / handshakes : 0.0,
+            Bench::Percentile(total.m_connectMs, 0.50),
+            Bench::Percentile(total.m_connectMs, 0.99),
+            Bench::Percentile(total.m_handshakeMs, 0.50),
+            Bench::Percentile(total.m_handshakeMs, 0.99)
+        );
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Counts heap allocations by replacing the global operator new and delete. Replacements can't be inline, so include
+// this from exactly one file of a benchmark. Built with CPP_CORO_FRAME_ARENA, the arena's operator new counts them.
+
+#include "frame_arena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef CPP_CORO_FRAME_ARENA
+
+namespace Bench
+{
+
+// allocations by every thread so far
+inline size_t Allocations() noexcept { return FrameArena::Stats().m_allocations; }
+
+// the calls to malloc they took, most are served from the arenas
+inline size_t Mallocs() noexcept { return FrameArena::Stats().m_mallocs; }
+
+} // namespace Bench
+
+#else
+
+namespace Bench
+{
+
+inline std::atomic<size_t> g_allocations{ 0 };
+
+// allocations by every thread so far
+inline size_t Allocations() noexcept { return g_allocations.load(std::memory_order::relaxed); }
+
+// the calls to malloc they took, one each
+inline size_t Mallocs() noexcept { return Allocations(); }
+
+inline void* counted_alloc(size_t size, size_t alignment)
+{
+    g_allocations.fetch_add(1, std::memory_order::relaxed);
+    // aligned_alloc wants a multiple of the alignment
+    const size_t nBytes{ (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment };
+    void* ptr{ alignment <= alignof(std::max_align_t) ? std::malloc(nBytes) : std::aligned_alloc(alignment, nBytes) };
+    if (not ptr)
+    {
+        throw std::bad_alloc{};
+    }
+    return ptr;
+}
+
+} // namespace Bench
+
+void* operator new(size_t size) { return Bench::counted_alloc(size, alignof(std::max_align_t)); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return Bench::counted_alloc(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+namespace Bench
+{
+
+using Clock = std::chrono::steady_clock;
+using TlsStream = ssl::stream<asio::ip::tcp::socket>;
+
+// the reactor behind sockets and timers, see the CPP_CORO_IO_URING build option
+#ifdef BOOST_ASIO_HAS_IO_URING_AS_DEFAULT
+inline constexpr std::string_view BACKEND{ "io_uring" };
+#else
+inline constexpr std::string_view BACKEND{ "epoll" };
+#endif
+
+inline std::filesystem::path CertsDir()
+{
+    constexpr auto here{ std::source_location::current() };
+    return std::filesystem::path{ here.file_name() }.parent_path().parent_path() / "certs";
+}
+
+// Same setup main() uses for the server
+inline ssl::context MakeServerSslContext()
+{
+    ssl::context ctx{ ssl::context::tlsv13 };
+    ctx.set_default_verify_paths();
+    ctx.use_certificate_file(CertsDir() / "example.com.crt", ssl::context::file_format::pem);
+    ctx.use_private_key_file(CertsDir() / "example.com.key", ssl::context::file_format::pem);
+    ctx.set_verify_mode(ssl::verify_peer);
+    return ctx;
+}
+
+// Trusts the self signed example.com cert the server presents
+inline ssl::context MakeClientSslContext()
+{
+    ssl::context ctx{ ssl::context::tlsv13 };
+    ctx.load_verify_file(CertsDir() / "example.com.crt");
+    ctx.set_verify_mode(ssl::verify_peer);
+    return ctx;
+}
+
+// Connects and handshakes a client on its own strand
+inline asio::awaitable<TlsStream> connect_tls(ssl::context& sslCtx, std::string host, std::string port)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    asio::ip::tcp::resolver resolver{ exc };
+    auto resolved{ co_await resolver.async_resolve(host, port) };
+
+    TlsStream stream{ asio::make_strand(exc), sslCtx };
+    co_await asio::async_connect(stream.next_layer(), resolved);
+    stream.next_layer().set_option(asio::ip::tcp::no_delay{ true });
+    co_await stream.async_handshake(ssl::stream_base::client);
+
+    co_return stream;
+}
+
+// The server under test is spawned alongside the benchmark and might not be listening yet
+inline asio::awaitable<asio::ip::tcp::endpoint> wait_until_listening(std::string host, std::string port)
+{
+    using namespace std::chrono_literals;
+
+    auto exc{ co_await asio::this_coro::executor };
+    asio::ip::tcp::resolver resolver{ exc };
+    // resolved the same way accept_client() picks its endpoint
+    auto resolved{ co_await resolver.async_resolve(host, port, asio::ip::resolver_base::v4_mapped) };
+    const auto ep{ resolved.begin()->endpoint() };
+
+    asio::steady_timer timer{ exc };
+    for (int attempt{ 0 };; attempt++)
+    {
+        asio::ip::tcp::socket probe{ exc };
+        boost::system::error_code ec;
+        co_await probe.async_connect(ep, asio::redirect_error(ec));
+        if (not ec)
+        {
+            co_return ep;
+        }
+
+        if (attempt == 100)
+        {
+            throw boost::system::system_error{ ec };
+        }
+
+        timer.expires_after(20ms);
+        co_await timer.async_wait();
+    }
+}
+
+// Runs ctx on nThreads threads, including the caller, until it runs out of work or is stopped
+inline void RunThreads(asio::io_context& ctx, size_t nThreads)
+{
+    std::vector<std::jthread> threads{};
+    for (size_t idx{ 1 }; idx < nThreads; idx++)
+    {
+        threads.emplace_back([&ctx] { ctx.run(); });
+    }
+    ctx.run();
+}
+
+inline double Seconds(Clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+inline double Millis(Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+// user + system time used by every thread of this process so far
+inline std::chrono::microseconds ProcessCpuTime()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto toMicros{ [](const timeval& tv)
+                   { return std::chrono::seconds{ tv.tv_sec } + std::chrono::microseconds{ tv.tv_usec }; } };
+    return toMicros(usage.ru_utime) + toMicros(usage.ru_stime);
+}
+
+// pct in [0, 1]. Reorders samples
+inline double Percentile(std::vector<double>& samples, double pct)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+
+    auto nth{ samples.begin() + static_cast<ptrdiff_t>(pct * static_cast<double>(samples.size() - 1)) };
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+} // namespace Bench
@@ -0,0 +1,167 @@
+// Fan-out throughput of the chat server.
+// One publisher writes --messages of --size bytes while --clients - 1 peers read until they've seen every byte.
+//
+// usage: cpp-coro-bench-broadcast [--clients=1000] [--messages=10000] [--size=64] [--threads=N] [--port=9443]
+
+#include "bench_common.hpp"
+#include "log/logger.hpp"
+#include "socket_stuff.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <exception>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct Params
+{
+    size_t m_clients;
+    size_t m_messages;
+    size_t m_size;
+    size_t m_threads;
+    std::string m_port;
+};
+
+asio::awaitable<void> receive_bytes(Bench::TlsStream& client, size_t expected)
+{
+    std::array<char, 16 * 1024> buff{};
+    size_t received{ 0 };
+    while (received < expected)
+    {
+        received += co_await client.async_read_some(asio::buffer(buff));
+    }
+}
+
+asio::awaitable<void> publish(Bench::TlsStream& client, size_t nMessages, size_t msgSize)
+{
+    std::string payload(msgSize, 'x');
+    payload.back() = '\n';
+    for (size_t idx{ 0 }; idx < nMessages; idx++)
+    {
+        co_await asio::async_write(client, asio::buffer(payload));
+    }
+}
+
+asio::awaitable<double> run(ssl::context& clientSsl, Params params)
+{
+    std::vector<Bench::TlsStream> clients{};
+    clients.reserve(params.m_clients);
+
+    co_await Bench::wait_until_listening("localhost", params.m_port);
+    while (clients.size() < params.m_clients)
+    {
+        clients.push_back(co_await Bench::connect_tls(clientSsl, "localhost", params.m_port));
+    }
+
+    using ReceiveOp = decltype(asio::co_spawn(
+        std::declval<asio::any_io_executor>(), std::declval<asio::awaitable<void>>(), asio::deferred
+    ));
+
+    const size_t expected{ params.m_messages * params.m_size };
+    std::vector<ReceiveOp> receivers{};
+    for (auto& client : std::span{ clients }.subspan(1))
+    {
+        receivers.push_back(asio::co_spawn(client.get_executor(), receive_bytes(client, expected), asio::deferred));
+    }
+
+    auto start{ Bench::Clock::now() };
+    asio::co_spawn(
+        clients.front().get_executor(),
+        publish(clients.front(), params.m_messages, params.m_size),
+        detached_log_exception{ Sage::Logger::Level::Error }
+    );
+
+    auto [order, excs] = co_await asio::experimental::make_parallel_group(std::move(receivers))
+                             .async_wait(asio::experimental::wait_for_all(), asio::deferred);
+    auto elapsed{ Bench::Clock::now() - start };
+
+    for (const auto& e : excs)
+    {
+        if (e)
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+    co_return Bench::Seconds(elapsed);
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_clients = std::max<size_t>(arg_or<size_t>(args, "clients", 1000), 2),
+        .m_messages = arg_or<size_t>(args, "messages", 10'000),
+        .m_size = std::max<size_t>(arg_or<size_t>(args, "size", 64), 1),
+        .m_threads = arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()),
+        .m_port = arg_or<std::string>(args, "port", "9443"),
+    };
+
+    Sage::Logger::SetupLogger("", Sage::Logger::Level::Warning);
+
+    asio::io_context ctx{ static_cast<int>(params.m_threads) };
+    auto serverSsl{ Bench::MakeServerSslContext() };
+    auto clientSsl{ Bench::MakeClientSslContext() };
+
+    asio::co_spawn(
+        ctx,
+        accept_client(
+            serverSsl,
+            ServerConfig{
+                .m_listenHost = "localhost",
+                .m_listenPort = params.m_port,
+                .m_shards = params.m_threads,
+                // receivers count bytes, so nothing may be dropped
+                .m_outbound = OutboundLimits{ .m_policy = SlowConsumerPolicy::PauseProducers },
+                .m_framing = FramingConfig{ .m_maxFrameBytes = std::max<size_t>(params.m_size, 64 * 1024) },
+            }
+        ),
+        detached_log_exception{ Sage::Logger::Level::Error }
+    );
+
+    std::optional<double> elapsed{};
+    asio::co_spawn(
+        ctx,
+        run(clientSsl, params),
+        [&](std::exception_ptr e, double secs)
+        {
+            ctx.stop();
+            if (e)
+            {
+                detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                return;
+            }
+            elapsed = secs;
+        }
+    );
+
+    Bench::RunThreads(ctx, params.m_threads);
+    if (not elapsed)
+    {
+        return 1;
+    }
+
+    const double deliveries{ static_cast<double>(params.m_messages * (params.m_clients - 1)) };
+    std::println(
+        R"({{"bench":"broadcast","backend":"{}","clients":{},"messages":{},"size":{},"threads":{},"elapsed_s":{:.3f},)"
+        R"("deliveries":{:.0f},"publish_msgs_per_s":{:.0f},"deliveries_per_s":{:.0f},"delivered_mib_per_s":{:.1f}}})",
+        Bench::BACKEND,
+        params.m_clients,
+        params.m_messages,
+        params.m_size,
+        params.m_threads,
+        *elapsed,
+        deliveries,
+        static_cast<double>(params.m_messages) / *elapsed,
+        deliveries / *elapsed,
+        deliveries * static_cast<double>(params.m_size) / *elapsed / (1024.0 * 1024.0)
+    );
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Response cache lookups, and a self check of ResponseCache.
+// Checks fresh hits, expiry, revalidation with a 304, no-store, no-cache, Age, least recently used eviction and the
+// byte limit, one JSON line each. Then --entries fresh responses are looked up --lookups times over, from --threads
+// threads at once, to time a hit. Exits with 1 if any check failed. The expiry check sleeps for a second.
+//
+// usage: cpp-coro-bench-cache [--entries=1024] [--lookups=1000000] [--threads=<cores>]
+
+#include "bench_common.hpp"
+#include "response_cache.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <format>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using Request = ResponseCache::Request;
+using Response = ResponseCache::Response;
+
+constexpr std::string_view HOST{ "example.com" };
+
+struct Params
+{
+    size_t m_entries;
+    size_t m_lookups;
+    size_t m_threads;
+};
+
+Request make_request(std::string_view target)
+{
+    return Request{ beast::http::verb::get, target, 11 };
+}
+
+// a 200 with body, and cacheControl, etag and age unless they're empty
+Response make_response(
+    std::string_view body,
+    std::string_view cacheControl,
+    std::string_view etag = {},
+    std::string_view age = {}
+)
+{
+    Response res{ beast::http::status::ok, 11 };
+    res.body() = body;
+    if (not cacheControl.empty())
+    {
+        res.set(beast::http::field::cache_control, cacheControl);
+    }
+    if (not etag.empty())
+    {
+        res.set(beast::http::field::etag, etag);
+    }
+    if (not age.empty())
+    {
+        res.set(beast::http::field::age, age);
+    }
+    res.prepare_payload();
+    return res;
+}
+
+// what ResponseCache::Complete hands out for res to a fresh request for target
+Response store(ResponseCache& cache, std::string_view target, Response res)
+{
+    auto req{ make_request(target) };
+    cache.Prepare(std::string{ HOST }, req);
+    return cache.Complete(std::string{ HOST }, req, std::move(res));
+}
+
+// the fresh body for target, empty if the request has to go out
+std::string fresh_body(ResponseCache& cache, std::string_view target)
+{
+    auto req{ make_request(target) };
+    auto fresh{ cache.Prepare(std::string{ HOST }, req) };
+    return fresh ? fresh->body() : std::string{};
+}
+
+// the If-None-Match a stale entry for target puts on the request
+std::string validator(ResponseCache& cache, std::string_view target)
+{
+    auto req{ make_request(target) };
+    cache.Prepare(std::string{ HOST }, req);
+    return std::string{ req[beast::http::field::if_none_match] };
+}
+
+bool report_check(std::string_view check, bool ok)
+{
+    std::println(R"({{"bench":"cache","check":"{}","ok":{}}})", check, ok);
+    return ok;
+}
+
+bool check_fresh_hit()
+{
+    ResponseCache cache{};
+    store(cache, "/fresh", make_response("hello", "max-age=60"));
+    return fresh_body(cache, "/fresh") == "hello" and cache.Stats().m_fresh == 1 and validator(cache, "/fresh").empty();
+}
+
+bool check_expiry_and_not_modified()
+{
+    ResponseCache cache{};
+    store(cache, "/expiring", make_response("old body", "max-age=1", "\"v1\""));
+    const bool freshAtFirst{ fresh_body(cache, "/expiring") == "old body" };
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 1100 });
+    const bool expired{ fresh_body(cache, "/expiring").empty() };
+
+    auto req{ make_request("/expiring") };
+    cache.Prepare(std::string{ HOST }, req);
+    const bool conditional{ req[beast::http::field::if_none_match] == "\"v1\"" };
+
+    // a 304 carries no body, but may update the stored fields
+    Response notModified{ beast::http::status::not_modified, 11 };
+    notModified.set(beast::http::field::cache_control, "max-age=60");
+    notModified.set("x-revalidated", "yes");
+    const auto answer{ cache.Complete(std::string{ HOST }, req, std::move(notModified)) };
+    const bool served{ answer.result() == beast::http::status::ok and answer.body() == "old body" and
+                       answer["x-revalidated"] == "yes" };
+
+    return freshAtFirst and expired and conditional and served and fresh_body(cache, "/expiring") == "old body" and
+           cache.Stats().m_notModified == 1;
+}
+
+bool check_no_store()
+{
+    ResponseCache cache{};
+    store(cache, "/private", make_response("secret", "no-store, max-age=60", "\"v1\""));
+    return cache.Stats().m_entries == 0 and fresh_body(cache, "/private").empty() and
+           validator(cache, "/private").empty();
+}
+
+bool check_no_cache()
+{
+    ResponseCache cache{};
+    // kept, but asked about every time
+    store(cache, "/revalidate", make_response("body", "no-cache, max-age=60", "\"v2\""));
+    // neither validators nor a lifetime, nothing to keep
+    store(cache, "/pointless", make_response("body", ""));
+    return cache.Stats().m_entries == 1 and fresh_body(cache, "/revalidate").empty() and
+           validator(cache, "/revalidate") == "\"v2\"";
+}
+
+bool check_age()
+{
+    ResponseCache cache{};
+    store(cache, "/young", make_response("young", "max-age=60", {}, "30"));
+    store(cache, "/old", make_response("old", "max-age=60", "\"v3\"", "60"));
+    return fresh_body(cache, "/young") == "young" and fresh_body(cache, "/old").empty() and
+           validator(cache, "/old") == "\"v3\"";
+}
+
+bool check_lru_order()
+{
+    ResponseCache cache{ ResponseCacheConfig{ .m_maxEntries = 2 } };
+    store(cache, "/a", make_response("a", "max-age=60"));
+    store(cache, "/b", make_response("b", "max-age=60"));
+    // /a becomes the most recently used, so /b goes first
+    const bool touched{ fresh_body(cache, "/a") == "a" };
+    store(cache, "/c", make_response("c", "max-age=60"));
+    return touched and fresh_body(cache, "/a") == "a" and fresh_body(cache, "/b").empty() and
+           fresh_body(cache, "/c") == "c" and cache.Stats().m_evictions == 1;
+}
+
+bool check_byte_limit()
+{
+    const std::string body(400, 'x');
+    ResponseCache cache{ ResponseCacheConfig{ .m_maxBytes = 1000 } };
+    store(cache, "/too-large", make_response(std::string(2000, 'x'), "max-age=60"));
+    const bool skipped{ cache.Stats().m_entries == 0 };
+
+    store(cache, "/first", make_response(body, "max-age=60"));
+    store(cache, "/second", make_response(body, "max-age=60"));
+    // a third doesn't fit next to the other two
+    store(cache, "/third", make_response(body, "max-age=60"));
+    const auto stats{ cache.Stats() };
+    return skipped and stats.m_bytes <= 1000 and stats.m_entries == 2 and fresh_body(cache, "/first").empty() and
+           fresh_body(cache, "/third") == body;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_entries = std::max<size_t>(arg_or<size_t>(args, "entries", 1024), 1),
+        .m_lookups = std::max<size_t>(arg_or<size_t>(args, "lookups", 1'000'000), 1),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1),
+    };
+
+    bool ok{ true };
+    ok = report_check("fresh_hit", check_fresh_hit()) and ok;
+    ok = report_check("expiry_and_304", check_expiry_and_not_modified()) and ok;
+    ok = report_check("no_store", check_no_store()) and ok;
+    ok = report_check("no_cache", check_no_cache()) and ok;
+    ok = report_check("age", check_age()) and ok;
+    ok = report_check("lru_order", check_lru_order()) and ok;
+    ok = report_check("byte_limit", check_byte_limit()) and ok;
+
+    ResponseCache cache{ ResponseCacheConfig{ .m_maxEntries = params.m_entries } };
+    std::vector<std::string> targets{};
+    for (size_t idx{ 0 }; idx < params.m_entries; idx++)
+    {
+        targets.push_back(std::format("/item/{}", idx));
+        store(cache, targets.back(), make_response(std::string(512, 'x'), "max-age=3600", "\"v\""));
+    }
+
+    std::vector<std::jthread> threads{};
+    const auto start{ Bench::Clock::now() };
+    for (size_t idx{ 0 }; idx < params.m_threads; idx++)
+    {
+        threads.emplace_back(
+            [&, idx]
+            {
+                for (size_t lookup{ idx }; lookup < params.m_lookups; lookup += params.m_threads)
+                {
+                    auto req{ make_request(targets[lookup % targets.size()]) };
+                    [[maybe_unused]] auto fresh{ cache.Prepare(std::string{ HOST }, req) };
+                }
+            }
+        );
+    }
+    threads.clear();
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    const auto stats{ cache.Stats() };
+    const bool allFresh{ stats.m_fresh == params.m_lookups };
+    std::println(
+        R"({{"bench":"cache","entries":{},"lookups":{},"threads":{},"elapsed_s":{:.4f},"ns_per_lookup":{:.1f},)"
+        R"("all_fresh":{}}})",
+        params.m_entries,
+        params.m_lookups,
+        params.m_threads,
+        elapsed,
+        elapsed * 1e9 / static_cast<double>(params.m_lookups),
+        allFresh
+    );
+
+    return ok and allFresh ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Runs the same workloads on the epoll build (build/release) and the io_uring build (build/release-uring) and prints
+# each benchmark's JSON with the syscalls the run made added to it. Build both first:
+#   make bench loadgen bench-uring
+#
+# Syscalls are counted by perf (raw_syscalls:sys_enter) when it's allowed to, else by strace -c. strace slows the
+# process down a lot, so when it's used the throughput and latency numbers come from a separate, untraced run.
+#
+# usage: bench/compare_backends.sh [--threads=N]
+
+set -euo pipefail
+
+root="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+extra=("$@")
+
+# bench binary, its arguments and the JSON field holding the operation count syscalls are divided by
+workloads=(
+    "cpp-coro-loadgen --in-process --clients=500 --publishers=20 --rate=20000 --duration=10 --port=9450|deliveries"
+    "cpp-coro-bench-accept --duration=5 --port=9451|handshakes"
+    "cpp-coro-bench-timer --tasks=10000 --duration=5|ops"
+)
+
+if perf stat -x, -e raw_syscalls:sys_enter true >/dev/null 2>&1; then
+    counter=perf
+elif command -v strace >/dev/null; then
+    counter=strace
+else
+    echo "needs perf or strace to count syscalls" >&2
+    exit 1
+fi
+
+# prints the syscall count of the command, its stdout goes to the file in $1
+count_syscalls() {
+    local out="$1"
+    shift
+    local log
+    log="$(mktemp)"
+    if [[ "$counter" == perf ]]; then
+        perf stat -x, -o "$log" -e raw_syscalls:sys_enter -- "$@" >"$out"
+        awk -F, '/raw_syscalls:sys_enter/ { print $1 }' "$log"
+    else
+        strace -f -c -q -o "$log" -- "$@" >"$out"
+        awk '$NF == "total" { print $4 }' "$log"
+    fi
+    rm -f "$log"
+}
+
+json_field() {
+    grep -o "\"$2\":[0-9.]*" "$1" | head -n 1 | cut -d: -f2
+}
+
+for build in release release-uring; do
+    bin="$root/build/$build"
+    for workload in "${workloads[@]}"; do
+        cmd="${workload%|*}"
+        opsField="${workload#*|}"
+        read -r -a argv <<<"$cmd"
+        argv[0]="$bin/${argv[0]}"
+
+        result="$(mktemp)"
+        syscalls="$(count_syscalls "$result" "${argv[@]}" "${extra[@]}")"
+        if [[ "$counter" == strace ]]; then
+            "${argv[@]}" "${extra[@]}" >"$result"
+        fi
+
+        ops="$(json_field "$result" "$opsField")"
+        perOp="$(awk -v s="$syscalls" -v o="${ops:-0}" 'BEGIN { printf "%.3f", o > 0 ? s / o : 0 }')"
+        sed -e "s/}\$/,\"syscall_counter\":\"$counter\",\"syscalls\":$syscalls,\"syscalls_per_op\":$perOp}/" "$result"
+        rm -f "$result"
+    done
+done
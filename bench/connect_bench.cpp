@@ -0,0 +1,140 @@
+// Connect latency with a dead address listed first, the case happy_eyeballs_connect() exists for.
+// Two local listeners stand in for a host's resolved addresses: a live one, and a blackholed one whose accept queue
+// is full and never drained, so the kernel drops SYNs to it and connecting there hangs like a filtered address.
+// Every round connects to { blackholed, live } with happy_eyeballs_connect() and checks the live address won. One
+// more connect with asio::async_connect() and the same endpoints shows the old one-at-a-time behaviour, which never
+// gets past the first address before --timeout-ms runs out.
+// Exits with 1 when a round fails, times out or connects anywhere but the live address.
+//
+// usage: cpp-coro-bench-connect [--rounds=20] [--attempt-delay-ms=250] [--timeout-ms=2000]
+
+#include "bench_common.hpp"
+#include "happy_eyeballs.hpp"
+#include "log/logger.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <print>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+struct Params
+{
+    size_t m_rounds;
+    std::chrono::milliseconds m_attemptDelay;
+    std::chrono::milliseconds m_timeout;
+};
+
+struct Result
+{
+    std::vector<double> m_happyMs{};
+    size_t m_wrongWinner{ 0 };
+    size_t m_timedOut{ 0 };
+    double m_sequentialMs{ 0.0 };
+    bool m_sequentialConnected{ false };
+};
+
+asio::awaitable<Result> run(Params params)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    const asio::ip::address loopback{ asio::ip::address_v4::loopback() };
+
+    asio::ip::tcp::acceptor live{ exc, asio::ip::tcp::endpoint{ loopback, 0 } };
+    // a backlog of 0 still queues one connection. once it's taken the kernel drops every further SYN
+    asio::ip::tcp::acceptor blackholed{ exc };
+    blackholed.open(asio::ip::tcp::v4());
+    blackholed.bind(asio::ip::tcp::endpoint{ loopback, 0 });
+    blackholed.listen(0);
+    asio::ip::tcp::socket queueFiller{ exc };
+    queueFiller.connect(blackholed.local_endpoint());
+
+    const std::vector endpoints{ blackholed.local_endpoint(), live.local_endpoint() };
+
+    Result result{};
+    for (size_t round{ 0 }; round < params.m_rounds; round++)
+    {
+        const auto start{ Bench::Clock::now() };
+        auto res{ co_await (happy_eyeballs_connect(endpoints, params.m_attemptDelay) or timeout(params.m_timeout)) };
+        result.m_happyMs.push_back(Bench::Millis(Bench::Clock::now() - start));
+        if (res.index() == 1)
+        {
+            result.m_timedOut++;
+            continue;
+        }
+        if (std::get<0>(res).remote_endpoint() != live.local_endpoint())
+        {
+            result.m_wrongWinner++;
+        }
+
+        // keeps the live listener's queue from filling up
+        co_await live.async_accept();
+    }
+
+    const auto start{ Bench::Clock::now() };
+    asio::ip::tcp::socket sequential{ exc };
+    const auto res{
+        co_await (asio::async_connect(sequential, endpoints, asio::use_awaitable) or timeout(params.m_timeout))
+    };
+    result.m_sequentialMs = Bench::Millis(Bench::Clock::now() - start);
+    result.m_sequentialConnected = res.index() == 0;
+
+    co_return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 20), 1),
+        .m_attemptDelay = std::chrono::milliseconds{ arg_or<int64_t>(args, "attempt-delay-ms", 250) },
+        .m_timeout = std::chrono::milliseconds{ arg_or<int64_t>(args, "timeout-ms", 2000) },
+    };
+
+    asio::io_context ctx{ 1 };
+    std::optional<Result> result{};
+    asio::co_spawn(
+        ctx,
+        run(params),
+        [&](std::exception_ptr e, Result res)
+        {
+            if (e)
+            {
+                detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                return;
+            }
+            result = std::move(res);
+        }
+    );
+    ctx.run();
+
+    if (not result)
+    {
+        return 1;
+    }
+
+    auto& happyMs{ result->m_happyMs };
+    std::println(
+        R"({{"bench":"connect","backend":"{}","rounds":{},"attempt_delay_ms":{},"timeout_ms":{},"wrong_winner":{},)"
+        R"("timed_out":{},)"
+        R"("happy_p50_ms":{:.3f},"happy_max_ms":{:.3f},"sequential_connected":{},"sequential_ms":{:.3f}}})",
+        Bench::BACKEND,
+        params.m_rounds,
+        params.m_attemptDelay.count(),
+        params.m_timeout.count(),
+        result->m_wrongWinner,
+        result->m_timedOut,
+        Bench::Percentile(happyMs, 0.50),
+        Bench::Percentile(happyMs, 1.0),
+        result->m_sequentialConnected,
+        result->m_sequentialMs
+    );
+
+    return result->m_wrongWinner == 0 and result->m_timedOut == 0 ? 0 : 1;
+}
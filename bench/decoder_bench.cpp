@@ -0,0 +1,250 @@
+// Response body decoding throughput, and a self check of ContentDecoder.
+// --size bytes of JSON lines mixed with random runs are encoded as gzip, gzip in three members, zlib deflate, bare
+// deflate and brotli, then decoded fed 1 byte, 7 bytes, 1 KiB, 16 KiB and 1 MiB at a time, the way a body arrives in
+// reads. Every decode has to give back the original. Best of --rounds.
+// Then every encoding is checked to throw when truncated, the checksummed ones to throw when corrupted, the others
+// to at least survive it, and gzip to ignore what follows its last member. Exits with 1 if anything failed.
+//
+// usage: cpp-coro-bench-decoder [--size=4194304] [--rounds=3]
+
+#include "bench_common.hpp"
+#include "content_decoder.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <brotli/encode.h>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+constexpr size_t OUT_BYTES{ 16 * 1024 };
+constexpr std::array<size_t, 5> CHUNK_BYTES{ 1, 7, 1024, 16 * 1024, 1024 * 1024 };
+
+struct Params
+{
+    size_t m_size;
+    size_t m_rounds;
+};
+
+struct Encoded
+{
+    std::string_view m_name;
+    ContentEncoding m_encoding;
+    std::string m_data;
+    // a CRC or Adler-32 trailer catches corruption the format itself can't
+    bool m_checksummed;
+};
+
+// compressible like an API response, with incompressible runs so every block type shows up
+std::string make_payload(size_t size)
+{
+    std::mt19937 rng{ 42 };
+    std::string payload{};
+    payload.reserve(size + 256);
+    for (size_t idx{ 0 }; payload.size() < size; idx++)
+    {
+        if (rng() % 8 == 0)
+        {
+            for (size_t n{ 0 }; n < 256; n++)
+            {
+                payload.push_back(static_cast<char>(rng()));
+            }
+            continue;
+        }
+        payload += std::format(R"({{"id":{},"name":"user-{}","score":{}}})", idx, idx % 1000, rng() % 100'000);
+        payload.push_back('\n');
+    }
+    payload.resize(size);
+    return payload;
+}
+
+// windowBits as deflateInit2 takes them: +16 for gzip, negative for bare deflate
+std::string zlib_encode(std::string_view in, int windowBits)
+{
+    z_stream zs{};
+    if (deflateInit2(&zs, 6, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw std::runtime_error{ "deflateInit2 failed" };
+    }
+
+    std::string out(deflateBound(&zs, static_cast<uLong>(in.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int rc{ deflate(&zs, Z_FINISH) };
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END)
+    {
+        throw std::runtime_error{ "deflate failed" };
+    }
+    return out;
+}
+
+std::string brotli_encode(std::string_view in)
+{
+    size_t nBytes{ BrotliEncoderMaxCompressedSize(in.size()) };
+    std::string out(nBytes, '\0');
+    if (not BrotliEncoderCompress(
+            5,
+            BROTLI_DEFAULT_WINDOW,
+            BROTLI_MODE_GENERIC,
+            in.size(),
+            reinterpret_cast<const uint8_t*>(in.data()),
+            &nBytes,
+            reinterpret_cast<uint8_t*>(out.data())
+        ))
+    {
+        throw std::runtime_error{ "BrotliEncoderCompress failed" };
+    }
+    out.resize(nBytes);
+    return out;
+}
+
+// Fed chunkBytes at a time. Throws like ContentDecoder
+std::string decode(ContentEncoding encoding, std::string_view encoded, size_t chunkBytes)
+{
+    ContentDecoder decoder{ encoding, OUT_BYTES };
+    std::string out{};
+    for (size_t pos{ 0 }; pos < encoded.size(); pos += chunkBytes)
+    {
+        decoder.Feed(encoded.substr(pos, chunkBytes));
+        for (auto piece{ decoder.Next() }; not piece.empty(); piece = decoder.Next())
+        {
+            out.append(piece.data(), piece.size());
+        }
+    }
+    decoder.Finish();
+    return out;
+}
+
+bool throws(ContentEncoding encoding, std::string_view encoded)
+{
+    try
+    {
+        decode(encoding, encoded, 1024);
+        return false;
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+}
+
+bool report_check(std::string_view check, std::string_view encoding, bool ok)
+{
+    std::println(R"({{"bench":"decoder","check":"{}","encoding":"{}","ok":{}}})", check, encoding, ok);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_size = std::max<size_t>(arg_or<size_t>(args, "size", 4 * 1024 * 1024), 1),
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 3), 1),
+    };
+
+    const std::string payload{ make_payload(params.m_size) };
+    const std::string_view whole{ payload };
+    const size_t third{ payload.size() / 3 };
+    std::vector<Encoded> encodings{};
+    encodings.push_back({ "gzip", ContentEncoding::Gzip, zlib_encode(whole, MAX_WBITS + 16), true });
+    encodings.push_back(
+        { "gzip_members",
+          ContentEncoding::Gzip,
+          zlib_encode(whole.substr(0, third), MAX_WBITS + 16) +
+              zlib_encode(whole.substr(third, third), MAX_WBITS + 16) +
+              zlib_encode(whole.substr(2 * third), MAX_WBITS + 16),
+          true }
+    );
+    encodings.push_back({ "deflate", ContentEncoding::Deflate, zlib_encode(whole, MAX_WBITS), true });
+    encodings.push_back({ "deflate_raw", ContentEncoding::Deflate, zlib_encode(whole, -MAX_WBITS), false });
+    encodings.push_back({ "br", ContentEncoding::Brotli, brotli_encode(whole), false });
+
+    bool ok{ true };
+    for (const auto& encoded : encodings)
+    {
+        for (size_t chunkBytes : CHUNK_BYTES)
+        {
+            double best{ 0.0 };
+            bool roundTrip{ true };
+            for (size_t round{ 0 }; round < params.m_rounds; round++)
+            {
+                const auto start{ Bench::Clock::now() };
+                std::string decoded{};
+                try
+                {
+                    decoded = decode(encoded.m_encoding, encoded.m_data, chunkBytes);
+                }
+                catch (const std::runtime_error& e)
+                {
+                    std::println(stderr, "{} in {} byte chunks: {}", encoded.m_name, chunkBytes, e.what());
+                }
+                const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+                roundTrip = roundTrip and decoded == payload;
+                if (round == 0 or elapsed < best)
+                {
+                    best = elapsed;
+                }
+            }
+
+            std::println(
+                R"({{"bench":"decoder","encoding":"{}","chunk_bytes":{},"encoded_bytes":{},"decoded_bytes":{},)"
+                R"("elapsed_s":{:.4f},"decoded_mib_per_s":{:.1f},"ok":{}}})",
+                encoded.m_name,
+                chunkBytes,
+                encoded.m_data.size(),
+                payload.size(),
+                best,
+                static_cast<double>(payload.size()) / (1024.0 * 1024.0) / best,
+                roundTrip
+            );
+            ok = ok and roundTrip;
+        }
+    }
+
+    for (const auto& encoded : encodings)
+    {
+        const std::string_view data{ encoded.m_data };
+        const bool truncated{ throws(encoded.m_encoding, data.substr(0, data.size() - 1)) and
+                              throws(encoded.m_encoding, data.substr(0, data.size() / 2)) };
+        ok = report_check("truncated", encoded.m_name, truncated) and ok;
+
+        std::string corrupt{ encoded.m_data };
+        corrupt[corrupt.size() / 2] = static_cast<char>(corrupt[corrupt.size() / 2] ^ 0x55);
+        bool detected{ true };
+        try
+        {
+            const bool differs{ decode(encoded.m_encoding, corrupt, 1024) != payload };
+            // without a checksum a flipped bit may decode without complaint, only to something else
+            detected = differs and not encoded.m_checksummed;
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+        ok = report_check("corrupt", encoded.m_name, detected) and ok;
+    }
+
+    // servers pad, or append junk after the last member
+    std::string padded{ encodings.front().m_data + std::string(64, '\0') };
+    bool trailing{ false };
+    try
+    {
+        trailing = decode(ContentEncoding::Gzip, padded, 7) == payload;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    ok = report_check("trailing_bytes", "gzip", trailing) and ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// Event passing through a channel between two coroutines on one thread, the way an event bus would.
+// A producer sends --events events through a channel with room for --queue of them to a consumer, in three ways:
+//   unique  a std::make_unique per event and one resume of the consumer per event, what channel_stuff used to do
+//   pooled  events from EventPool, taken up to --batch per resume of the consumer
+//   value   events copied into the channel, taken up to --batch per resume
+// Reports events per second, heap allocations per event, counted by replacing operator new, and consumer resumes
+// per event. Best of --rounds.
+//
+// usage: cpp-coro-bench-event [--events=2000000] [--queue=1024] [--batch=64] [--rounds=3]
+
+#include "alloc_counter.hpp"
+#include "bench_common.hpp"
+#include "channel_stuff.hpp"
+#include "event_pool.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <print>
+#include <span>
+#include <string_view>
+#include <vector>
+
+struct Params
+{
+    size_t m_events;
+    size_t m_queue;
+    size_t m_batch;
+    size_t m_rounds;
+};
+
+// what a bus carries: where it goes, its place in the stream and a small payload
+struct BenchEvent
+{
+    uint32_t m_topic;
+    uint64_t m_seq;
+    std::array<char, 48> m_payload;
+};
+
+struct Totals
+{
+    size_t m_received{ 0 };
+    size_t m_resumes{ 0 };
+    // keeps the events from being optimised away, and checks none went missing
+    uint64_t m_seqSum{ 0 };
+};
+
+struct RunResult
+{
+    double m_elapsedSecs;
+    size_t m_allocations;
+    size_t m_resumes;
+    bool m_complete;
+};
+
+const BenchEvent& event_of(const BenchEvent& event) { return event; }
+
+template<typename Ptr> const BenchEvent& event_of(const Ptr& event) { return *event; }
+
+template<typename T, typename Make>
+asio::awaitable<void> produce(Channel<T>& ch, size_t nEvents, bool batched, Make make)
+{
+    for (size_t seq{ 0 }; seq < nEvents; seq++)
+    {
+        if (batched)
+        {
+            co_await send_or_wait(ch, make(seq));
+        }
+        else
+        {
+            co_await ch.async_send(boost::system::error_code{}, make(seq));
+        }
+    }
+}
+
+template<typename T> asio::awaitable<void> consume(Channel<T>& ch, size_t nEvents, size_t batch, Totals& totals)
+{
+    std::vector<T> events{};
+    events.reserve(batch);
+    while (totals.m_received < nEvents)
+    {
+        events.clear();
+        if (batch > 1)
+        {
+            co_await receive_batch(ch, events, batch);
+        }
+        else
+        {
+            events.push_back(co_await ch.async_receive());
+        }
+        totals.m_resumes++;
+
+        for (const auto& event : events)
+        {
+            totals.m_seqSum += event_of(event).m_seq;
+            totals.m_received++;
+        }
+    }
+}
+
+template<typename T, typename Make> RunResult run(const Params& params, bool batched, Make make)
+{
+    asio::io_context ctx{ 1 };
+    Channel<T> ch{ ctx, params.m_queue };
+    Totals totals{};
+
+    const size_t allocationsBefore{ Bench::Allocations() };
+    const auto start{ Bench::Clock::now() };
+    asio::co_spawn(ctx, produce(ch, params.m_events, batched, make), asio::detached);
+    asio::co_spawn(ctx, consume(ch, params.m_events, batched ? params.m_batch : 1, totals), asio::detached);
+    ctx.run();
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    const uint64_t expectedSum{ params.m_events * (params.m_events - 1) / 2 };
+    return RunResult{
+        .m_elapsedSecs = elapsed,
+        .m_allocations = Bench::Allocations() - allocationsBefore,
+        .m_resumes = totals.m_resumes,
+        .m_complete = totals.m_received == params.m_events and totals.m_seqSum == expectedSum,
+    };
+}
+
+template<typename T, typename Make>
+bool report(std::string_view mode, const Params& params, bool batched, Make make)
+{
+    RunResult best{ .m_elapsedSecs = 0.0, .m_allocations = 0, .m_resumes = 0, .m_complete = true };
+    bool complete{ true };
+    for (size_t round{ 0 }; round < params.m_rounds; round++)
+    {
+        auto result{ run<T>(params, batched, make) };
+        complete = complete and result.m_complete;
+        if (round == 0 or result.m_elapsedSecs < best.m_elapsedSecs)
+        {
+            best = result;
+        }
+    }
+
+    const auto nEvents{ static_cast<double>(params.m_events) };
+    std::println(
+        R"({{"bench":"event","mode":"{}","events":{},"queue":{},"batch":{},"elapsed_s":{:.4f},)"
+        R"("events_per_s":{:.0f},"ns_per_event":{:.1f},"allocations_per_event":{:.4f},"resumes_per_event":{:.4f},)"
+        R"("complete":{}}})",
+        mode,
+        params.m_events,
+        params.m_queue,
+        batched ? params.m_batch : 1,
+        best.m_elapsedSecs,
+        nEvents / best.m_elapsedSecs,
+        best.m_elapsedSecs * 1e9 / nEvents,
+        static_cast<double>(best.m_allocations) / nEvents,
+        static_cast<double>(best.m_resumes) / nEvents,
+        complete
+    );
+    return complete;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_events = std::max<size_t>(arg_or<size_t>(args, "events", 2'000'000), 1),
+        .m_queue = std::max<size_t>(arg_or<size_t>(args, "queue", 1024), 1),
+        .m_batch = std::max<size_t>(arg_or<size_t>(args, "batch", 64), 1),
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 3), 1),
+    };
+
+    auto makeEvent{ [](size_t seq) { return BenchEvent{ .m_topic = 7, .m_seq = seq, .m_payload = {} }; } };
+
+    const bool uniqueOk{ report<std::unique_ptr<BenchEvent>>(
+        "unique", params, false, [&](size_t seq) { return std::make_unique<BenchEvent>(makeEvent(seq)); }
+    ) };
+    const bool pooledOk{ report<PooledEvent<BenchEvent>>(
+        "pooled", params, true, [&](size_t seq) { return make_pooled_event<BenchEvent>(makeEvent(seq)); }
+    ) };
+    const bool valueOk{ report<BenchEvent>("value", params, true, makeEvent) };
+
+    return uniqueOk and pooledOk and valueOk ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Frame parsing throughput, no sockets involved.
+// A stream of --frames frames of --size bytes on average is fed to FrameParser --read bytes at a time, the way
+// async_read_some would hand it over, and every frame is pulled out. Runs both framing modes and also times the
+// newline scan on its own against a byte at a time loop.
+//
+// usage: cpp-coro-bench-framing [--frames=1000000] [--size=64] [--read=16384] [--rounds=5]
+
+#include "bench_common.hpp"
+#include "frame_parser.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <print>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+struct Params
+{
+    size_t m_frames;
+    size_t m_size;
+    size_t m_readBytes;
+    size_t m_rounds;
+};
+
+// frame sizes vary between half and one and a half times the average so reads split frames at every offset
+std::string make_stream(FramingMode mode, const Params& params)
+{
+    std::mt19937 rng{ 42 };
+    std::uniform_int_distribution<size_t> sizes{ std::max<size_t>(params.m_size / 2, 1), params.m_size * 3 / 2 };
+
+    std::string stream{};
+    stream.reserve(params.m_frames * (params.m_size + FrameParser::LENGTH_PREFIX_BYTES));
+    for (size_t idx{ 0 }; idx < params.m_frames; idx++)
+    {
+        const size_t size{ sizes(rng) };
+        if (mode == FramingMode::LengthPrefixed)
+        {
+            for (int shift{ 24 }; shift >= 0; shift -= 8)
+            {
+                stream.push_back(static_cast<char>((size >> shift) & 0xff));
+            }
+            stream.append(size, 'x');
+        }
+        else
+        {
+            stream.append(size - 1, 'x');
+            stream.push_back('\n');
+        }
+    }
+
+    return stream;
+}
+
+struct ParseResult
+{
+    double m_elapsedSecs;
+    size_t m_frames;
+    size_t m_payloadBytes;
+};
+
+ParseResult parse_stream(FramingMode mode, std::string_view stream, const Params& params)
+{
+    FrameParser parser{ FramingConfig{ .m_mode = mode, .m_maxFrameBytes = params.m_size * 2 } };
+    ParseResult result{ .m_elapsedSecs = 0.0, .m_frames = 0, .m_payloadBytes = 0 };
+
+    const auto start{ Bench::Clock::now() };
+    for (size_t offset{ 0 }; offset < stream.size();)
+    {
+        // stands in for the kernel copying a read into the buffer
+        auto space{ parser.Prepare() };
+        const size_t nBytes{ std::min({ space.size(), params.m_readBytes, stream.size() - offset }) };
+        std::memcpy(space.data(), stream.data() + offset, nBytes);
+        parser.Commit(nBytes);
+        offset += nBytes;
+
+        while (auto frame{ parser.Next() })
+        {
+            result.m_frames++;
+            result.m_payloadBytes += frame->m_payload.size();
+        }
+    }
+    result.m_elapsedSecs = Bench::Seconds(Bench::Clock::now() - start);
+
+    return result;
+}
+
+// newlines found per second scanning the whole stream
+template <typename Scan>
+double scan_rate(std::string_view stream, Scan scan)
+{
+    size_t found{ 0 };
+    const auto start{ Bench::Clock::now() };
+    for (size_t offset{ 0 }; offset < stream.size(); found++)
+    {
+        offset += scan(stream.substr(offset)) + 1;
+    }
+
+    return static_cast<double>(found) / Bench::Seconds(Bench::Clock::now() - start);
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_frames = std::max<size_t>(arg_or<size_t>(args, "frames", 1'000'000), 1),
+        .m_size = std::max<size_t>(arg_or<size_t>(args, "size", 64), 2),
+        .m_readBytes = std::max<size_t>(arg_or<size_t>(args, "read", 16 * 1024), 1),
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 5), 1),
+    };
+
+    for (auto mode : { FramingMode::Newline, FramingMode::LengthPrefixed })
+    {
+        const auto stream{ make_stream(mode, params) };
+
+        // best of the rounds, the first one also pays for faulting the buffer in
+        ParseResult best{ .m_elapsedSecs = 0.0, .m_frames = 0, .m_payloadBytes = 0 };
+        for (size_t round{ 0 }; round < params.m_rounds; round++)
+        {
+            auto result{ parse_stream(mode, stream, params) };
+            if (round == 0 or result.m_elapsedSecs < best.m_elapsedSecs)
+            {
+                best = result;
+            }
+        }
+
+        std::println(
+            R"({{"bench":"framing","mode":"{}","frames":{},"size":{},"read":{},"elapsed_s":{:.4f},)"
+            R"("frames_per_s":{:.0f},"mib_per_s":{:.1f}}})",
+            to_string(mode),
+            best.m_frames,
+            params.m_size,
+            params.m_readBytes,
+            best.m_elapsedSecs,
+            static_cast<double>(best.m_frames) / best.m_elapsedSecs,
+            static_cast<double>(stream.size()) / best.m_elapsedSecs / (1024.0 * 1024.0)
+        );
+    }
+
+    const auto lines{ make_stream(FramingMode::Newline, params) };
+    const double vectorised{ scan_rate(lines, [](std::string_view data) { return find_newline(data); }) };
+    const double bytewise{ scan_rate(
+        lines,
+        [](std::string_view data)
+        {
+            size_t idx{ 0 };
+            while (idx < data.size() and data[idx] != '\n')
+            {
+                idx++;
+            }
+            return idx;
+        }
+    ) };
+    std::println(
+        R"({{"bench":"newline_scan","size":{},"find_newline_per_s":{:.0f},"bytewise_per_s":{:.0f}}})",
+        params.m_size,
+        vectorised,
+        bytewise
+    );
+
+    return 0;
+}
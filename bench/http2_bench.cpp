@@ -0,0 +1,170 @@
+// Concurrent GETs through HttpsPool, by default multiplexed over HTTP/2.
+// --concurrency workers share --requests GETs of --path, so with HTTP/2 that many streams are in flight on a single
+// connection where HTTP/1.1 opens a connection, and a handshake, per concurrent request. Every response has to be a
+// 200 of --expect-bytes bytes (when given) or it counts as a failure, and any failure makes the exit status 1.
+// --http1 stops offering h2, for comparing against a server that also speaks HTTP/1.1.
+// bench/http2_standin.sh runs this against nghttpd, a standalone h2 server, on this machine.
+//
+// usage: cpp-coro-bench-http2 [--host=localhost] [--port=9460] [--path=/] [--requests=1000] [--concurrency=100]
+//                             [--expect-bytes=N] [--http1] [--threads=1]
+
+#include "bench_common.hpp"
+#include "dns_cache.hpp"
+#include "https_pool.hpp"
+#include "latency_histogram.hpp"
+#include "log/logger.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Params
+{
+    std::string m_host;
+    std::string m_port;
+    std::string m_path;
+    size_t m_requests;
+    size_t m_concurrency;
+    std::optional<size_t> m_expectBytes;
+    bool m_http1;
+    size_t m_threads;
+};
+
+// only ever touched from the worker's strand until the run is over
+struct WorkerStats
+{
+    size_t m_ok{ 0 };
+    size_t m_failures{ 0 };
+    size_t m_bodyBytes{ 0 };
+    Bench::LatencyHistogram m_latency{};
+};
+
+asio::awaitable<void> worker(HttpsPool& pool, const Params& params, std::atomic<size_t>& next, WorkerStats& stats)
+{
+    HttpsPool::Request req{ beast::http::verb::get, params.m_path, 11 };
+    req.set(beast::http::field::host, params.m_host);
+    req.set(beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+
+    while (next.fetch_add(1, std::memory_order::relaxed) < params.m_requests)
+    {
+        const auto start{ Bench::Clock::now() };
+        try
+        {
+            auto res{ co_await pool.Send(params.m_host, req) };
+            stats.m_latency.Record(Bench::Clock::now() - start);
+            stats.m_bodyBytes += res.body().size();
+            const bool sizeOk{ not params.m_expectBytes or res.body().size() == *params.m_expectBytes };
+            if (res.result() == beast::http::status::ok and sizeOk)
+            {
+                stats.m_ok++;
+                continue;
+            }
+            LOG_WARNING("unexpected response: {} with {} bytes", res.result_int(), res.body().size());
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING("request failed. {}", e.what());
+        }
+        stats.m_failures++;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const auto expectBytes{ find_arg(args, "expect-bytes") };
+    const Params params{
+        .m_host = arg_or<std::string>(args, "host", "localhost"),
+        .m_port = arg_or<std::string>(args, "port", "9460"),
+        .m_path = arg_or<std::string>(args, "path", "/"),
+        .m_requests = arg_or<size_t>(args, "requests", 1000),
+        .m_concurrency = std::max<size_t>(arg_or<size_t>(args, "concurrency", 100), 1),
+        .m_expectBytes = expectBytes ? std::optional{ arg_or<size_t>(args, "expect-bytes", 0) } : std::nullopt,
+        .m_http1 = arg_or<bool>(args, "http1", false),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", 1), 1),
+    };
+
+    asio::io_context ctx{ static_cast<int>(params.m_threads) };
+    auto clientSsl{ Bench::MakeClientSslContext() };
+    HttpsPool pool{
+        clientSsl,
+        std::make_shared<DnsCache>(),
+        HttpsPoolConfig{
+            .m_http2 = not params.m_http1,
+            .m_service = params.m_port,
+            .m_maxIdlePerHost = params.m_concurrency,
+        },
+    };
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> running{ params.m_concurrency };
+    std::vector<WorkerStats> stats(params.m_concurrency);
+    for (auto& workerStats : stats)
+    {
+        asio::co_spawn(
+            asio::make_strand(ctx),
+            worker(pool, params, next, workerStats),
+            [&](std::exception_ptr e)
+            {
+                if (e)
+                {
+                    detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                }
+                // the HTTP/2 connection's reader would keep the context running forever
+                if (running.fetch_sub(1) == 1)
+                {
+                    ctx.stop();
+                }
+            }
+        );
+    }
+
+    const auto start{ Bench::Clock::now() };
+    Bench::RunThreads(ctx, params.m_threads);
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    WorkerStats total{};
+    for (const auto& workerStats : stats)
+    {
+        total.m_ok += workerStats.m_ok;
+        total.m_failures += workerStats.m_failures;
+        total.m_bodyBytes += workerStats.m_bodyBytes;
+        total.m_latency.Merge(workerStats.m_latency);
+    }
+
+    const auto poolStats{ pool.Stats() };
+    auto millis{ [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1e6; } };
+    std::println(
+        R"({{"bench":"http2","backend":"{}","protocol":"{}","requests":{},"concurrency":{},"threads":{},)"
+        R"("elapsed_s":{:.3f},"ok":{},"failures":{},"requests_per_s":{:.0f},"body_bytes":{},)"
+        R"("connects":{},"http2_connections":{},"http2_streams":{},)"
+        R"("latency_p50_ms":{:.3f},"latency_p99_ms":{:.3f},"latency_max_ms":{:.3f}}})",
+        Bench::BACKEND,
+        params.m_http1 ? "http/1.1" : "h2",
+        params.m_requests,
+        params.m_concurrency,
+        params.m_threads,
+        elapsed,
+        total.m_ok,
+        total.m_failures,
+        static_cast<double>(total.m_ok) / elapsed,
+        total.m_bodyBytes,
+        poolStats.m_connects,
+        poolStats.m_http2Connections,
+        poolStats.m_http2Streams,
+        millis(total.m_latency.Percentile(0.50)),
+        millis(total.m_latency.Percentile(0.99)),
+        millis(total.m_latency.Max())
+    );
+
+    return total.m_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#!/usr/bin/env bash
+# Runs cpp-coro-bench-http2 against a local HTTP/2 server, nghttpd from nghttp2, serving one file of $BODY_BYTES
+# random bytes with the repo's example.com certificate. Every response is checked for status and size, so this doubles
+# as the end to end test of the HTTP/2 client: the exit status is the benchmark's. Build first:
+#   make bench
+#
+# nghttpd only speaks h2, so --http1 doesn't work against it.
+#
+# Not covered: nghttpd has no way to send GOAWAY on demand, so a connection closing once the streams a GOAWAY left it
+# have drained is only seen in the debug log ("http2 connection drained") of a run against a server that sends one,
+# e.g. nginx with keepalive_requests set below --requests.
+#
+# usage: bench/http2_standin.sh [cpp-coro-bench-http2 arguments, e.g. --requests=5000 --concurrency=200]
+
+set -euo pipefail
+
+root="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+bin="${BIN_DIR:-$root/build/release}"
+port="${PORT:-9460}"
+bodyBytes="${BODY_BYTES:-100000}"
+
+if ! command -v nghttpd >/dev/null; then
+    echo "needs nghttpd (nghttp2) on PATH" >&2
+    exit 1
+fi
+
+docs="$(mktemp -d)"
+head -c "$bodyBytes" /dev/urandom >"$docs/blob"
+nghttpd --htdocs="$docs" "$port" "$root/certs/example.com.key" "$root/certs/example.com.crt" &
+server=$!
+trap 'kill "$server" 2>/dev/null; rm -rf "$docs"' EXIT
+
+for _ in $(seq 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+"$bin/cpp-coro-bench-http2" --port="$port" --path=/blob --expect-bytes="$bodyBytes" "$@"
@@ -0,0 +1,86 @@
+// Cost of idle timeout bookkeeping per read, no sockets involved.
+// --connections watches are registered on an IdleWheel and touched round robin --reads times in total. The same
+// number of reads is then done the old way, arming a fresh steady_timer per read and cancelling it when the read
+// "completes". Finally every watch is left idle and the wheel is run until all of them have expired, which includes
+// their 50ms timeout.
+//
+// usage: cpp-coro-bench-idle [--connections=100000] [--reads=10000000]
+
+#include "bench_common.hpp"
+#include "idle_wheel.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <print>
+#include <span>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const size_t nConnections{ std::max<size_t>(arg_or<size_t>(args, "connections", 100'000), 1) };
+    const size_t nReads{ std::max<size_t>(arg_or<size_t>(args, "reads", 10'000'000), 1) };
+
+    // a short tick so the expiry pass finishes quickly, the per read cost doesn't depend on it
+    constexpr auto TICK{ 1ms };
+    auto wheel{ std::make_shared<IdleWheel>(TICK) };
+    std::atomic<size_t> expired{ 0 };
+    std::vector<std::shared_ptr<IdleWatch>> watches{};
+    watches.reserve(nConnections);
+    for (size_t idx{ 0 }; idx < nConnections; idx++)
+    {
+        watches.push_back(wheel->Watch(50ms, [&expired] { expired.fetch_add(1, std::memory_order::relaxed); }));
+    }
+
+    auto start{ Bench::Clock::now() };
+    for (size_t idx{ 0 }; idx < nReads; idx++)
+    {
+        watches[idx % nConnections]->Touch();
+    }
+    const double wheelSecs{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    // what `async_read_some(...) or timeout(1min)` used to cost in timers alone
+    asio::io_context timerCtx{ 1 };
+    std::vector<asio::steady_timer> timers{};
+    for (size_t idx{ 0 }; idx < std::min<size_t>(nConnections, 1024); idx++)
+    {
+        timers.emplace_back(timerCtx);
+    }
+
+    start = Bench::Clock::now();
+    for (size_t idx{ 0 }; idx < nReads; idx++)
+    {
+        auto& timer{ timers[idx % timers.size()] };
+        timer.expires_after(1min);
+        timer.async_wait([](boost::system::error_code) {});
+        timer.cancel();
+        timerCtx.poll();
+    }
+    const double timerSecs{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    // nothing touches them anymore, time how long the wheel takes to notice
+    asio::io_context wheelCtx{ 1 };
+    asio::co_spawn(wheelCtx, wheel->Run(), asio::detached);
+    start = Bench::Clock::now();
+    while (expired.load(std::memory_order::relaxed) < nConnections)
+    {
+        wheelCtx.run_one();
+    }
+    const double expirySecs{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    std::println(
+        R"({{"bench":"idle","connections":{},"reads":{},"wheel_ns_per_read":{:.2f},"timer_ns_per_read":{:.2f},)"
+        R"("expire_all_ms":{:.1f}}})",
+        nConnections,
+        nReads,
+        wheelSecs * 1e9 / static_cast<double>(nReads),
+        timerSecs * 1e9 / static_cast<double>(nReads),
+        expirySecs * 1e3
+    );
+
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Server memory per idle TLS connection.
+// The server runs in a forked child so its RSS can be read from /proc without the client ends muddying it. The
+// parent opens --connections TLS connections that then sit idle for --settle seconds, and reports how much the
+// child's RSS grew, scaled to 10k connections, next to the pooled buffer bytes the child still has leased. Idle
+// connections lease no write buffers, so that is their read buffers, the same bytes OutboundStats::m_heldBytes counts.
+// Run with and without --release-tls-buffers to see what SSL_MODE_RELEASE_BUFFERS saves.
+//
+// usage: cpp-coro-bench-idle-memory [--connections=10000] [--release-tls-buffers] [--threads=N] [--settle=2]
+//                                   [--port=9445]
+
+#include "bench_common.hpp"
+#include "buffer_pool.hpp"
+#include "log/logger.hpp"
+#include "socket_stuff.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <span>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+struct Params
+{
+    size_t m_connections;
+    bool m_releaseTlsBuffers;
+    size_t m_threads;
+    size_t m_settleSecs;
+    std::string m_port;
+};
+
+struct Result
+{
+    size_t m_rssBefore;
+    size_t m_rssAfter;
+    size_t m_leasedBytes;
+    size_t m_leasedBuffers;
+};
+
+size_t rss_of(pid_t pid)
+{
+    std::ifstream statm{ std::format("/proc/{}/statm", pid) };
+    size_t totalPages{ 0 };
+    size_t residentPages{ 0 };
+    statm >> totalPages >> residentPages;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Every connection needs a descriptor on both ends
+void raise_fd_limit()
+{
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 and limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Child side. SIGUSR1 writes "<leased bytes> <leased buffers>\n" to statsFd, SIGTERM stops the server
+asio::awaitable<void> report_on_signal(int statsFd)
+{
+    asio::signal_set signals{ co_await asio::this_coro::executor, SIGUSR1, SIGTERM };
+    while (co_await signals.async_wait() == SIGUSR1)
+    {
+        const auto pool{ buffer_pool_stats() };
+        const auto line{ std::format("{} {}\n", pool.m_leasedBytes, pool.m_leasedBuffers) };
+        [[maybe_unused]] auto written{ ::write(statsFd, line.data(), line.size()) };
+    }
+}
+
+[[noreturn]] void run_server(const Params& params, int statsFd)
+{
+    Sage::Logger::SetupLogger("", Sage::Logger::Level::Warning);
+
+    auto serverSsl{ Bench::MakeServerSslContext() };
+    asio::io_context ctx{ static_cast<int>(params.m_threads) };
+    asio::co_spawn(
+        ctx,
+        accept_client(
+            serverSsl,
+            ServerConfig{
+                .m_listenHost = "localhost",
+                .m_listenPort = params.m_port,
+                .m_shards = params.m_threads,
+                // nothing may be cut while the parent is still measuring
+                .m_idleTimeout = std::chrono::hours{ 1 },
+                .m_releaseTlsBuffers = params.m_releaseTlsBuffers,
+            }
+        ),
+        detached_log_exception{ Sage::Logger::Level::Error }
+    );
+    asio::co_spawn(ctx, report_on_signal(statsFd), [&ctx](std::exception_ptr) { ctx.stop(); });
+
+    Bench::RunThreads(ctx, params.m_threads);
+    std::_Exit(0);
+}
+
+asio::awaitable<void>
+open_connections(ssl::context& clientSsl, std::string port, size_t n, std::vector<Bench::TlsStream>& out)
+{
+    for (size_t idx{ 0 }; idx < n; idx++)
+    {
+        out.push_back(co_await Bench::connect_tls(clientSsl, "localhost", port));
+    }
+}
+
+asio::awaitable<Result> run(ssl::context& clientSsl, Params params, pid_t server, int statsFd)
+{
+    using namespace std::chrono_literals;
+
+    auto exc{ co_await asio::this_coro::executor };
+    co_await Bench::wait_until_listening("localhost", params.m_port);
+
+    // let the probe connections close and the server settle before the baseline
+    asio::steady_timer timer{ exc };
+    timer.expires_after(500ms);
+    co_await timer.async_wait();
+
+    Result result{ .m_rssBefore = rss_of(server), .m_rssAfter = 0, .m_leasedBytes = 0, .m_leasedBuffers = 0 };
+
+    using ConnectOp = decltype(asio::co_spawn(
+        std::declval<asio::any_io_executor>(), std::declval<asio::awaitable<void>>(), asio::deferred
+    ));
+
+    // connect in parallel, each connector keeps the connections it opened
+    const size_t nConnectors{ std::min<size_t>(params.m_connections, 256) };
+    std::vector<std::vector<Bench::TlsStream>> streams(nConnectors);
+    std::vector<ConnectOp> connectors{};
+    for (size_t idx{ 0 }; idx < nConnectors; idx++)
+    {
+        const size_t share{ params.m_connections / nConnectors + (idx < params.m_connections % nConnectors ? 1 : 0) };
+        streams[idx].reserve(share);
+        connectors.push_back(asio::co_spawn(
+            asio::make_strand(exc), open_connections(clientSsl, params.m_port, share, streams[idx]), asio::deferred
+        ));
+    }
+
+    auto [order, errors]{ co_await asio::experimental::make_parallel_group(std::move(connectors))
+                              .async_wait(asio::experimental::wait_for_all(), asio::deferred) };
+    for (const auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    timer.expires_after(std::chrono::seconds{ params.m_settleSecs });
+    co_await timer.async_wait();
+    result.m_rssAfter = rss_of(server);
+
+    asio::posix::stream_descriptor stats{ exc, statsFd };
+    kill(server, SIGUSR1);
+    std::string line{};
+    co_await asio::async_read_until(stats, asio::dynamic_buffer(line), '\n');
+    std::istringstream fields{ line };
+    fields >> result.m_leasedBytes >> result.m_leasedBuffers;
+    stats.release();
+
+    co_return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_connections = std::max<size_t>(arg_or<size_t>(args, "connections", 10'000), 1),
+        .m_releaseTlsBuffers = arg_or(args, "release-tls-buffers", false),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1),
+        .m_settleSecs = arg_or<size_t>(args, "settle", 2),
+        .m_port = arg_or<std::string>(args, "port", "9445"),
+    };
+
+    raise_fd_limit();
+
+    // fork before any threads exist
+    int statsPipe[2]{};
+    if (pipe(statsPipe) != 0)
+    {
+        std::println(stderr, "pipe failed");
+        return 1;
+    }
+
+    const pid_t server{ fork() };
+    if (server < 0)
+    {
+        std::println(stderr, "fork failed");
+        return 1;
+    }
+    if (server == 0)
+    {
+        close(statsPipe[0]);
+        run_server(params, statsPipe[1]);
+    }
+    close(statsPipe[1]);
+
+    Sage::Logger::SetupLogger("", Sage::Logger::Level::Warning);
+    auto clientSsl{ Bench::MakeClientSslContext() };
+    asio::io_context clientCtx{ static_cast<int>(params.m_threads) };
+    std::optional<Result> result{};
+    asio::co_spawn(
+        clientCtx,
+        run(clientSsl, params, server, statsPipe[0]),
+        [&](std::exception_ptr e, Result res)
+        {
+            if (e)
+            {
+                detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                return;
+            }
+            result = res;
+        }
+    );
+    Bench::RunThreads(clientCtx, params.m_threads);
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    close(statsPipe[0]);
+
+    if (not result)
+    {
+        return 1;
+    }
+
+    constexpr double MIB{ 1024.0 * 1024.0 };
+    const double connections{ static_cast<double>(params.m_connections) };
+    const double grown{ static_cast<double>(result->m_rssAfter) - static_cast<double>(result->m_rssBefore) };
+    std::println(
+        R"({{"bench":"idle_memory","connections":{},"release_tls_buffers":{},"rss_before_mib":{:.1f},)"
+        R"("rss_after_mib":{:.1f},"rss_per_10k_mib":{:.1f},"bytes_per_connection":{:.0f},)"
+        R"("read_buffer_bytes_per_connection":{:.1f},"read_buffers_leased":{}}})",
+        params.m_connections,
+        params.m_releaseTlsBuffers,
+        static_cast<double>(result->m_rssBefore) / MIB,
+        static_cast<double>(result->m_rssAfter) / MIB,
+        grown / connections * 10'000 / MIB,
+        grown / connections,
+        static_cast<double>(result->m_leasedBytes) / connections,
+        result->m_leasedBuffers
+    );
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Bench
+{
+
+// Log-linear histogram of nanosecond latencies, within about 1.6% of the recorded value.
+// Recording is a couple of bit operations and an increment, one histogram per recorder and Merge() them afterwards.
+class LatencyHistogram
+{
+public:
+    // sub buckets per power of two
+    static constexpr unsigned SUB_BITS{ 6 };
+    static constexpr size_t SUB_BUCKETS{ size_t{ 1 } << SUB_BITS };
+    static constexpr size_t N_BUCKETS{ (64 - SUB_BITS + 1) * SUB_BUCKETS };
+
+    LatencyHistogram() :
+        m_counts(N_BUCKETS, 0)
+    {
+    }
+
+    void Record(std::chrono::nanoseconds latency) noexcept
+    {
+        const auto ns{ static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)) };
+        m_counts[BucketOf(ns)]++;
+        m_count++;
+        m_max = std::max(m_max, ns);
+    }
+
+    void Merge(const LatencyHistogram& other) noexcept
+    {
+        for (size_t idx{ 0 }; idx < N_BUCKETS; idx++)
+        {
+            m_counts[idx] += other.m_counts[idx];
+        }
+        m_count += other.m_count;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    size_t Count() const noexcept { return m_count; }
+
+    std::chrono::nanoseconds Max() const noexcept { return std::chrono::nanoseconds{ static_cast<int64_t>(m_max) }; }
+
+    // pct in [0, 1]. The upper edge of the bucket the percentile falls in
+    std::chrono::nanoseconds Percentile(double pct) const noexcept
+    {
+        if (m_count == 0)
+        {
+            return std::chrono::nanoseconds{ 0 };
+        }
+
+        const auto rank{ static_cast<size_t>(pct * static_cast<double>(m_count - 1)) + 1 };
+        size_t seen{ 0 };
+        for (size_t idx{ 0 }; idx < N_BUCKETS; idx++)
+        {
+            seen += m_counts[idx];
+            if (seen >= rank)
+            {
+                return std::chrono::nanoseconds{ static_cast<int64_t>(std::min(UpperEdgeOf(idx), m_max)) };
+            }
+        }
+
+        return Max();
+    }
+
+private:
+    static size_t BucketOf(uint64_t ns) noexcept
+    {
+        if (ns < SUB_BUCKETS)
+        {
+            return ns;
+        }
+
+        const auto exponent{ static_cast<unsigned>(std::bit_width(ns)) - 1 };
+        const auto sub{ (ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1) };
+        return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t UpperEdgeOf(size_t bucket) noexcept
+    {
+        if (bucket < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+
+        const auto shift{ bucket / SUB_BUCKETS - 1 };
+        const uint64_t lower{ (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift };
+        return lower + (uint64_t{ 1 } << shift) - 1;
+    }
+
+    std::vector<uint64_t> m_counts;
+    size_t m_count{ 0 };
+    uint64_t m_max{ 0 };
+};
+
+} // namespace Bench
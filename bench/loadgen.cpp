@@ -0,0 +1,421 @@
+// Load generator for the chat server.
+// Opens --clients TLS connections, the first --publishers of which together publish --rate messages a second for
+// --duration seconds. Every message carries the time it was due to be sent, so the reported delays also cover any
+// time a publisher spent behind schedule, and every other client records how long each message took to reach it.
+// The first --warmup seconds are left out of the results. Prints one JSON object when done.
+//
+// With --topics=K clients subscribe round robin to K topics and publishers publish to their own topic instead of
+// messaging everyone, so each message only reaches about clients / K others.
+//
+// Targets a running server on --host/--port. With --in-process it starts one on --port itself instead, with kernel
+// TLS for its sends when --ktls is given. --framing must match the server's.
+// cpu_s_per_gib is the process' CPU time over the measured window per GiB delivered. In process that covers both the
+// clients and the server, so compare runs that only differ in the server's settings.
+//
+// usage: cpp-coro-loadgen [--clients=100] [--publishers=10] [--rate=1000] [--size=64] [--duration=10] [--warmup=2]
+//                         [--topics=0] [--host=localhost] [--port=8080] [--framing=newline|length-prefixed]
+//                         [--in-process] [--ktls] [--threads=N]
+
+#include "bench_common.hpp"
+#include "chat_protocol.hpp"
+#include "frame_parser.hpp"
+#include "kernel_tls.hpp"
+#include "latency_histogram.hpp"
+#include "log/logger.hpp"
+#include "socket_stuff.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace boost::asio::experimental::awaitable_operators;
+
+struct Params
+{
+    size_t m_clients;
+    size_t m_publishers;
+    double m_rate;
+    size_t m_size;
+    size_t m_durationSecs;
+    size_t m_warmupSecs;
+    // 0 messages everyone
+    size_t m_topics;
+    std::string m_host;
+    std::string m_port;
+    FramingMode m_framing;
+    bool m_inProcess;
+    bool m_kernelTls;
+    size_t m_threads;
+};
+
+// everything a client measured. only ever touched from the client's strand until the run is over
+struct ClientStats
+{
+    size_t m_sent{ 0 };
+    size_t m_received{ 0 };
+    size_t m_receivedBytes{ 0 };
+    size_t m_malformed{ 0 };
+    Bench::LatencyHistogram m_latency{};
+};
+
+struct Result
+{
+    double m_elapsedSecs;
+    std::chrono::microseconds m_cpuTime;
+    size_t m_expected;
+    ClientStats m_total;
+};
+
+std::string topic_of(size_t client, const Params& params) { return std::format("t{}", client % params.m_topics); }
+
+// how many clients receive what client publishes, itself included
+size_t subscribers_of(size_t client, const Params& params)
+{
+    if (params.m_topics == 0)
+    {
+        return params.m_clients;
+    }
+    const size_t topic{ client % params.m_topics };
+    return params.m_clients / params.m_topics + (topic < params.m_clients % params.m_topics ? 1 : 0);
+}
+
+std::string frame_for(FramingMode framing, std::string body)
+{
+    if (framing == FramingMode::Newline)
+    {
+        body.push_back('\n');
+        return body;
+    }
+
+    std::string framed{};
+    for (int shift{ 24 }; shift >= 0; shift -= 8)
+    {
+        framed.push_back(static_cast<char>((body.size() >> shift) & 0xff));
+    }
+    return framed + body;
+}
+
+// "[/pub <topic> ]<due ns> <publisher> <seq> " padded with 'x' to size once framed
+std::string make_message(const Params& params, Bench::Clock::time_point due, size_t publisher, size_t seq)
+{
+    std::string body{ params.m_topics ? std::format("/pub {} ", topic_of(publisher, params)) : std::string{} };
+    body += std::format("{} {} {} ", due.time_since_epoch().count(), publisher, seq);
+    const size_t overhead{ params.m_framing == FramingMode::Newline ? 1 : FrameParser::LENGTH_PREFIX_BYTES };
+    if (body.size() + overhead < params.m_size)
+    {
+        body.append(params.m_size - overhead - body.size(), 'x');
+    }
+    return frame_for(params.m_framing, std::move(body));
+}
+
+asio::awaitable<void> publish(
+    Bench::TlsStream& stream,
+    const Params& params,
+    size_t publisher,
+    Bench::Clock::time_point start,
+    Bench::Clock::time_point measureFrom,
+    Bench::Clock::time_point until,
+    ClientStats& stats
+)
+{
+    // each publisher takes its share of the rate, offset so they don't all fire on the same instant
+    const auto interval{ std::chrono::duration_cast<Bench::Clock::duration>(
+        std::chrono::duration<double>{ static_cast<double>(params.m_publishers) / params.m_rate }
+    ) };
+    const auto offset{ interval * static_cast<int64_t>(publisher) / static_cast<int64_t>(params.m_publishers) };
+
+    asio::steady_timer timer{ co_await asio::this_coro::executor };
+    for (size_t seq{ 0 };; seq++)
+    {
+        const auto due{ start + offset + interval * static_cast<int64_t>(seq) };
+        if (due >= until)
+        {
+            break;
+        }
+
+        timer.expires_at(due);
+        co_await timer.async_wait();
+
+        auto msg{ make_message(params, due, publisher, seq) };
+        co_await asio::async_write(stream, asio::buffer(msg));
+        if (due >= measureFrom)
+        {
+            stats.m_sent++;
+        }
+    }
+}
+
+// Reads until the connection is closed
+asio::awaitable<void>
+receive(Bench::TlsStream& stream, FramingMode framing, Bench::Clock::time_point measureFrom, ClientStats& stats)
+{
+    FrameParser parser{ FramingConfig{ .m_mode = framing, .m_maxFrameBytes = 1024 * 1024 } };
+    while (true)
+    {
+        auto space{ parser.Prepare() };
+        boost::system::error_code ec;
+        const size_t nBytes{
+            co_await stream.async_read_some(asio::buffer(space.data(), space.size()), asio::redirect_error(ec))
+        };
+        if (ec)
+        {
+            co_return;
+        }
+
+        const auto now{ Bench::Clock::now() };
+        parser.Commit(nBytes);
+        while (auto frame{ parser.Next() })
+        {
+            // past the "/pub <topic> " of topic messages
+            const auto payload{ parse_command(frame->m_payload).m_body };
+            Bench::Clock::rep dueNs{};
+            auto [_, parseEc] = std::from_chars(payload.data(), payload.data() + payload.size(), dueNs);
+            if (parseEc != std::errc{})
+            {
+                stats.m_malformed++;
+                continue;
+            }
+
+            const Bench::Clock::time_point due{ Bench::Clock::duration{ dueNs } };
+            if (due >= measureFrom)
+            {
+                stats.m_received++;
+                stats.m_receivedBytes += frame->m_wire.size();
+                stats.m_latency.Record(now - due);
+            }
+        }
+    }
+}
+
+asio::awaitable<Result> run(ssl::context& clientSsl, Params params)
+{
+    using ClientOp = decltype(asio::co_spawn(
+        std::declval<asio::any_io_executor>(), std::declval<asio::awaitable<void>>(), asio::deferred
+    ));
+
+    auto exc{ co_await asio::this_coro::executor };
+    if (params.m_inProcess)
+    {
+        co_await Bench::wait_until_listening(params.m_host, params.m_port);
+    }
+
+    std::vector<Bench::TlsStream> clients{};
+    clients.reserve(params.m_clients);
+    while (clients.size() < params.m_clients)
+    {
+        auto client{ co_await Bench::connect_tls(clientSsl, params.m_host, params.m_port) };
+        if (params.m_topics)
+        {
+            const auto sub{ frame_for(params.m_framing, "/sub " + topic_of(clients.size(), params)) };
+            co_await asio::async_write(client, asio::buffer(sub));
+        }
+        clients.push_back(std::move(client));
+    }
+
+    // give the server a moment to register the last connections and subscriptions before anything is published
+    asio::steady_timer timer{ exc };
+    timer.expires_after(200ms);
+    co_await timer.async_wait();
+
+    const auto start{ Bench::Clock::now() };
+    const auto measureFrom{ start + std::chrono::seconds{ params.m_warmupSecs } };
+    const auto until{ measureFrom + std::chrono::seconds{ params.m_durationSecs } };
+
+    // each client reads and publishes on the strand its stream was made with
+    std::vector<ClientStats> stats(params.m_clients);
+    std::vector<ClientOp> receivers{};
+    std::vector<ClientOp> publishers{};
+    for (size_t idx{ 0 }; idx < params.m_clients; idx++)
+    {
+        auto& client{ clients[idx] };
+        receivers.push_back(asio::co_spawn(
+            client.get_executor(), receive(client, params.m_framing, measureFrom, stats[idx]), asio::deferred
+        ));
+        if (idx < params.m_publishers)
+        {
+            publishers.push_back(asio::co_spawn(
+                client.get_executor(),
+                publish(client, params, idx, start, measureFrom, until, stats[idx]),
+                asio::deferred
+            ));
+        }
+    }
+
+    auto waitAll{ [](std::vector<ClientOp> ops) -> asio::awaitable<void>
+                  {
+                      co_await asio::experimental::make_parallel_group(std::move(ops))
+                          .async_wait(asio::experimental::wait_for_all(), asio::deferred);
+                  } };
+
+    std::chrono::microseconds cpuFrom{ 0 };
+    auto sampleCpu{ [&] -> asio::awaitable<void>
+                    {
+                        asio::steady_timer warmup{ exc };
+                        warmup.expires_at(measureFrom);
+                        co_await warmup.async_wait();
+                        cpuFrom = Bench::ProcessCpuTime();
+                    } };
+
+    double elapsed{ 0.0 };
+    std::chrono::microseconds cpuTime{ 0 };
+    auto publishThenClose{ [&] -> asio::awaitable<void>
+                           {
+                               co_await waitAll(std::move(publishers));
+                               elapsed = Bench::Seconds(Bench::Clock::now() - measureFrom);
+                               cpuTime = Bench::ProcessCpuTime() - cpuFrom;
+
+                               // whatever is still in flight after this counts as lost
+                               timer.expires_after(2s);
+                               co_await timer.async_wait();
+                               for (auto& client : clients)
+                               {
+                                   asio::post(
+                                       client.get_executor(),
+                                       [&client]
+                                       {
+                                           boost::system::error_code ec;
+                                           client.next_layer().close(ec);
+                                       }
+                                   );
+                               }
+                           } };
+
+    co_await (waitAll(std::move(receivers)) && publishThenClose() && sampleCpu());
+
+    Result result{ .m_elapsedSecs = elapsed, .m_cpuTime = cpuTime, .m_expected = 0, .m_total = {} };
+    for (size_t idx{ 0 }; idx < params.m_clients; idx++)
+    {
+        const auto& clientStats{ stats[idx] };
+        result.m_expected += clientStats.m_sent * (subscribers_of(idx, params) - 1);
+        result.m_total.m_sent += clientStats.m_sent;
+        result.m_total.m_received += clientStats.m_received;
+        result.m_total.m_receivedBytes += clientStats.m_receivedBytes;
+        result.m_total.m_malformed += clientStats.m_malformed;
+        result.m_total.m_latency.Merge(clientStats.m_latency);
+    }
+
+    co_return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const size_t nClients{ std::max<size_t>(arg_or<size_t>(args, "clients", 100), 2) };
+    const Params params{
+        .m_clients = nClients,
+        .m_publishers = std::clamp<size_t>(arg_or<size_t>(args, "publishers", 10), 1, nClients),
+        .m_rate = std::max(arg_or(args, "rate", 1000.0), 0.001),
+        .m_size = arg_or<size_t>(args, "size", 64),
+        .m_durationSecs = std::max<size_t>(arg_or<size_t>(args, "duration", 10), 1),
+        .m_warmupSecs = arg_or<size_t>(args, "warmup", 2),
+        .m_topics = std::min(arg_or<size_t>(args, "topics", 0), nClients),
+        .m_host = arg_or<std::string>(args, "host", "localhost"),
+        .m_port = arg_or<std::string>(args, "port", "8080"),
+        .m_framing = parse_framing_mode(arg_or<std::string>(args, "framing", "newline")),
+        .m_inProcess = arg_or(args, "in-process", false),
+        .m_kernelTls = arg_or(args, "ktls", false),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1),
+    };
+
+    Sage::Logger::SetupLogger("", Sage::Logger::Level::Warning);
+
+    asio::io_context ctx{ static_cast<int>(params.m_threads) };
+    auto clientSsl{ Bench::MakeClientSslContext() };
+    auto serverSsl{ Bench::MakeServerSslContext() };
+    std::optional<KernelTls> kernelTls{};
+    if (params.m_inProcess and params.m_kernelTls)
+    {
+        kernelTls.emplace(serverSsl);
+    }
+    if (params.m_inProcess)
+    {
+        asio::co_spawn(
+            ctx,
+            accept_client(
+                serverSsl,
+                ServerConfig{
+                    .m_listenHost = params.m_host,
+                    .m_listenPort = params.m_port,
+                    .m_shards = params.m_threads,
+                    .m_framing = FramingConfig{ .m_mode = params.m_framing },
+                }
+            ),
+            detached_log_exception{ Sage::Logger::Level::Error }
+        );
+    }
+
+    std::optional<Result> result{};
+    asio::co_spawn(
+        ctx,
+        run(clientSsl, params),
+        [&](std::exception_ptr e, Result res)
+        {
+            ctx.stop();
+            if (e)
+            {
+                detached_log_exception{ Sage::Logger::Level::Critical }(e);
+                return;
+            }
+            result = std::move(res);
+        }
+    );
+
+    Bench::RunThreads(ctx, params.m_threads);
+    if (not result)
+    {
+        return 1;
+    }
+
+    const auto& total{ result->m_total };
+    const size_t expected{ result->m_expected };
+    const double cpuSecs{ Bench::Seconds(result->m_cpuTime) };
+    const double deliveredGib{ static_cast<double>(total.m_receivedBytes) / (1024.0 * 1024.0 * 1024.0) };
+    auto micros{ [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1e3; } };
+    std::println(
+        R"({{"bench":"loadgen","backend":"{}","clients":{},"publishers":{},"topics":{},"target_rate":{:.0f},"size":{},)"
+        R"("framing":"{}",)"
+        R"("elapsed_s":{:.3f},"sent":{},"expected_deliveries":{},"deliveries":{},"malformed":{},"loss":{:.6f},)"
+        R"("publish_msgs_per_s":{:.0f},"deliveries_per_s":{:.0f},"ktls":{},"ktls_offloaded":{},)"
+        R"("delivered_gib":{:.3f},"cpu_s":{:.3f},"cpu_s_per_gib":{:.3f},)"
+        R"("latency_p50_us":{:.1f},"latency_p99_us":{:.1f},"latency_p999_us":{:.1f},"latency_max_us":{:.1f}}})",
+        Bench::BACKEND,
+        params.m_clients,
+        params.m_publishers,
+        params.m_topics,
+        params.m_rate,
+        params.m_size,
+        to_string(params.m_framing),
+        result->m_elapsedSecs,
+        total.m_sent,
+        expected,
+        total.m_received,
+        total.m_malformed,
+        expected ? 1.0 - static_cast<double>(total.m_received) / static_cast<double>(expected) : 0.0,
+        static_cast<double>(total.m_sent) / result->m_elapsedSecs,
+        static_cast<double>(total.m_received) / result->m_elapsedSecs,
+        params.m_kernelTls,
+        kernelTls ? kernelTls->Stats().m_offloaded : 0,
+        deliveredGib,
+        cpuSecs,
+        deliveredGib > 0 ? cpuSecs / deliveredGib : 0.0,
+        micros(total.m_latency.Percentile(0.50)),
+        micros(total.m_latency.Percentile(0.99)),
+        micros(total.m_latency.Percentile(0.999)),
+        micros(total.m_latency.Max())
+    );
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Channel throughput across threads.
+// P producers send --events values in total to P consumers, every one of them a coroutine on its own strand of an
+// io_context run by --threads threads, through
+//   channel             asio's channel. It isn't thread safe, so everyone shares one strand instead
+//   concurrent_channel  asio's channel behind a mutex
+//   mpmc                MpmcChannel
+// with room for --queue values, for P of 1, 4 and --threads. Best of --rounds.
+//
+// usage: cpp-coro-bench-mpmc [--events=1000000] [--queue=1024] [--threads=<cores>] [--rounds=3]
+
+#include "bench_common.hpp"
+#include "mpmc_channel.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/experimental/channel.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <cstdint>
+#include <memory>
+#include <print>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct Params
+{
+    uint64_t m_events;
+    size_t m_queue;
+    size_t m_threads;
+    size_t m_rounds;
+};
+
+struct Shared
+{
+    std::atomic<uint64_t> m_received{ 0 };
+    // checks that every value arrived exactly once
+    std::atomic<uint64_t> m_sum{ 0 };
+};
+
+template<typename ChannelT> asio::awaitable<void> produce(ChannelT& ch, uint64_t first, uint64_t count)
+{
+    for (uint64_t value{ first }; value < first + count; value++)
+    {
+        co_await ch.async_send(boost::system::error_code{}, value);
+    }
+}
+
+template<typename ChannelT> asio::awaitable<void> consume(ChannelT& ch, Shared& shared, uint64_t nEvents)
+{
+    try
+    {
+        while (true)
+        {
+            const uint64_t value{ co_await ch.async_receive() };
+            shared.m_sum.fetch_add(value, std::memory_order::relaxed);
+            // the last value releases the consumers still waiting
+            if (shared.m_received.fetch_add(1, std::memory_order::relaxed) + 1 == nEvents)
+            {
+                ch.close();
+                co_return;
+            }
+        }
+    }
+    catch (const boost::system::system_error&)
+    {
+        // closed
+    }
+}
+
+struct RunResult
+{
+    double m_elapsedSecs;
+    bool m_complete;
+};
+
+// makeChannel(executor) -> unique_ptr to the channel. shareStrand puts every coroutine on one strand
+template<typename MakeChannel>
+RunResult run(const Params& params, size_t nPairs, bool shareStrand, MakeChannel makeChannel)
+{
+    asio::io_context ctx{ static_cast<int>(params.m_threads) };
+    const auto shared{ asio::make_strand(ctx) };
+    auto executor{ [&]() -> asio::any_io_executor
+                   {
+                       if (shareStrand)
+                       {
+                           return shared;
+                       }
+                       return asio::make_strand(ctx);
+                   } };
+
+    auto ch{ makeChannel(shared) };
+    Shared totals{};
+    const uint64_t perProducer{ params.m_events / nPairs };
+    for (size_t idx{ 0 }; idx < nPairs; idx++)
+    {
+        const uint64_t first{ idx * perProducer };
+        const uint64_t count{ idx + 1 == nPairs ? params.m_events - first : perProducer };
+        asio::co_spawn(executor(), produce(*ch, first, count), detached_log_exception{ Sage::Logger::Level::Error });
+        asio::co_spawn(
+            executor(), consume(*ch, totals, params.m_events), detached_log_exception{ Sage::Logger::Level::Error }
+        );
+    }
+
+    const auto start{ Bench::Clock::now() };
+    Bench::RunThreads(ctx, params.m_threads);
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    return RunResult{
+        .m_elapsedSecs = elapsed,
+        .m_complete = totals.m_received.load() == params.m_events and
+                      totals.m_sum.load() == params.m_events * (params.m_events - 1) / 2,
+    };
+}
+
+template<typename MakeChannel>
+bool report(std::string_view mode, const Params& params, size_t nPairs, bool shareStrand, MakeChannel makeChannel)
+{
+    RunResult best{ .m_elapsedSecs = 0.0, .m_complete = true };
+    bool complete{ true };
+    for (size_t round{ 0 }; round < params.m_rounds; round++)
+    {
+        auto result{ run(params, nPairs, shareStrand, makeChannel) };
+        complete = complete and result.m_complete;
+        if (round == 0 or result.m_elapsedSecs < best.m_elapsedSecs)
+        {
+            best = result;
+        }
+    }
+
+    std::println(
+        R"({{"bench":"mpmc","backend":"{}","channel":"{}","producers":{},"consumers":{},"threads":{},"events":{},)"
+        R"("queue":{},"elapsed_s":{:.4f},"events_per_s":{:.0f},"complete":{}}})",
+        Bench::BACKEND,
+        mode,
+        nPairs,
+        nPairs,
+        params.m_threads,
+        params.m_events,
+        params.m_queue,
+        best.m_elapsedSecs,
+        static_cast<double>(params.m_events) / best.m_elapsedSecs,
+        complete
+    );
+    return complete;
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_events = std::max<uint64_t>(arg_or<uint64_t>(args, "events", 1'000'000), 1),
+        .m_queue = std::max<size_t>(arg_or<size_t>(args, "queue", 1024), 1),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1),
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 3), 1),
+    };
+
+    using AsioChannel = asio::experimental::channel<void(boost::system::error_code, uint64_t)>;
+    using ConcurrentChannel = asio::experimental::concurrent_channel<void(boost::system::error_code, uint64_t)>;
+
+    std::vector<size_t> pairs{ 1, 4, params.m_threads };
+    std::ranges::sort(pairs);
+    pairs.erase(std::ranges::unique(pairs).begin(), pairs.end());
+
+    bool complete{ true };
+    for (size_t nPairs : pairs)
+    {
+        const bool channelOk{ report(
+            "channel",
+            params,
+            nPairs,
+            true,
+            [&](const asio::any_io_executor& exc) { return std::make_unique<AsioChannel>(exc, params.m_queue); }
+        ) };
+        const bool concurrentOk{ report(
+            "concurrent_channel",
+            params,
+            nPairs,
+            false,
+            [&](const asio::any_io_executor& exc) { return std::make_unique<ConcurrentChannel>(exc, params.m_queue); }
+        ) };
+        const bool mpmcOk{ report(
+            "mpmc",
+            params,
+            nPairs,
+            false,
+            [&](const asio::any_io_executor&) { return std::make_unique<MpmcChannel<uint64_t>>(params.m_queue); }
+        ) };
+        complete = complete and channelOk and concurrentOk and mpmcOk;
+    }
+
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,394 @@
+// What the coroutine building blocks cost. Each case repeats one primitive --ops times in a coroutine on a strand:
+//   spawn          co_spawn(..., detached) of a coroutine that returns right away
+//   depth_<n>      co_await of a coroutine that co_awaits n - 1 more before returning
+//   or_timeout     `co_await (x() or timeout(1s))` from utils.hpp, where x() returns right away
+//   wait           an async_wait on a timer that has already expired, the guarded operation of the next two
+//   wait_timeout   the wait raced against timeout(1s), which is how operations used to be guarded
+//   wait_deadline  the wait guarded by a Deadline of 1s
+//   channel        one value from async_send to async_receive on a Channel<T> with room for --queue values
+//   channel_batch  the same through send_or_wait and receive_batch, up to --queue values per resume
+//   strand_hop     co_await post() to another strand, there and back, as a coroutine spawned onto a strand does
+//   cancel         an async_wait bound to a cancellation_signal, the emit and the aborted wait completing
+// The cases run with 1, 2, 4... up to --threads such coroutines on as many threads, each repeating the primitive
+// --ops times, so with perfect scaling ns_per_op, the thread time per op, stays flat as threads grow. Allocations
+// per op are counted by replacing operator new, which adds a shared atomic increment per allocation, and with them
+// how many reached malloc, all of them unless built with CPP_CORO_FRAME_ARENA.
+// One warmup round, then the median of --rounds. --case picks a single case.
+//
+// usage: cpp-coro-bench-runtime [--ops=200000] [--queue=64] [--threads=<cores>] [--rounds=5] [--case=<name>]
+
+#include "alloc_counter.hpp"
+#include "bench_common.hpp"
+#include "channel_stuff.hpp"
+#include "deadline.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+namespace
+{
+
+// cases that complete asynchronously give the strand a turn this often, so their work doesn't pile up unbounded
+constexpr size_t YIELD_EVERY{ 64 };
+
+struct Params
+{
+    size_t m_ops;
+    size_t m_queue;
+    size_t m_threads;
+    size_t m_rounds;
+};
+
+// one coroutine's share of a case: repeat the primitive --ops times, and return something derived from the results
+// so they can't be optimised away
+using Lane = std::function<asio::awaitable<uint64_t>(const Params& params)>;
+
+enum class GuardKind
+{
+    None,
+    Timeout,
+    Deadline,
+};
+
+struct Case
+{
+    std::string m_name;
+    Lane m_lane;
+};
+
+asio::awaitable<void> yield()
+{
+    co_await asio::post(co_await asio::this_coro::executor, asio::deferred);
+}
+
+asio::awaitable<void> count_one(uint64_t& finished)
+{
+    finished++;
+    co_return;
+}
+
+asio::awaitable<uint64_t> spawn_lane(const Params& params)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    // the children run on this strand, so counting needs no atomics
+    uint64_t finished{ 0 };
+    for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+    {
+        asio::co_spawn(exc, count_one(finished), asio::detached);
+        if (idx % YIELD_EVERY == YIELD_EVERY - 1)
+        {
+            co_await yield();
+        }
+    }
+
+    while (finished < params.m_ops)
+    {
+        co_await yield();
+    }
+    co_return finished;
+}
+
+asio::awaitable<uint64_t> nested(size_t depth)
+{
+    if (depth <= 1)
+    {
+        co_return 1;
+    }
+    co_return 1 + co_await nested(depth - 1);
+}
+
+Lane depth_lane(size_t depth)
+{
+    return [depth](const Params& params) -> asio::awaitable<uint64_t>
+    {
+        uint64_t sum{ 0 };
+        for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+        {
+            sum += co_await nested(depth);
+        }
+        co_return sum;
+    };
+}
+
+asio::awaitable<uint64_t> ready_value() { co_return 1; }
+
+asio::awaitable<uint64_t> or_timeout_lane(const Params& params)
+{
+    using namespace std::chrono_literals;
+
+    uint64_t sum{ 0 };
+    for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+    {
+        auto res{ co_await (ready_value() or timeout(1s)) };
+        sum += res.index() == 0 ? std::get<0>(res) : 0;
+    }
+    co_return sum;
+}
+
+Lane wait_lane(GuardKind guard)
+{
+    return [guard](const Params& params) -> asio::awaitable<uint64_t>
+    {
+        using namespace std::chrono_literals;
+
+        auto exc{ co_await asio::this_coro::executor };
+        asio::steady_timer expired{ exc, asio::steady_timer::time_point{} };
+        Deadline deadline{ exc };
+        uint64_t completed{ 0 };
+        for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+        {
+            switch (guard)
+            {
+            case GuardKind::None:
+                co_await expired.async_wait(asio::deferred);
+                break;
+            case GuardKind::Timeout:
+                co_await (expired.async_wait(asio::use_awaitable) or timeout(1s));
+                break;
+            case GuardKind::Deadline:
+                co_await deadline.Within(1s, expired.async_wait(asio::deferred));
+                break;
+            }
+            completed++;
+        }
+        co_return completed;
+    };
+}
+
+asio::awaitable<uint64_t> channel_lane(const Params& params, bool batched)
+{
+    Channel<uint64_t> ch{ co_await asio::this_coro::executor, params.m_queue };
+
+    auto produce{ [&] -> asio::awaitable<void>
+                  {
+                      for (uint64_t value{ 0 }; value < params.m_ops; value++)
+                      {
+                          if (batched)
+                          {
+                              co_await send_or_wait(ch, value);
+                          }
+                          else
+                          {
+                              co_await ch.async_send(boost::system::error_code{}, value);
+                          }
+                      }
+                  } };
+
+    uint64_t sum{ 0 };
+    auto consume{ [&] -> asio::awaitable<void>
+                  {
+                      std::vector<uint64_t> values{};
+                      values.reserve(params.m_queue);
+                      size_t nReceived{ 0 };
+                      while (nReceived < params.m_ops)
+                      {
+                          if (batched)
+                          {
+                              values.clear();
+                              nReceived += co_await receive_batch(ch, values, params.m_queue);
+                              for (uint64_t value : values)
+                              {
+                                  sum += value;
+                              }
+                          }
+                          else
+                          {
+                              sum += co_await ch.async_receive();
+                              nReceived++;
+                          }
+                      }
+                  } };
+
+    co_await (produce() and consume());
+    co_return sum;
+}
+
+asio::awaitable<uint64_t> strand_hop_lane(const Params& params)
+{
+    auto other{ asio::make_strand(co_await asio::this_coro::executor) };
+    for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+    {
+        // runs on other, then resumes this coroutine back on its own strand
+        co_await asio::post(other, asio::deferred);
+    }
+    co_return params.m_ops;
+}
+
+asio::awaitable<uint64_t> cancel_lane(const Params& params)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    // a timer and signal for every wait between yields, so none is reused before its last wait completed
+    std::vector<asio::steady_timer> timers{};
+    for (size_t idx{ 0 }; idx < YIELD_EVERY; idx++)
+    {
+        timers.emplace_back(exc, asio::steady_timer::time_point::max());
+    }
+    std::array<asio::cancellation_signal, YIELD_EVERY> signals{};
+
+    // the waits complete on this strand too
+    uint64_t aborted{ 0 };
+    for (size_t idx{ 0 }; idx < params.m_ops; idx++)
+    {
+        const size_t slot{ idx % YIELD_EVERY };
+        timers[slot].async_wait(
+            asio::bind_cancellation_slot(
+                signals[slot].slot(),
+                [&aborted](const boost::system::error_code& ec)
+                {
+                    if (ec == asio::error::operation_aborted)
+                    {
+                        aborted++;
+                    }
+                }
+            )
+        );
+        signals[slot].emit(asio::cancellation_type::terminal);
+
+        if (slot == YIELD_EVERY - 1 or idx + 1 == params.m_ops)
+        {
+            while (aborted < idx + 1)
+            {
+                co_await yield();
+            }
+        }
+    }
+    co_return aborted;
+}
+
+struct RunResult
+{
+    double m_elapsedSecs;
+    size_t m_allocations;
+    size_t m_mallocs;
+    bool m_complete;
+};
+
+RunResult run(const Case& benchCase, const Params& params, size_t nThreads)
+{
+    asio::io_context ctx{ static_cast<int>(nThreads) };
+    std::atomic<size_t> nFinished{ 0 };
+    std::atomic<uint64_t> sink{ 0 };
+
+    const size_t allocationsBefore{ Bench::Allocations() };
+    const size_t mallocsBefore{ Bench::Mallocs() };
+    const auto start{ Bench::Clock::now() };
+    for (size_t idx{ 0 }; idx < nThreads; idx++)
+    {
+        asio::co_spawn(
+            asio::make_strand(ctx),
+            benchCase.m_lane(params),
+            [&](std::exception_ptr e, uint64_t result)
+            {
+                if (not e)
+                {
+                    sink.fetch_add(result, std::memory_order::relaxed);
+                    nFinished.fetch_add(1, std::memory_order::relaxed);
+                }
+            }
+        );
+    }
+    Bench::RunThreads(ctx, nThreads);
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    return RunResult{
+        .m_elapsedSecs = elapsed,
+        .m_allocations = Bench::Allocations() - allocationsBefore,
+        .m_mallocs = Bench::Mallocs() - mallocsBefore,
+        .m_complete = nFinished.load() == nThreads and sink.load() > 0,
+    };
+}
+
+bool report(const Case& benchCase, const Params& params, size_t nThreads)
+{
+    run(benchCase, params, nThreads);
+
+    std::vector<RunResult> rounds{};
+    for (size_t round{ 0 }; round < params.m_rounds; round++)
+    {
+        rounds.push_back(run(benchCase, params, nThreads));
+    }
+    const bool complete{ std::ranges::all_of(rounds, &RunResult::m_complete) };
+    auto median{ rounds.begin() + static_cast<ptrdiff_t>(rounds.size() / 2) };
+    std::ranges::nth_element(rounds, median, {}, &RunResult::m_elapsedSecs);
+
+    const auto nOps{ static_cast<double>(params.m_ops * nThreads) };
+    std::println(
+        R"({{"bench":"runtime","backend":"{}","case":"{}","threads":{},"ops":{},"elapsed_s":{:.4f},"ops_per_s":{:.0f},)"
+        R"("ns_per_op":{:.1f},"allocations_per_op":{:.3f},"mallocs_per_op":{:.3f},"complete":{}}})",
+        Bench::BACKEND,
+        benchCase.m_name,
+        nThreads,
+        params.m_ops * nThreads,
+        median->m_elapsedSecs,
+        nOps / median->m_elapsedSecs,
+        median->m_elapsedSecs * 1e9 * static_cast<double>(nThreads) / nOps,
+        static_cast<double>(median->m_allocations) / nOps,
+        static_cast<double>(median->m_mallocs) / nOps,
+        complete
+    );
+    return complete;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const Params params{
+        .m_ops = std::max<size_t>(arg_or<size_t>(args, "ops", 200'000), 1),
+        .m_queue = std::max<size_t>(arg_or<size_t>(args, "queue", 64), 1),
+        .m_threads = std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1),
+        .m_rounds = std::max<size_t>(arg_or<size_t>(args, "rounds", 5), 1),
+    };
+    const std::string_view only{ arg_or<std::string_view>(args, "case", "") };
+
+    const std::vector<Case> cases{
+        { "spawn", spawn_lane },
+        { "depth_1", depth_lane(1) },
+        { "depth_8", depth_lane(8) },
+        { "depth_32", depth_lane(32) },
+        { "or_timeout", or_timeout_lane },
+        { "wait", wait_lane(GuardKind::None) },
+        { "wait_timeout", wait_lane(GuardKind::Timeout) },
+        { "wait_deadline", wait_lane(GuardKind::Deadline) },
+        { "channel", [](const Params& p) { return channel_lane(p, false); } },
+        { "channel_batch", [](const Params& p) { return channel_lane(p, true); } },
+        { "strand_hop", strand_hop_lane },
+        { "cancel", cancel_lane },
+    };
+
+    std::vector<size_t> threadCounts{};
+    for (size_t nThreads{ 1 }; nThreads < params.m_threads; nThreads *= 2)
+    {
+        threadCounts.push_back(nThreads);
+    }
+    threadCounts.push_back(params.m_threads);
+
+    bool complete{ true };
+    for (const auto& benchCase : cases)
+    {
+        if (not only.empty() and benchCase.m_name != only)
+        {
+            continue;
+        }
+        for (size_t nThreads : threadCounts)
+        {
+            complete = report(benchCase, params, nThreads) and complete;
+        }
+    }
+
+    return complete ? 0 : 1;
+}
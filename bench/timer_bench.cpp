@@ -0,0 +1,85 @@
+// Timer churn in the shape of something_that_timesout(). --tasks coroutines each loop `co_await (wait or timeout())`
+// for --duration seconds, where the wait is --period-us long and the timeout twice that. Every iteration arms two
+// timers and cancels the loser, so this is mostly the reactor's timer queue and cancellation path.
+// Reports iterations per second and how late the winning timer fired.
+//
+// usage: cpp-coro-bench-timer [--tasks=10000] [--period-us=1000] [--duration=5] [--threads=N]
+
+#include "bench_common.hpp"
+#include "latency_histogram.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <print>
+#include <span>
+#include <thread>
+#include <vector>
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+struct TaskStats
+{
+    size_t m_iterations{ 0 };
+    Bench::LatencyHistogram m_lateness{};
+};
+
+asio::awaitable<void> tick(Bench::Clock::duration period, Bench::Clock::time_point until, TaskStats& stats)
+{
+    asio::steady_timer timer{ co_await asio::this_coro::executor };
+    while (Bench::Clock::now() < until)
+    {
+        const auto due{ Bench::Clock::now() + period };
+        timer.expires_at(due);
+        co_await (timer.async_wait(asio::use_awaitable) or timeout(period * 2));
+        stats.m_lateness.Record(Bench::Clock::now() - due);
+        stats.m_iterations++;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::span<char* const> args{ argv, static_cast<size_t>(argc) };
+    const size_t nTasks{ std::max<size_t>(arg_or<size_t>(args, "tasks", 10'000), 1) };
+    const std::chrono::microseconds period{ std::max<int64_t>(arg_or<int64_t>(args, "period-us", 1000), 1) };
+    const std::chrono::seconds duration{ std::max<int64_t>(arg_or<int64_t>(args, "duration", 5), 1) };
+    const size_t nThreads{ std::max<size_t>(arg_or<size_t>(args, "threads", std::thread::hardware_concurrency()), 1) };
+
+    asio::io_context ctx{ static_cast<int>(nThreads) };
+    std::vector<TaskStats> stats(nTasks);
+    const auto start{ Bench::Clock::now() };
+    const auto until{ start + duration };
+    for (auto& taskStats : stats)
+    {
+        asio::co_spawn(asio::make_strand(ctx), tick(period, until, taskStats), asio::detached);
+    }
+
+    Bench::RunThreads(ctx, nThreads);
+    const double elapsed{ Bench::Seconds(Bench::Clock::now() - start) };
+
+    TaskStats total{};
+    for (const auto& taskStats : stats)
+    {
+        total.m_iterations += taskStats.m_iterations;
+        total.m_lateness.Merge(taskStats.m_lateness);
+    }
+
+    auto micros{ [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1e3; } };
+    std::println(
+        R"({{"bench":"timer","backend":"{}","tasks":{},"period_us":{},"threads":{},"elapsed_s":{:.3f},"ops":{},)"
+        R"("ops_per_s":{:.0f},"late_p50_us":{:.1f},"late_p99_us":{:.1f},"late_p999_us":{:.1f},"late_max_us":{:.1f}}})",
+        Bench::BACKEND,
+        nTasks,
+        period.count(),
+        nThreads,
+        elapsed,
+        total.m_iterations,
+        static_cast<double>(total.m_iterations) / elapsed,
+        micros(total.m_lateness.Percentile(0.50)),
+        micros(total.m_lateness.Percentile(0.99)),
+        micros(total.m_lateness.Percentile(0.999)),
+        micros(total.m_lateness.Max())
+    );
+
+    return 0;
+}
@@ -15,12 +15,17 @@
         cmake
         gcc15
         pkg-config
+        # nghttpd, the HTTP/2 server bench/http2_standin.sh tests against
+        (nghttp2.override { enableApp = true; })
       ];
 
       # These are the libraries your code links against
       buildInputs = with pkgs; [
         openssl
         boost188
+        liburing
+        zlib
+        brotli
       ];
 
       # Ensure CMake can find OpenSSL and Boost easily
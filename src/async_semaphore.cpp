@@ -0,0 +1,108 @@
+#include "async_semaphore.hpp"
+#include <algorithm>
+#include <utility>
+
+AsyncSemaphore::Permit::Permit(Permit&& other) noexcept :
+    m_semaphore{ std::exchange(other.m_semaphore, nullptr) }
+{
+}
+
+AsyncSemaphore::Permit& AsyncSemaphore::Permit::operator=(Permit&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_semaphore)
+        {
+            m_semaphore->Release();
+        }
+        m_semaphore = std::exchange(other.m_semaphore, nullptr);
+    }
+    return *this;
+}
+
+AsyncSemaphore::Permit::~Permit()
+{
+    if (m_semaphore)
+    {
+        m_semaphore->Release();
+    }
+}
+
+AsyncSemaphore::AsyncSemaphore(size_t permits) :
+    m_available{ permits }
+{
+}
+
+asio::awaitable<AsyncSemaphore::Permit> AsyncSemaphore::Acquire()
+{
+    auto waiter{ std::make_shared<Waiter>(std::make_shared<asio::steady_timer>(
+        co_await asio::this_coro::executor, asio::steady_timer::time_point::max()
+    )) };
+
+    {
+        std::lock_guard lk{ m_mutex };
+        if (m_available > 0 and m_waiters.empty())
+        {
+            m_available--;
+            co_return Permit{ this };
+        }
+        m_waiters.push_back(waiter);
+    }
+
+    // cancelled by Release() handing over a permit, or by cancelling the caller
+    boost::system::error_code ec;
+    co_await waiter->m_wake->async_wait(asio::redirect_error(ec));
+
+    {
+        std::lock_guard lk{ m_mutex };
+        if (not waiter->m_granted)
+        {
+            m_waiters.erase(std::ranges::find(m_waiters, waiter));
+            throw boost::system::system_error{ asio::error::operation_aborted };
+        }
+    }
+
+    // a caller cancelled after the handover drops this, which passes the permit on
+    co_return Permit{ this };
+}
+
+AsyncSemaphore::Permit AsyncSemaphore::TryAcquire()
+{
+    std::lock_guard lk{ m_mutex };
+    if (m_available == 0 or not m_waiters.empty())
+    {
+        return Permit{};
+    }
+    m_available--;
+    return Permit{ this };
+}
+
+size_t AsyncSemaphore::Available() const
+{
+    std::lock_guard lk{ m_mutex };
+    return m_available;
+}
+
+size_t AsyncSemaphore::Waiting() const
+{
+    std::lock_guard lk{ m_mutex };
+    return m_waiters.size();
+}
+
+void AsyncSemaphore::Release()
+{
+    std::shared_ptr<Waiter> next{};
+    {
+        std::lock_guard lk{ m_mutex };
+        if (m_waiters.empty())
+        {
+            m_available++;
+            return;
+        }
+        next = std::move(m_waiters.front());
+        m_waiters.pop_front();
+        next->m_granted = true;
+    }
+
+    asio::post(next->m_wake->get_executor(), [wake{ next->m_wake }] { wake->cancel(); });
+}
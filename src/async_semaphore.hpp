@@ -0,0 +1,66 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Hands out a fixed number of permits to coroutines, first come first served.
+// A permit that's returned goes straight to the longest waiter, whose wakeup is posted to its executor, so waiters must
+// be running on a strand. A waiter that is cancelled before its turn leaves the queue and throws operation_aborted.
+// The semaphore must outlive its permits.
+class AsyncSemaphore
+{
+public:
+    // Returned to the semaphore when destroyed
+    class Permit
+    {
+    public:
+        Permit() = default;
+
+        Permit(Permit&& other) noexcept;
+
+        Permit& operator=(Permit&& other) noexcept;
+
+        Permit(const Permit&) = delete;
+
+        Permit& operator=(const Permit&) = delete;
+
+        ~Permit();
+
+        explicit operator bool() const noexcept { return m_semaphore != nullptr; }
+
+    private:
+        friend class AsyncSemaphore;
+
+        explicit Permit(AsyncSemaphore* semaphore) noexcept : m_semaphore{ semaphore } {}
+
+        AsyncSemaphore* m_semaphore{ nullptr };
+    };
+
+    explicit AsyncSemaphore(size_t permits);
+
+    asio::awaitable<Permit> Acquire();
+
+    // an empty permit unless one is free and nobody is waiting
+    Permit TryAcquire();
+
+    size_t Available() const;
+
+    size_t Waiting() const;
+
+private:
+    struct Waiter
+    {
+        std::shared_ptr<asio::steady_timer> m_wake;
+        // the permit is the waiter's from here on, even if it's cancelled
+        bool m_granted{ false };
+    };
+
+    void Release();
+
+    mutable std::mutex m_mutex{};
+    size_t m_available;
+    std::deque<std::shared_ptr<Waiter>> m_waiters{};
+};
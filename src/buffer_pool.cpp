@@ -0,0 +1,151 @@
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t N_CLASSES{ std::countr_zero(PooledBuffer::MAX_SIZE) - std::countr_zero(PooledBuffer::MIN_SIZE) + 1 };
+// per thread and class. enough to absorb bursts without pinning much memory once they're over
+constexpr size_t MAX_POOLED_BYTES_PER_CLASS{ 1024 * 1024 };
+
+std::atomic<size_t> g_leasedBytes{ 0 };
+std::atomic<size_t> g_leasedBuffers{ 0 };
+std::atomic<size_t> g_pooledBytes{ 0 };
+
+size_t class_of(size_t size) noexcept
+{
+    return static_cast<size_t>(std::countr_zero(std::bit_ceil(std::max(size, PooledBuffer::MIN_SIZE)))) -
+           static_cast<size_t>(std::countr_zero(PooledBuffer::MIN_SIZE));
+}
+
+constexpr size_t size_of_class(size_t cls) noexcept { return PooledBuffer::MIN_SIZE << cls; }
+
+struct ThreadPool
+{
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        for (size_t cls{ 0 }; cls < N_CLASSES; cls++)
+        {
+            g_pooledBytes.fetch_sub(m_free[cls].size() * size_of_class(cls), std::memory_order::relaxed);
+            for (char* data : m_free[cls])
+            {
+                delete[] data;
+            }
+        }
+    }
+
+    std::array<std::vector<char*>, N_CLASSES> m_free{};
+};
+
+ThreadPool& thread_pool()
+{
+    thread_local ThreadPool pool{};
+    return pool;
+}
+
+} // namespace
+
+PooledBuffer::PooledBuffer(size_t minSize)
+{
+    if (minSize > MAX_SIZE)
+    {
+        m_data = new char[minSize];
+        m_size = minSize;
+    }
+    else
+    {
+        const size_t cls{ class_of(minSize) };
+        m_size = size_of_class(cls);
+
+        auto& free{ thread_pool().m_free[cls] };
+        if (free.empty())
+        {
+            m_data = new char[m_size];
+        }
+        else
+        {
+            m_data = free.back();
+            free.pop_back();
+            g_pooledBytes.fetch_sub(m_size, std::memory_order::relaxed);
+        }
+    }
+
+    g_leasedBytes.fetch_add(m_size, std::memory_order::relaxed);
+    g_leasedBuffers.fetch_add(1, std::memory_order::relaxed);
+}
+
+PooledBuffer::~PooledBuffer() { Reset(); }
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept :
+    m_data{ std::exchange(other.m_data, nullptr) },
+    m_size{ std::exchange(other.m_size, 0) }
+{
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+
+    return *this;
+}
+
+void PooledBuffer::Reset() noexcept
+{
+    if (not m_data)
+    {
+        return;
+    }
+
+    g_leasedBytes.fetch_sub(m_size, std::memory_order::relaxed);
+    g_leasedBuffers.fetch_sub(1, std::memory_order::relaxed);
+
+    auto* data{ std::exchange(m_data, nullptr) };
+    const size_t size{ std::exchange(m_size, 0) };
+    if (size > MAX_SIZE)
+    {
+        delete[] data;
+        return;
+    }
+
+    const size_t cls{ class_of(size) };
+    auto& free{ thread_pool().m_free[cls] };
+    if ((free.size() + 1) * size > MAX_POOLED_BYTES_PER_CLASS)
+    {
+        delete[] data;
+        return;
+    }
+
+    // can only throw for lack of memory, in which case the buffer is better off freed
+    try
+    {
+        free.push_back(data);
+        g_pooledBytes.fetch_add(size, std::memory_order::relaxed);
+    }
+    catch (...)
+    {
+        delete[] data;
+    }
+}
+
+BufferPoolStats buffer_pool_stats() noexcept
+{
+    return BufferPoolStats{
+        .m_leasedBytes = g_leasedBytes.load(std::memory_order::relaxed),
+        .m_leasedBuffers = g_leasedBuffers.load(std::memory_order::relaxed),
+        .m_pooledBytes = g_pooledBytes.load(std::memory_order::relaxed),
+    };
+}
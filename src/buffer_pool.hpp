@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+struct BufferPoolStats
+{
+    // handed out and not yet returned, i.e held by connections
+    size_t m_leasedBytes;
+    size_t m_leasedBuffers;
+    // sitting in the per thread free lists
+    size_t m_pooledBytes;
+};
+
+// A buffer from the calling thread's pool. Power of two size classes from MIN_SIZE to MAX_SIZE, anything bigger
+// is allocated exactly and freed on release. Returns to the pool of whichever thread destroys it.
+class PooledBuffer
+{
+public:
+    static constexpr size_t MIN_SIZE{ 4 * 1024 };
+    static constexpr size_t MAX_SIZE{ 256 * 1024 };
+
+    PooledBuffer() = default;
+
+    // at least minSize bytes, uninitialised
+    explicit PooledBuffer(size_t minSize);
+
+    ~PooledBuffer();
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+
+    char* Data() const noexcept { return m_data; }
+
+    size_t Size() const noexcept { return m_size; }
+
+    explicit operator bool() const noexcept { return m_data != nullptr; }
+
+    // back to the pool
+    void Reset() noexcept;
+
+private:
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    char* m_data{ nullptr };
+    size_t m_size{ 0 };
+};
+
+BufferPoolStats buffer_pool_stats() noexcept;
@@ -1,12 +1,13 @@
 #include "channel_stuff.hpp"
 #include "async_aliases.hpp"
 #include "log/logger.hpp"
-#include <boost/asio/experimental/channel.hpp>
-#include <memory>
+#include <cstddef>
+#include <vector>
 
 using namespace std::chrono_literals;
 using namespace asio::experimental::awaitable_operators;
 
+// small enough to go through the channel by value, nothing to allocate per event
 struct AsyncEvent
 {
     enum Type
@@ -18,9 +19,12 @@ struct AsyncEvent
     Type type;
 };
 
-template<typename T> using Channel = asio::experimental::channel<void(boost::system::error_code, T)>;
+using EventChannel = Channel<AsyncEvent>;
 
-using EventChannel = Channel<std::unique_ptr<AsyncEvent>>;
+// the sender only waits once this many events are queued
+constexpr size_t EVENT_QUEUE{ 1024 };
+// events handled per resume of the receiver
+constexpr size_t EVENT_BATCH{ 64 };
 
 asio::awaitable<void> do_send(EventChannel& ch)
 {
@@ -31,25 +35,31 @@ asio::awaitable<void> do_send(EventChannel& ch)
         tm.expires_after(1s);
         co_await tm.async_wait();
 
-        auto event{ std::make_unique<AsyncEvent>(cntr % 2 == 0 ? AsyncEvent::A : AsyncEvent::B) };
+        AsyncEvent event{ cntr % 2 == 0 ? AsyncEvent::A : AsyncEvent::B };
         cntr++;
-        LOG_INFO("tx event {}", static_cast<int>(event->type));
-        co_await ch.async_send(boost::system::error_code{}, std::move(event));
+        LOG_INFO("tx event {}", static_cast<int>(event.type));
+        co_await send_or_wait(ch, event);
     }
 }
 
 asio::awaitable<void> do_recv(EventChannel& ch)
 {
+    std::vector<AsyncEvent> events{};
+    events.reserve(EVENT_BATCH);
     while (true)
     {
-        auto event{ co_await ch.async_receive() };
-        LOG_INFO("rx event {}", static_cast<int>(event->type));
+        events.clear();
+        co_await receive_batch(ch, events, EVENT_BATCH);
+        for (const auto& event : events)
+        {
+            LOG_INFO("rx event {}", static_cast<int>(event.type));
+        }
     }
 }
 
 asio::awaitable<void> start_channel_work()
 {
     LOG_INFO("starting");
-    EventChannel ch{ co_await asio::this_coro::executor };
+    EventChannel ch{ co_await asio::this_coro::executor, EVENT_QUEUE };
     co_await(do_send(ch) and do_recv(ch));
 }
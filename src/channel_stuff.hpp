@@ -1,6 +1,50 @@
-
 #pragma once
 
 #include "async_aliases.hpp"
+#include <boost/asio/experimental/channel.hpp>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+template<typename T> using Channel = asio::experimental::channel<void(boost::system::error_code, T)>;
+
+// Queues value without suspending while the channel has room, and only waits for the receiver once it's full
+template<typename ChannelT, typename T> asio::awaitable<void> send_or_wait(ChannelT& ch, T value)
+{
+    // value is only taken if it's accepted
+    if (not ch.try_send(boost::system::error_code{}, std::move(value)))
+    {
+        co_await ch.async_send(boost::system::error_code{}, std::move(value));
+    }
+}
+
+// Waits for the next value, then takes those already queued behind it without suspending again, up to maxBatch in
+// total, so a busy receiver resumes once per batch instead of once per value. Appends them to out and returns how
+// many. Throws like async_receive once the channel is closed and drained
+template<typename ChannelT, typename T>
+asio::awaitable<size_t> receive_batch(ChannelT& ch, std::vector<T>& out, size_t maxBatch)
+{
+    out.push_back(co_await ch.async_receive());
+
+    size_t nReceived{ 1 };
+    bool more{ true };
+    while (more and nReceived < maxBatch)
+    {
+        more = ch.try_receive(
+            [&](boost::system::error_code ec, T value)
+            {
+                if (ec)
+                {
+                    more = false;
+                    return;
+                }
+                out.push_back(std::move(value));
+                nReceived++;
+            }
+        );
+    }
+
+    co_return nReceived;
+}
 
 asio::awaitable<void> start_channel_work();
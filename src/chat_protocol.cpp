@@ -0,0 +1,64 @@
+#include "chat_protocol.hpp"
+#include <algorithm>
+
+namespace
+{
+
+bool is_space(char c) noexcept { return c == ' ' or c == '\t'; }
+
+// the next whitespace separated word, removed from text
+std::string_view take_word(std::string_view& text) noexcept
+{
+    const auto begin{ std::ranges::find_if_not(text, is_space) };
+    const auto end{ std::find_if(begin, text.end(), is_space) };
+    const std::string_view word{ begin, end };
+    text = { end, text.end() };
+    return word;
+}
+
+bool valid_topic(std::string_view topic) noexcept { return not topic.empty() and topic.size() <= MAX_TOPIC_BYTES; }
+
+} // namespace
+
+Command parse_command(std::string_view payload) noexcept
+{
+    if (not payload.starts_with('/'))
+    {
+        return Command{ .m_kind = CommandKind::Message, .m_topic = {}, .m_body = payload };
+    }
+
+    std::string_view rest{ payload };
+    const auto verb{ take_word(rest) };
+    const auto topic{ take_word(rest) };
+    if (not valid_topic(topic))
+    {
+        return Command{ .m_kind = CommandKind::Invalid, .m_topic = {}, .m_body = {} };
+    }
+
+    if (verb == "/pub")
+    {
+        // a single separator is dropped, the rest of the message is kept exactly as sent
+        if (not rest.empty())
+        {
+            rest.remove_prefix(1);
+        }
+        return Command{ .m_kind = CommandKind::Publish, .m_topic = topic, .m_body = rest };
+    }
+
+    // nothing may follow the topic
+    if (not take_word(rest).empty())
+    {
+        return Command{ .m_kind = CommandKind::Invalid, .m_topic = {}, .m_body = {} };
+    }
+
+    if (verb == "/sub")
+    {
+        return Command{ .m_kind = CommandKind::Subscribe, .m_topic = topic, .m_body = {} };
+    }
+    if (verb == "/unsub")
+    {
+        return Command{ .m_kind = CommandKind::Unsubscribe, .m_topic = topic, .m_body = {} };
+    }
+
+    return Command{ .m_kind = CommandKind::Invalid, .m_topic = {}, .m_body = {} };
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// What a client can send. Anything not starting with '/' is a message for everyone connected.
+//   /sub <topic>              receive what is published to topic from now on
+//   /unsub <topic>
+//   /pub <topic> <message>    relayed as is to topic's subscribers only
+enum class CommandKind
+{
+    Message,
+    Subscribe,
+    Unsubscribe,
+    Publish,
+    Invalid,
+};
+
+struct Command
+{
+    CommandKind m_kind;
+    // views into the parsed payload
+    std::string_view m_topic;
+    std::string_view m_body;
+};
+
+// topic names are at most this long and contain no whitespace
+constexpr size_t MAX_TOPIC_BYTES{ 64 };
+
+Command parse_command(std::string_view payload) noexcept;
@@ -0,0 +1,305 @@
+#include "client_registry.hpp"
+#include "log/logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+ClientRegistry::ClientRegistry(std::vector<asio::any_io_executor> shardExecutors)
+{
+    if (shardExecutors.empty() or shardExecutors.size() > MAX_SHARDS)
+    {
+        throw std::invalid_argument("client registry needs between 1 and 256 shards");
+    }
+
+    m_shards.reserve(shardExecutors.size());
+    for (auto& exc : shardExecutors)
+    {
+        m_shards.push_back(Shard{ .m_executor = std::move(exc) });
+    }
+}
+
+asio::awaitable<ConnectionId> ClientRegistry::Add(std::shared_ptr<ClientSession> session)
+{
+    const size_t shardIdx{ m_nextShard.fetch_add(1, std::memory_order::relaxed) % m_shards.size() };
+    co_return co_await Add(std::move(session), shardIdx);
+}
+
+asio::awaitable<ConnectionId> ClientRegistry::Add(std::shared_ptr<ClientSession> session, size_t shardIdx)
+{
+    auto& shard{ m_shards.at(shardIdx) };
+    co_return co_await asio::co_spawn(
+        shard.m_executor,
+        [self{ shared_from_this() }, &shard, shardIdx, session{ std::move(session) }] -> asio::awaitable<ConnectionId>
+        {
+            const ConnectionId id{ shard.Insert(shardIdx, session) };
+            self->m_size.fetch_add(1, std::memory_order::relaxed);
+            co_return id;
+        },
+        asio::deferred
+    );
+}
+
+void ClientRegistry::Remove(ConnectionId id)
+{
+    auto& shard{ m_shards.at(ShardOf(id)) };
+    asio::post(
+        shard.m_executor,
+        [self{ shared_from_this() }, &shard, id]
+        {
+            if (shard.Erase(id))
+            {
+                self->m_size.fetch_sub(1, std::memory_order::relaxed);
+            }
+        }
+    );
+}
+
+asio::awaitable<std::shared_ptr<ClientSession>> ClientRegistry::Find(ConnectionId id)
+{
+    auto& shard{ m_shards.at(ShardOf(id)) };
+    co_return co_await asio::co_spawn(
+        shard.m_executor,
+        [self{ shared_from_this() }, &shard, id] -> asio::awaitable<std::shared_ptr<ClientSession>>
+        { co_return shard.Lookup(id); },
+        asio::deferred
+    );
+}
+
+void ClientRegistry::Broadcast(BroadcastMessage msg, ConnectionId from)
+{
+    for (auto& shard : m_shards)
+    {
+        asio::post(
+            shard.m_executor,
+            [self{ shared_from_this() }, &shard, msg, from]
+            {
+                for (size_t idx{ 0 }; idx < shard.m_ids.size(); idx++)
+                {
+                    if (shard.m_ids[idx] != from)
+                    {
+                        shard.m_sessions[idx]->Deliver(msg);
+                    }
+                }
+            }
+        );
+    }
+}
+
+void ClientRegistry::Subscribe(ConnectionId id, std::string topic)
+{
+    auto& shard{ m_shards.at(ShardOf(id)) };
+    asio::post(
+        shard.m_executor,
+        [self{ shared_from_this() }, &shard, id, topic{ std::move(topic) }]
+        {
+            if (not shard.Subscribe(id, topic))
+            {
+                LOG_WARNING("connection {}: not subscribed to '{}', gone or at the subscription limit", id, topic);
+            }
+        }
+    );
+}
+
+void ClientRegistry::Unsubscribe(ConnectionId id, std::string topic)
+{
+    auto& shard{ m_shards.at(ShardOf(id)) };
+    asio::post(
+        shard.m_executor,
+        [self{ shared_from_this() }, &shard, id, topic{ std::move(topic) }] { shard.Unsubscribe(id, topic); }
+    );
+}
+
+void ClientRegistry::Publish(std::string topic, BroadcastMessage msg, ConnectionId from)
+{
+    for (auto& shard : m_shards)
+    {
+        asio::post(
+            shard.m_executor,
+            [self{ shared_from_this() }, &shard, topic, msg, from]
+            {
+                const Topic* subscribers{ shard.FindTopic(topic) };
+                if (subscribers == nullptr)
+                {
+                    return;
+                }
+
+                for (size_t idx{ 0 }; idx < subscribers->m_ids.size(); idx++)
+                {
+                    if (subscribers->m_ids[idx] != from)
+                    {
+                        subscribers->m_sessions[idx]->Deliver(msg);
+                    }
+                }
+            }
+        );
+    }
+}
+
+ConnectionId ClientRegistry::Shard::Insert(size_t shardIdx, std::shared_ptr<ClientSession> session)
+{
+    uint32_t slot{};
+    if (not m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        if (m_slotIndex.size() == MAX_SLOTS_PER_SHARD)
+        {
+            throw std::length_error("client registry shard is full");
+        }
+        slot = static_cast<uint32_t>(m_slotIndex.size());
+        m_slotIndex.push_back(NO_INDEX);
+        m_subscriptions.emplace_back();
+    }
+
+    const ConnectionId id{ static_cast<ConnectionId>(shardIdx << 24) | slot };
+    m_slotIndex[slot] = static_cast<uint32_t>(m_sessions.size());
+    m_sessions.push_back(std::move(session));
+    m_ids.push_back(id);
+
+    return id;
+}
+
+bool ClientRegistry::Shard::Erase(ConnectionId id)
+{
+    const uint32_t slot{ SlotOf(id) };
+    if (slot >= m_slotIndex.size() or m_slotIndex[slot] == NO_INDEX)
+    {
+        return false;
+    }
+
+    for (const uint32_t topicIdx : m_subscriptions[slot])
+    {
+        DropSubscriber(topicIdx, id);
+    }
+    m_subscriptions[slot].clear();
+
+    // swap with the back to keep the arrays dense
+    const uint32_t idx{ std::exchange(m_slotIndex[slot], NO_INDEX) };
+    const uint32_t lastIdx{ static_cast<uint32_t>(m_sessions.size() - 1) };
+    if (idx != lastIdx)
+    {
+        m_sessions[idx] = std::move(m_sessions[lastIdx]);
+        m_ids[idx] = m_ids[lastIdx];
+        m_slotIndex[SlotOf(m_ids[idx])] = idx;
+    }
+
+    m_sessions.pop_back();
+    m_ids.pop_back();
+    m_freeSlots.push_back(slot);
+
+    return true;
+}
+
+std::shared_ptr<ClientSession> ClientRegistry::Shard::Lookup(ConnectionId id) const
+{
+    const uint32_t slot{ SlotOf(id) };
+    if (slot >= m_slotIndex.size() or m_slotIndex[slot] == NO_INDEX)
+    {
+        return nullptr;
+    }
+
+    return m_sessions[m_slotIndex[slot]];
+}
+
+bool ClientRegistry::Shard::Subscribe(ConnectionId id, std::string_view topic)
+{
+    const uint32_t slot{ SlotOf(id) };
+    if (slot >= m_slotIndex.size() or m_slotIndex[slot] == NO_INDEX)
+    {
+        return false;
+    }
+
+    auto& subscriptions{ m_subscriptions[slot] };
+    if (subscriptions.size() >= MAX_SUBSCRIPTIONS)
+    {
+        return false;
+    }
+
+    uint32_t topicIdx{};
+    if (auto found{ m_topicIndex.find(topic) }; found != m_topicIndex.end())
+    {
+        topicIdx = found->second;
+        if (std::ranges::find(subscriptions, topicIdx) != subscriptions.end())
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (not m_freeTopics.empty())
+        {
+            topicIdx = m_freeTopics.back();
+            m_freeTopics.pop_back();
+        }
+        else
+        {
+            topicIdx = static_cast<uint32_t>(m_topics.size());
+            m_topics.emplace_back();
+        }
+        m_topics[topicIdx].m_name = topic;
+        m_topicIndex.emplace(topic, topicIdx);
+    }
+
+    auto& subscribers{ m_topics[topicIdx] };
+    subscribers.m_sessions.push_back(m_sessions[m_slotIndex[slot]]);
+    subscribers.m_ids.push_back(id);
+    subscriptions.push_back(topicIdx);
+
+    return true;
+}
+
+void ClientRegistry::Shard::Unsubscribe(ConnectionId id, std::string_view topic)
+{
+    const uint32_t slot{ SlotOf(id) };
+    const auto found{ m_topicIndex.find(topic) };
+    if (slot >= m_slotIndex.size() or m_slotIndex[slot] == NO_INDEX or found == m_topicIndex.end())
+    {
+        return;
+    }
+
+    auto& subscriptions{ m_subscriptions[slot] };
+    const auto pos{ std::ranges::find(subscriptions, found->second) };
+    if (pos == subscriptions.end())
+    {
+        return;
+    }
+
+    *pos = subscriptions.back();
+    subscriptions.pop_back();
+    DropSubscriber(found->second, id);
+}
+
+void ClientRegistry::Shard::DropSubscriber(uint32_t topicIdx, ConnectionId id)
+{
+    auto& subscribers{ m_topics[topicIdx] };
+    const auto idx{ static_cast<size_t>(std::ranges::find(subscribers.m_ids, id) - subscribers.m_ids.begin()) };
+    if (idx == subscribers.m_ids.size())
+    {
+        return;
+    }
+
+    // swap with the back to keep the arrays dense, subscriber order doesn't matter
+    if (idx != subscribers.m_ids.size() - 1)
+    {
+        subscribers.m_sessions[idx] = std::move(subscribers.m_sessions.back());
+        subscribers.m_ids[idx] = subscribers.m_ids.back();
+    }
+    subscribers.m_sessions.pop_back();
+    subscribers.m_ids.pop_back();
+
+    if (subscribers.m_ids.empty())
+    {
+        m_topicIndex.erase(subscribers.m_name);
+        subscribers.m_name.clear();
+        m_freeTopics.push_back(topicIdx);
+    }
+}
+
+const ClientRegistry::Topic* ClientRegistry::Shard::FindTopic(std::string_view topic) const
+{
+    const auto found{ m_topicIndex.find(topic) };
+    return found == m_topicIndex.end() ? nullptr : &m_topics[found->second];
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "client_session.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// [shard:8][slot:24]. Only meaningful while the connection is registered, slots get reused
+using ConnectionId = uint32_t;
+
+class ClientRegistry : public std::enable_shared_from_this<ClientRegistry>
+{
+public:
+    static constexpr size_t MAX_SHARDS{ 1 << 8 };
+    static constexpr size_t MAX_SLOTS_PER_SHARD{ 1 << 24 };
+    static constexpr size_t MAX_SUBSCRIPTIONS{ 64 };
+
+    // One shard per executor. Each executor must run its handlers serially, i.e a strand or a single threaded context
+    explicit ClientRegistry(std::vector<asio::any_io_executor> shardExecutors);
+
+    size_t ShardCount() const noexcept { return m_shards.size(); }
+
+    size_t Size() const noexcept { return m_size.load(std::memory_order::relaxed); }
+
+    // Registers session on the next shard round robin
+    asio::awaitable<ConnectionId> Add(std::shared_ptr<ClientSession> session);
+
+    // Registers session on a specific shard
+    asio::awaitable<ConnectionId> Add(std::shared_ptr<ClientSession> session, size_t shardIdx);
+
+    void Remove(ConnectionId id);
+
+    asio::awaitable<std::shared_ptr<ClientSession>> Find(ConnectionId id);
+
+    // Hands msg to every session but the sender. Shards fan out in parallel on their own executors
+    void Broadcast(BroadcastMessage msg, ConnectionId from);
+
+    // From now on id receives what is published to topic. Ignored past MAX_SUBSCRIPTIONS topics
+    void Subscribe(ConnectionId id, std::string topic);
+
+    void Unsubscribe(ConnectionId id, std::string topic);
+
+    // Hands msg to topic's subscribers but the sender. Every shard only visits its own subscribers of topic
+    void Publish(std::string topic, BroadcastMessage msg, ConnectionId from);
+
+    static constexpr size_t ShardOf(ConnectionId id) noexcept { return id >> 24; }
+
+    static constexpr uint32_t SlotOf(ConnectionId id) noexcept { return id & (MAX_SLOTS_PER_SHARD - 1); }
+
+private:
+    struct TopicHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view name) const noexcept { return std::hash<std::string_view>{}(name); }
+    };
+
+    struct Topic
+    {
+        std::string m_name{};
+
+        // dense and parallel like the shard's own, walked on every publish to the topic
+        std::vector<std::shared_ptr<ClientSession>> m_sessions{};
+        std::vector<ConnectionId> m_ids{};
+    };
+
+    struct Shard
+    {
+        static constexpr uint32_t NO_INDEX{ UINT32_MAX };
+
+        // only touched from m_executor
+        asio::any_io_executor m_executor;
+
+        // dense and parallel, walked on every broadcast
+        std::vector<std::shared_ptr<ClientSession>> m_sessions{};
+        std::vector<ConnectionId> m_ids{};
+
+        // slot -> index into m_sessions
+        std::vector<uint32_t> m_slotIndex{};
+        std::vector<uint32_t> m_freeSlots{};
+
+        // topics with at least one subscriber on this shard. Indices into m_topics are reused once a topic empties
+        std::vector<Topic> m_topics{};
+        std::vector<uint32_t> m_freeTopics{};
+        std::unordered_map<std::string, uint32_t, TopicHash, std::equal_to<>> m_topicIndex{};
+
+        // slot -> indices into m_topics, to drop a connection's subscriptions when it goes
+        std::vector<std::vector<uint32_t>> m_subscriptions{};
+
+        ConnectionId Insert(size_t shardIdx, std::shared_ptr<ClientSession> session);
+
+        bool Erase(ConnectionId id);
+
+        std::shared_ptr<ClientSession> Lookup(ConnectionId id) const;
+
+        bool Subscribe(ConnectionId id, std::string_view topic);
+
+        void Unsubscribe(ConnectionId id, std::string_view topic);
+
+        // leaves m_subscriptions to the caller
+        void DropSubscriber(uint32_t topicIdx, ConnectionId id);
+
+        const Topic* FindTopic(std::string_view topic) const;
+    };
+
+    std::vector<Shard> m_shards;
+    std::atomic<size_t> m_nextShard{ 0 };
+    std::atomic<size_t> m_size{ 0 };
+};
@@ -0,0 +1,315 @@
+#include "client_session.hpp"
+#include "buffer_pool.hpp"
+#include "log/logger.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+BroadcastMessage make_broadcast_message(std::string_view data) { return std::make_shared<const std::string>(data); }
+
+ClientSession::ClientSession(std::string tag, Stream stream, OutboundLimits limits, std::shared_ptr<FlowGate> gate) :
+    m_tag{ std::move(tag) },
+    m_stream{ std::move(stream) },
+    m_wakeup{ m_stream.get_executor() },
+    m_writeDeadline{ m_stream.get_executor() },
+    m_limits{ limits },
+    m_gate{ std::move(gate) }
+{
+    if (m_limits.m_policy == SlowConsumerPolicy::PauseProducers and not m_gate)
+    {
+        throw std::invalid_argument("pausing producers requires a flow gate");
+    }
+}
+
+void ClientSession::Deliver(BroadcastMessage msg)
+{
+    bool wakeWriter{ false };
+    bool closeGate{ false };
+    bool evict{ false };
+    {
+        std::lock_guard lk{ m_queueMutex };
+        if (m_closed)
+        {
+            return;
+        }
+
+        const size_t nBytes{ msg->size() };
+        if (OverBudget(nBytes))
+        {
+            switch (m_limits.m_policy)
+            {
+                case SlowConsumerPolicy::DropNewest:
+                    Drop(nBytes);
+                    return;
+
+                case SlowConsumerPolicy::DropOldest:
+                    while (not m_queue.empty() and OverBudget(nBytes))
+                    {
+                        Drop(m_queue.front()->size());
+                        m_queuedBytes -= m_queue.front()->size();
+                        m_queue.pop_front();
+                    }
+
+                    // the batch being written fills the budget by itself
+                    if (OverBudget(nBytes))
+                    {
+                        Drop(nBytes);
+                        return;
+                    }
+                    break;
+
+                case SlowConsumerPolicy::Disconnect:
+                    Drop(nBytes);
+                    for (const auto& queued : m_queue)
+                    {
+                        Drop(queued->size());
+                    }
+                    m_queue.clear();
+                    m_queuedBytes = 0;
+                    m_evicted = true;
+                    m_closed = true;
+                    evict = true;
+                    break;
+
+                case SlowConsumerPolicy::PauseProducers:
+                    closeGate = not std::exchange(m_congested, true);
+                    break;
+            }
+        }
+
+        if (not m_closed)
+        {
+            m_queue.push_back(std::move(msg));
+            m_queuedBytes += nBytes;
+        }
+        wakeWriter = std::exchange(m_writerParked, false);
+    }
+
+    if (closeGate)
+    {
+        m_gate->Close();
+    }
+
+    // a writer stuck on a client that stopped reading would never get to see the eviction
+    if (evict)
+    {
+        asio::post(m_stream.get_executor(), [self{ shared_from_this() }] { self->CloseSocket(); });
+    }
+
+    // only pay for a post when the writer is actually asleep
+    if (wakeWriter)
+    {
+        asio::post(m_stream.get_executor(), [self{ shared_from_this() }] { self->m_wakeup.cancel(); });
+    }
+}
+
+asio::awaitable<void> ClientSession::RunWriter()
+{
+    AtScopeExit closeGuard{ [this]
+                            {
+                                bool reopenGate{ false };
+                                {
+                                    std::lock_guard lk{ m_queueMutex };
+                                    m_closed = true;
+                                    m_queue.clear();
+                                    m_queuedBytes = 0;
+                                    reopenGate = std::exchange(m_congested, false);
+                                }
+
+                                if (reopenGate)
+                                {
+                                    m_gate->Open();
+                                }
+                                // a batch cut short goes back to the pool with the coroutine
+                                NoteWriteBytesHeld(0);
+                            } };
+
+    while (true)
+    {
+        bool evicted{ false };
+        {
+            std::lock_guard lk{ m_queueMutex };
+            evicted = m_evicted;
+            while (not m_closed and not m_queue.empty() and m_inflight.size() < MAX_BATCH_MESSAGES and
+                   m_inflightBytes < MAX_BATCH_BYTES)
+            {
+                m_inflightBytes += m_queue.front()->size();
+                m_queuedBytes -= m_queue.front()->size();
+                m_inflight.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+            m_writerParked = m_inflight.empty();
+            if (m_writerParked)
+            {
+                // a drained connection keeps no batch lists either
+                m_inflight.shrink_to_fit();
+            }
+        }
+
+        if (evicted)
+        {
+            LOG_INFO("evicting slow consumer {}. policy: {}", m_tag, to_string(m_limits.m_policy));
+            co_return;
+        }
+
+        if (m_inflight.empty())
+        {
+            m_gather.clear();
+            m_gather.shrink_to_fit();
+            UpdateHeldBytes();
+
+            // Deliver() cancels the wait once there is something to send
+            boost::system::error_code ec;
+            m_wakeup.expires_at(asio::steady_timer::time_point::max());
+            co_await m_wakeup.async_wait(asio::redirect_error(ec));
+
+            auto cs{ co_await asio::this_coro::cancellation_state };
+            if (cs.cancelled() != asio::cancellation_type::none)
+            {
+                co_return;
+            }
+            continue;
+        }
+
+        // A client that takes nothing for the write timeout has stopped reading. A record cut short can't be
+        // resumed, so the connection goes
+        boost::system::error_code ec;
+        if (m_kernelTransmit)
+        {
+            // the kernel takes the whole batch in one sendmsg
+            m_gather.clear();
+            for (const auto& msg : m_inflight)
+            {
+                m_gather.push_back(asio::buffer(*msg));
+            }
+            UpdateHeldBytes();
+            co_await m_writeDeadline.Within(
+                m_limits.m_writeTimeout,
+                asio::async_write(m_stream.next_layer(), m_gather, asio::deferred),
+                asio::redirect_error(asio::deferred, ec)
+            );
+        }
+        else
+        {
+            // ssl::stream encrypts one buffer per write_some, so a gather list would cost a record and a send per
+            // message. copied into one buffer it goes out in as few records as OpenSSL allows. the buffer is only
+            // leased for the write, so an idle connection holds none
+            PooledBuffer batch{ m_inflightBytes };
+            char* out{ batch.Data() };
+            for (const auto& msg : m_inflight)
+            {
+                out = std::ranges::copy(*msg, out).out;
+            }
+            NoteWriteBytesHeld(batch.Size());
+            co_await m_writeDeadline.Within(
+                m_limits.m_writeTimeout,
+                asio::async_write(m_stream, asio::buffer(batch.Data(), m_inflightBytes), asio::deferred),
+                asio::redirect_error(asio::deferred, ec)
+            );
+            batch.Reset();
+            NoteWriteBytesHeld(0);
+        }
+
+        if (ec == asio::error::timed_out)
+        {
+            LOG_INFO("closing {}. it took nothing for {}s", m_tag, m_limits.m_writeTimeout.count());
+            {
+                std::lock_guard lk{ m_queueMutex };
+                m_evicted = true;
+            }
+            CloseSocket();
+            co_return;
+        }
+        if (ec)
+        {
+            std::lock_guard lk{ m_queueMutex };
+            // evicted by Deliver(), which closed the socket under the write
+            if (not m_evicted)
+            {
+                throw boost::system::system_error{ ec };
+            }
+            continue;
+        }
+
+        {
+            std::lock_guard lk{ m_queueMutex };
+            m_inflight.clear();
+            m_inflightBytes = 0;
+        }
+        UpdateCongestion();
+    }
+}
+
+void ClientSession::NoteReadBytesHeld(size_t nBytes) noexcept
+{
+    m_readBytesHeld = nBytes;
+    UpdateHeldBytes();
+}
+
+void ClientSession::NoteWriteBytesHeld(size_t nBytes) noexcept
+{
+    m_writeBytesHeld = nBytes;
+    UpdateHeldBytes();
+}
+
+void ClientSession::UpdateHeldBytes() noexcept
+{
+    // the batch lists too, which only grow while there is something to send
+    const size_t listBytes{ m_inflight.capacity() * sizeof(BroadcastMessage) +
+                            m_gather.capacity() * sizeof(asio::const_buffer) };
+    const size_t nBytes{ m_readBytesHeld + m_writeBytesHeld + listBytes };
+    m_heldBytes.store(nBytes, std::memory_order_relaxed);
+    if (nBytes > m_peakHeldBytes.load(std::memory_order_relaxed))
+    {
+        m_peakHeldBytes.store(nBytes, std::memory_order_relaxed);
+    }
+}
+
+OutboundStats ClientSession::Stats() const
+{
+    std::lock_guard lk{ m_queueMutex };
+    return OutboundStats{
+        .m_queuedBytes = m_queuedBytes + m_inflightBytes,
+        .m_queuedMessages = m_queue.size() + m_inflight.size(),
+        .m_droppedBytes = m_droppedBytes,
+        .m_droppedMessages = m_droppedMessages,
+        .m_heldBytes = m_heldBytes.load(std::memory_order_relaxed),
+        .m_peakHeldBytes = m_peakHeldBytes.load(std::memory_order_relaxed),
+        .m_evicted = m_evicted,
+    };
+}
+
+bool ClientSession::OverBudget(size_t extraBytes) const noexcept
+{
+    return m_queue.size() + m_inflight.size() + 1 > m_limits.m_maxMessages or
+           m_queuedBytes + m_inflightBytes + extraBytes > m_limits.m_maxBytes;
+}
+
+void ClientSession::Drop(size_t nBytes) noexcept
+{
+    m_droppedBytes += nBytes;
+    m_droppedMessages++;
+}
+
+void ClientSession::UpdateCongestion()
+{
+    {
+        std::lock_guard lk{ m_queueMutex };
+        // only reopen at half the budget so a consumer hovering at the limit doesn't flap the gate
+        if (not m_congested or m_queuedBytes * 2 > m_limits.m_maxBytes or
+            m_queue.size() * 2 > m_limits.m_maxMessages)
+        {
+            return;
+        }
+        m_congested = false;
+    }
+
+    m_gate->Open();
+}
+
+void ClientSession::CloseSocket()
+{
+    boost::system::error_code ec;
+    m_stream.lowest_layer().close(ec);
+}
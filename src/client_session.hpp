@@ -0,0 +1,113 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "deadline.hpp"
+#include "flow_gate.hpp"
+#include "server_config.hpp"
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable payload. Built once per incoming message and shared by every recipient's queue
+using BroadcastMessage = std::shared_ptr<const std::string>;
+
+BroadcastMessage make_broadcast_message(std::string_view data);
+
+struct OutboundStats
+{
+    // includes the batch currently being written
+    size_t m_queuedBytes;
+    size_t m_queuedMessages;
+    size_t m_droppedBytes;
+    size_t m_droppedMessages;
+    // read and write buffers leased from the pool, and the writer's batch lists, now and at most
+    size_t m_heldBytes;
+    size_t m_peakHeldBytes;
+    bool m_evicted;
+};
+
+class ClientSession : public std::enable_shared_from_this<ClientSession>
+{
+public:
+    using Stream = ssl::stream<asio::ip::tcp::socket>;
+
+    // upper bounds for what a single write will coalesce
+    static constexpr size_t MAX_BATCH_MESSAGES{ 64 };
+    static constexpr size_t MAX_BATCH_BYTES{ 64 * 1024 };
+
+    // gate is shared by the room and only used by SlowConsumerPolicy::PauseProducers
+    ClientSession(std::string tag, Stream stream, OutboundLimits limits, std::shared_ptr<FlowGate> gate);
+
+    const std::string& Tag() const noexcept { return m_tag; }
+
+    Stream& GetStream() noexcept { return m_stream; }
+
+    // The kernel encrypts what is sent from now on (see KernelTls). Call before RunWriter()
+    void UseKernelTransmit() noexcept { m_kernelTransmit = true; }
+
+    bool KernelTransmit() const noexcept { return m_kernelTransmit; }
+
+    // Queue msg for this client, subject to the outbound limits. Safe to call from any thread
+    void Deliver(BroadcastMessage msg);
+
+    // Drains the queue until cancelled, evicted or a write fails or times out. Must run on the stream's executor
+    asio::awaitable<void> RunWriter();
+
+    // What the reader's frame parser holds. Called by the reader after every read, on the stream's executor
+    void NoteReadBytesHeld(size_t nBytes) noexcept;
+
+    OutboundStats Stats() const;
+
+private:
+    // m_queueMutex must be held
+    bool OverBudget(size_t extraBytes) const noexcept;
+
+    void Drop(size_t nBytes) noexcept;
+
+    void UpdateCongestion();
+
+    // fails whatever the reader and writer are waiting for. on the stream's executor
+    void CloseSocket();
+
+    void NoteWriteBytesHeld(size_t nBytes) noexcept;
+
+    // the buffers and batch lists held now, for Stats(). on the stream's executor
+    void UpdateHeldBytes() noexcept;
+
+    std::string m_tag;
+    Stream m_stream;
+    // parked writers wait on this. cancelled to wake them up
+    asio::steady_timer m_wakeup;
+    Deadline m_writeDeadline;
+    const OutboundLimits m_limits;
+    std::shared_ptr<FlowGate> m_gate;
+    bool m_kernelTransmit{ false };
+
+    mutable std::mutex m_queueMutex{};
+    std::deque<BroadcastMessage> m_queue{};
+    size_t m_queuedBytes{ 0 };
+    size_t m_inflightBytes{ 0 };
+    size_t m_droppedBytes{ 0 };
+    size_t m_droppedMessages{ 0 };
+    bool m_writerParked{ false };
+    bool m_closed{ false };
+    bool m_evicted{ false };
+    bool m_congested{ false };
+
+    // only touched on the stream's executor
+    size_t m_readBytesHeld{ 0 };
+    size_t m_writeBytesHeld{ 0 };
+    // their sum, for Stats() from anywhere
+    std::atomic<size_t> m_heldBytes{ 0 };
+    std::atomic<size_t> m_peakHeldBytes{ 0 };
+
+    // reused between batches and given up when the writer parks. only touched by the writer
+    std::vector<BroadcastMessage> m_inflight{};
+    // the batch as buffers for the kernel
+    std::vector<asio::const_buffer> m_gather{};
+};
@@ -0,0 +1,212 @@
+#include "content_decoder.hpp"
+#include <algorithm>
+#include <brotli/decode.h>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+namespace
+{
+
+bool equals_ignore_case(std::string_view lhs, std::string_view rhs) noexcept
+{
+    return std::ranges::equal(
+        lhs, rhs, [](char l, char r) { return std::tolower(static_cast<unsigned char>(l)) == r; }
+    );
+}
+
+// zlib's header (RFC 1950) rather than the bare deflate data (RFC 1951) some servers send as deflate
+bool has_zlib_header(char first) noexcept
+{
+    const auto cmf{ static_cast<unsigned char>(first) };
+    return (cmf & 0x0f) == Z_DEFLATED and (cmf >> 4) <= 7;
+}
+
+// the first byte of a gzip member. inflate checks the rest of the header
+constexpr unsigned char GZIP_ID1{ 0x1f };
+
+} // namespace
+
+std::optional<ContentEncoding> parse_content_encoding(std::string_view value) noexcept
+{
+    const auto first{ value.find_first_not_of(" \t") };
+    if (first == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    value = value.substr(first, value.find_last_not_of(" \t") - first + 1);
+
+    if (equals_ignore_case(value, "gzip") or equals_ignore_case(value, "x-gzip"))
+    {
+        return ContentEncoding::Gzip;
+    }
+    if (equals_ignore_case(value, "deflate"))
+    {
+        return ContentEncoding::Deflate;
+    }
+    if (equals_ignore_case(value, "br"))
+    {
+        return ContentEncoding::Brotli;
+    }
+    return std::nullopt;
+}
+
+struct ContentDecoder::Codec
+{
+    explicit Codec(ContentEncoding encoding) :
+        m_encoding{ encoding }
+    {
+    }
+
+    ~Codec()
+    {
+        if (m_zlibStarted)
+        {
+            inflateEnd(&m_zlib);
+        }
+        if (m_brotli)
+        {
+            BrotliDecoderDestroyInstance(m_brotli);
+        }
+    }
+
+    Codec(const Codec&) = delete;
+
+    Codec& operator=(const Codec&) = delete;
+
+    // Once a gzip member ended, starts on the next one if that's what in holds. False for anything else
+    bool StartNextMember(std::span<const char> in)
+    {
+        if (m_encoding != ContentEncoding::Gzip or not m_zlibStarted or in.empty() or
+            static_cast<unsigned char>(in.front()) != GZIP_ID1)
+        {
+            return false;
+        }
+
+        if (inflateReset(&m_zlib) != Z_OK)
+        {
+            throw std::runtime_error{ "corrupt compressed body. can't start the next gzip member" };
+        }
+        m_ended = false;
+        return true;
+    }
+
+    const ContentEncoding m_encoding;
+    z_stream m_zlib{};
+    // waits for the first byte, which tells the two kinds of deflate apart
+    bool m_zlibStarted{ false };
+    BrotliDecoderState* m_brotli{ nullptr };
+    bool m_ended{ false };
+};
+
+ContentDecoder::ContentDecoder(ContentEncoding encoding, size_t outBytes) :
+    m_codec{ std::make_unique<Codec>(encoding) },
+    m_out(outBytes)
+{
+    if (encoding == ContentEncoding::Brotli)
+    {
+        m_codec->m_brotli = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        if (not m_codec->m_brotli)
+        {
+            throw std::bad_alloc{};
+        }
+    }
+}
+
+ContentDecoder::~ContentDecoder() = default;
+
+void ContentDecoder::Feed(std::span<const char> input)
+{
+    m_in = input;
+}
+
+std::span<const char> ContentDecoder::Next()
+{
+    if (m_codec->m_ended and not m_codec->StartNextMember(m_in))
+    {
+        m_in = {};
+        return {};
+    }
+
+    // Both libraries may hold output back once it filled m_out, so they are asked again even when all of the input
+    // has gone in, until they have nothing more to give
+    if (m_codec->m_encoding == ContentEncoding::Brotli)
+    {
+        size_t availIn{ m_in.size() };
+        const auto* nextIn{ reinterpret_cast<const uint8_t*>(m_in.data()) };
+        size_t availOut{ m_out.size() };
+        auto* nextOut{ reinterpret_cast<uint8_t*>(m_out.data()) };
+        const auto res{ BrotliDecoderDecompressStream(
+            m_codec->m_brotli, &availIn, &nextIn, &availOut, &nextOut, nullptr
+        ) };
+        if (res == BROTLI_DECODER_RESULT_ERROR)
+        {
+            throw std::runtime_error{ std::string{ "corrupt brotli body. " } +
+                                      BrotliDecoderErrorString(BrotliDecoderGetErrorCode(m_codec->m_brotli)) };
+        }
+
+        m_codec->m_ended = res == BROTLI_DECODER_RESULT_SUCCESS;
+        m_in = m_in.last(availIn);
+        return std::span<const char>{ m_out.data(), m_out.size() - availOut };
+    }
+
+    auto& zlib{ m_codec->m_zlib };
+    if (not m_codec->m_zlibStarted)
+    {
+        if (m_in.empty())
+        {
+            return {};
+        }
+
+        int windowBits{ MAX_WBITS };
+        if (m_codec->m_encoding == ContentEncoding::Gzip)
+        {
+            windowBits += 16;
+        }
+        else if (not has_zlib_header(m_in.front()))
+        {
+            windowBits = -windowBits;
+        }
+
+        if (inflateInit2(&zlib, windowBits) != Z_OK)
+        {
+            throw std::bad_alloc{};
+        }
+        m_codec->m_zlibStarted = true;
+    }
+
+    while (true)
+    {
+        zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(m_in.data()));
+        zlib.avail_in = static_cast<uInt>(m_in.size());
+        zlib.next_out = reinterpret_cast<Bytef*>(m_out.data());
+        zlib.avail_out = static_cast<uInt>(m_out.size());
+
+        const int rc{ inflate(&zlib, Z_NO_FLUSH) };
+        // Z_BUF_ERROR only says that there was nothing to do
+        if (rc != Z_OK and rc != Z_STREAM_END and rc != Z_BUF_ERROR)
+        {
+            throw std::runtime_error{ std::string{ "corrupt compressed body. " } +
+                                      (zlib.msg ? zlib.msg : std::to_string(rc)) };
+        }
+
+        m_codec->m_ended = rc == Z_STREAM_END;
+        m_in = m_in.last(zlib.avail_in);
+        const size_t nOut{ m_out.size() - zlib.avail_out };
+        // coming back empty would tell the caller the chunk is done while the next member is still in it
+        if (nOut > 0 or not m_codec->m_ended or not m_codec->StartNextMember(m_in))
+        {
+            return std::span<const char>{ m_out.data(), nOut };
+        }
+    }
+}
+
+void ContentDecoder::Finish() const
+{
+    if (not m_codec->m_ended)
+    {
+        throw std::runtime_error{ "compressed body ended early" };
+    }
+}
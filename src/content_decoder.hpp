@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+enum class ContentEncoding
+{
+    Gzip,
+    Deflate,
+    Brotli,
+};
+
+// What a request offers in Accept-Encoding, best first
+inline constexpr std::string_view ACCEPT_ENCODING{ "br, gzip, deflate" };
+
+// A single Content-Encoding value, case insensitive. nullopt for identity, stacked codings and anything unknown,
+// whose bodies are passed on as they are
+std::optional<ContentEncoding> parse_content_encoding(std::string_view value) noexcept;
+
+// Decodes a body as it arrives, in pieces of at most outBytes.
+// Feed it each received chunk, then take output from Next() until it comes back empty. The chunk has to stay valid
+// until then. Throws std::runtime_error on corrupt input, and from Finish() when the body ended before its encoding
+// did. A gzip body may be several members one after the other (RFC 1952 2.2), which decode as one. Whatever else
+// follows the end of the encoded data is ignored
+class ContentDecoder
+{
+public:
+    ContentDecoder(ContentEncoding encoding, size_t outBytes);
+
+    ~ContentDecoder();
+
+    ContentDecoder(const ContentDecoder&) = delete;
+
+    ContentDecoder& operator=(const ContentDecoder&) = delete;
+
+    void Feed(std::span<const char> input);
+
+    // valid until the next call
+    std::span<const char> Next();
+
+    void Finish() const;
+
+private:
+    struct Codec;
+
+    std::unique_ptr<Codec> m_codec;
+    std::vector<char> m_out;
+    std::span<const char> m_in{};
+};
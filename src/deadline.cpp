@@ -0,0 +1,38 @@
+#include "deadline.hpp"
+
+Deadline::Deadline(asio::any_io_executor exc) : m_timer{ std::move(exc) } {}
+
+boost::system::error_code Deadline::Outcome(boost::system::error_code ec) const
+{
+    // the timer is cancelled once the operation completes, but keeps its expiry
+    if (ec == asio::error::operation_aborted and Expired())
+    {
+        return asio::error::timed_out;
+    }
+    return ec;
+}
+
+std::exception_ptr Deadline::Outcome(std::exception_ptr error) const
+{
+    // only worth looking into once the limit has passed
+    if (not error or not Expired())
+    {
+        return error;
+    }
+
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const boost::system::system_error& e)
+    {
+        if (e.code() == asio::error::operation_aborted)
+        {
+            return std::make_exception_ptr(boost::system::system_error{ asio::error::timed_out });
+        }
+    }
+    catch (...)
+    {
+    }
+    return error;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <chrono>
+#include <exception>
+#include <utility>
+
+// A time limit for the asynchronous operations of one coroutine, run one after the other on a timer it reuses.
+// Racing an operation against timeout() with `or` costs a parallel group, a coroutine frame and a timer for the
+// timeout and a variant for the result. Here the operation is cancelled through its cancellation slot once the limit
+// passes, and completes with asio::error::timed_out instead of the operation_aborted that leaves it with.
+//
+//     Deadline deadline{ co_await asio::this_coro::executor };
+//     co_await deadline.Within(10s, stream.async_handshake(ssl::stream_base::client, asio::deferred));
+//
+// A coroutine is bounded the same way through co_spawn, whose slot passes the cancellation on to whatever operation
+// the coroutine is waiting for. It then throws operation_aborted from there, which becomes timed_out as well
+//
+//     co_await deadline.Within(30s, asio::co_spawn(exc, fetch(), asio::deferred));
+//
+// The cancellation is emitted from the executor, so it has to be the one the operations run on. Works for
+// operations that complete with an error code or an exception_ptr first.
+class Deadline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Deadline(asio::any_io_executor exc);
+
+    Deadline(const Deadline&) = delete;
+    Deadline& operator=(const Deadline&) = delete;
+
+    // op is a deferred operation. Completes token with what op completes with, like op(token) would
+    template<typename Op, typename Token = asio::deferred_t>
+    auto Within(Clock::duration limit, Op&& op, Token&& token = {})
+    {
+        auto translated{ asio::deferred(
+            [this](auto error, auto... results)
+            { return asio::deferred.values(Outcome(std::move(error)), std::move(results)...); }
+        ) };
+        return std::forward<Op>(op)(asio::cancel_after(m_timer, limit, std::move(translated)))(
+            std::forward<Token>(token)
+        );
+    }
+
+    // the limit of the last Within() has passed
+    bool Expired() const noexcept { return m_timer.expiry() <= Clock::now(); }
+
+private:
+    // timed_out for an operation cancelled because the limit passed
+    boost::system::error_code Outcome(boost::system::error_code ec) const;
+
+    std::exception_ptr Outcome(std::exception_ptr error) const;
+
+    asio::steady_timer m_timer;
+};
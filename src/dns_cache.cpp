@@ -0,0 +1,158 @@
+#include "dns_cache.hpp"
+#include "log/logger.hpp"
+#include <algorithm>
+#include <utility>
+
+DnsCache::DnsCache(DnsCacheConfig cfg) :
+    m_cfg{ cfg }
+{
+}
+
+asio::awaitable<DnsCache::Results> DnsCache::Resolve(std::string host, std::string service)
+{
+    enum class Action
+    {
+        Serve,
+        ServeAndRefresh,
+        Wait,
+        Lookup,
+    };
+
+    auto exc{ co_await asio::this_coro::executor };
+    std::string key{ host + '/' + service };
+    const auto now{ std::chrono::steady_clock::now() };
+    auto action{ Action::Lookup };
+    Results results{};
+    std::shared_ptr<Waiter> waiter{};
+    {
+        std::lock_guard lk{ m_mutex };
+        if (m_entries.size() >= m_sweepAt)
+        {
+            Sweep(now);
+            m_sweepAt = std::max(MIN_SWEEP_ENTRIES, 2 * m_entries.size());
+        }
+
+        auto& entry{ m_entries[key] };
+        const auto age{ now - entry.m_resolvedAt };
+        if (entry.m_results and age < m_cfg.m_ttl)
+        {
+            action = Action::Serve;
+            results = *entry.m_results;
+            m_hits.fetch_add(1, std::memory_order::relaxed);
+        }
+        else if (entry.m_results and age < m_cfg.m_ttl + m_cfg.m_maxStale)
+        {
+            action = entry.m_inFlight ? Action::Serve : Action::ServeAndRefresh;
+            results = *entry.m_results;
+            entry.m_inFlight = true;
+            m_staleHits.fetch_add(1, std::memory_order::relaxed);
+        }
+        else if (entry.m_inFlight)
+        {
+            action = Action::Wait;
+            waiter = std::make_shared<Waiter>(exc, 1);
+            entry.m_waiters.push_back(waiter);
+            m_merged.fetch_add(1, std::memory_order::relaxed);
+        }
+        else
+        {
+            // the caller's own lookup reports to it like to everyone merged into it
+            entry.m_inFlight = true;
+            waiter = std::make_shared<Waiter>(exc, 1);
+            entry.m_waiters.push_back(waiter);
+        }
+    }
+
+    switch (action)
+    {
+        case Action::Serve:
+            co_return results;
+
+        case Action::ServeAndRefresh:
+            StartLookup(exc, std::move(key), std::move(host), std::move(service));
+            co_return results;
+
+        case Action::Wait:
+            // throws what the lookup failed with
+            co_return co_await waiter->async_receive();
+
+        case Action::Lookup:
+            break;
+    }
+
+    // Detached, so cancelling the caller that started it, e.g. when its deadline passes, only cancels its wait and
+    // not the lookup everyone else merged into
+    StartLookup(exc, std::move(key), std::move(host), std::move(service));
+    co_return co_await waiter->async_receive();
+}
+
+DnsCacheStats DnsCache::Stats() const noexcept
+{
+    return DnsCacheStats{
+        .m_hits = m_hits.load(std::memory_order::relaxed),
+        .m_staleHits = m_staleHits.load(std::memory_order::relaxed),
+        .m_merged = m_merged.load(std::memory_order::relaxed),
+        .m_lookups = m_lookups.load(std::memory_order::relaxed),
+        .m_failures = m_failures.load(std::memory_order::relaxed),
+    };
+}
+
+void DnsCache::StartLookup(asio::any_io_executor exc, std::string key, std::string host, std::string service)
+{
+    asio::co_spawn(
+        exc,
+        [self{ shared_from_this() }, key{ std::move(key) }, host{ std::move(host) }, service{ std::move(service) }]
+            -> asio::awaitable<void>
+        {
+            co_await self->Lookup(key, host, service);
+        },
+        detached_log_exception{ Sage::Logger::Level::Warning }
+    );
+}
+
+asio::awaitable<void> DnsCache::Lookup(std::string key, std::string host, std::string service)
+{
+    m_lookups.fetch_add(1, std::memory_order::relaxed);
+
+    asio::ip::tcp::resolver resolver{ co_await asio::this_coro::executor };
+    boost::system::error_code ec;
+    auto results{ co_await resolver.async_resolve(host, service, asio::redirect_error(ec)) };
+
+    std::vector<std::shared_ptr<Waiter>> waiters{};
+    {
+        std::lock_guard lk{ m_mutex };
+        auto& entry{ m_entries[key] };
+        entry.m_inFlight = false;
+        if (not ec)
+        {
+            entry.m_results = results;
+            entry.m_resolvedAt = std::chrono::steady_clock::now();
+        }
+        waiters = std::exchange(entry.m_waiters, {});
+    }
+
+    // room for one, so this never fails
+    for (auto& waiter : waiters)
+    {
+        waiter->try_send(ec, results);
+    }
+
+    if (ec)
+    {
+        m_failures.fetch_add(1, std::memory_order::relaxed);
+        LOG_WARNING("resolving {}:{} failed. {}", host, service, ec.message());
+    }
+}
+
+void DnsCache::Sweep(std::chrono::steady_clock::time_point now)
+{
+    std::erase_if(
+        m_entries,
+        [&](const auto& keyEntry)
+        {
+            const auto& entry{ keyEntry.second };
+            return not entry.m_inFlight and
+                   (not entry.m_results or now - entry.m_resolvedAt >= m_cfg.m_ttl + m_cfg.m_maxStale);
+        }
+    );
+}
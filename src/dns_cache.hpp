@@ -0,0 +1,88 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <atomic>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct DnsCacheConfig
+{
+    // getaddrinfo doesn't report record TTLs, so every answer is trusted for this long
+    std::chrono::steady_clock::duration m_ttl{ std::chrono::seconds{ 60 } };
+    // past its TTL an answer is still served for this long while it's refreshed in the background
+    std::chrono::steady_clock::duration m_maxStale{ std::chrono::minutes{ 10 } };
+};
+
+struct DnsCacheStats
+{
+    size_t m_hits;
+    // answered past the TTL, with a refresh started or already running
+    size_t m_staleHits;
+    // waited for a lookup of the same name that was already running
+    size_t m_merged;
+    size_t m_lookups;
+    size_t m_failures;
+};
+
+// Resolver answers by host and service, shared by everything that connects out.
+// A fresh answer costs a hash lookup. A stale one is served as is while a single background lookup refreshes it.
+// Without a usable answer the first caller resolves and everyone else asking for the same name meanwhile waits for
+// that lookup instead of starting their own. A failed refresh keeps the stale answer until it's too old to serve, after
+// which the name is forgotten.
+class DnsCache : public std::enable_shared_from_this<DnsCache>
+{
+public:
+    using Results = asio::ip::tcp::resolver::results_type;
+
+    explicit DnsCache(DnsCacheConfig cfg = {});
+
+    asio::awaitable<Results> Resolve(std::string host, std::string service);
+
+    DnsCacheStats Stats() const noexcept;
+
+private:
+    // sweeps start once there are this many names
+    static constexpr size_t MIN_SWEEP_ENTRIES{ 256 };
+
+    // Hands a caller the outcome of a lookup already running. Holds it until the caller gets to wait for it, and the
+    // lookup may finish on any thread
+    using Waiter = asio::experimental::concurrent_channel<void(boost::system::error_code, Results)>;
+
+    struct Entry
+    {
+        std::optional<Results> m_results{};
+        std::chrono::steady_clock::time_point m_resolvedAt{};
+        bool m_inFlight{ false };
+        std::vector<std::shared_ptr<Waiter>> m_waiters{};
+    };
+
+    // Lookup() on exc, detached from the caller and its cancellation
+    void StartLookup(asio::any_io_executor exc, std::string key, std::string host, std::string service);
+
+    // resolves and hands the outcome to the callers waiting on key
+    asio::awaitable<void> Lookup(std::string key, std::string host, std::string service);
+
+    // forgets the names too old to serve that nothing is looking up. Under m_mutex
+    void Sweep(std::chrono::steady_clock::time_point now);
+
+    const DnsCacheConfig m_cfg;
+
+    std::mutex m_mutex{};
+    // "host/service"
+    std::unordered_map<std::string, Entry> m_entries{};
+    // doubles with what a sweep leaves, so sweeping stays linear in the number of lookups
+    size_t m_sweepAt{ MIN_SWEEP_ENTRIES };
+
+    std::atomic<size_t> m_hits{ 0 };
+    std::atomic<size_t> m_staleHits{ 0 };
+    std::atomic<size_t> m_merged{ 0 };
+    std::atomic<size_t> m_lookups{ 0 };
+    std::atomic<size_t> m_failures{ 0 };
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Storage for events of type T, recycled through a free list per thread, so a steady stream of events allocates
+// nothing once the lists are warm. An event goes back to the list of whichever thread destroys it, which keeps up to
+// MAX_POOLED_EVENTS and frees the rest. Events small and cheap to move are better passed by value.
+template<typename T> class EventPool
+{
+public:
+    static constexpr size_t MAX_POOLED_EVENTS{ 4096 };
+
+    struct Deleter
+    {
+        void operator()(T* event) const noexcept
+        {
+            event->~T();
+            EventPool::Release(event);
+        }
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    template<typename... Args> static Ptr Make(Args&&... args)
+    {
+        void* storage{ Acquire() };
+        try
+        {
+            return Ptr{ new (storage) T(std::forward<Args>(args)...) };
+        }
+        catch (...)
+        {
+            Release(storage);
+            throw;
+        }
+    }
+
+    // events sitting in the calling thread's list
+    static size_t Pooled() noexcept { return ThreadFreeList().m_free.size(); }
+
+private:
+    struct FreeList
+    {
+        // reserved up front so giving an event back never allocates
+        FreeList() { m_free.reserve(MAX_POOLED_EVENTS); }
+
+        FreeList(const FreeList&) = delete;
+        FreeList& operator=(const FreeList&) = delete;
+
+        ~FreeList()
+        {
+            for (void* storage : m_free)
+            {
+                ::operator delete(storage, std::align_val_t{ alignof(T) });
+            }
+        }
+
+        std::vector<void*> m_free;
+    };
+
+    static FreeList& ThreadFreeList()
+    {
+        thread_local FreeList list{};
+        return list;
+    }
+
+    static void* Acquire()
+    {
+        auto& free{ ThreadFreeList().m_free };
+        if (free.empty())
+        {
+            return ::operator new(sizeof(T), std::align_val_t{ alignof(T) });
+        }
+
+        void* storage{ free.back() };
+        free.pop_back();
+        return storage;
+    }
+
+    static void Release(void* storage) noexcept
+    {
+        auto& free{ ThreadFreeList().m_free };
+        if (free.size() < MAX_POOLED_EVENTS)
+        {
+            free.push_back(storage);
+            return;
+        }
+        ::operator delete(storage, std::align_val_t{ alignof(T) });
+    }
+};
+
+template<typename T> using PooledEvent = typename EventPool<T>::Ptr;
+
+template<typename T, typename... Args> PooledEvent<T> make_pooled_event(Args&&... args)
+{
+    return EventPool<T>::Make(std::forward<Args>(args)...);
+}
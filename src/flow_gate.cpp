@@ -0,0 +1,56 @@
+#include "flow_gate.hpp"
+#include <utility>
+
+void FlowGate::Close()
+{
+    std::lock_guard lk{ m_mutex };
+    m_closers++;
+}
+
+void FlowGate::Open()
+{
+    std::vector<std::shared_ptr<asio::steady_timer>> waiters{};
+    {
+        std::lock_guard lk{ m_mutex };
+        if (m_closers == 0 or --m_closers > 0)
+        {
+            return;
+        }
+        waiters = std::exchange(m_waiters, {});
+    }
+
+    for (auto& waiter : waiters)
+    {
+        asio::post(waiter->get_executor(), [waiter] { waiter->cancel(); });
+    }
+}
+
+bool FlowGate::IsOpen()
+{
+    std::lock_guard lk{ m_mutex };
+    return m_closers == 0;
+}
+
+asio::awaitable<void> FlowGate::WaitOpen()
+{
+    auto waiter{ std::make_shared<asio::steady_timer>(
+        co_await asio::this_coro::executor, asio::steady_timer::time_point::max()
+    ) };
+
+    {
+        std::lock_guard lk{ m_mutex };
+        if (m_closers == 0)
+        {
+            co_return;
+        }
+        m_waiters.push_back(waiter);
+    }
+
+    // cancelled by Open(), or by cancelling the caller. either way the caller re-checks before its next read
+    boost::system::error_code ec;
+    co_await waiter->async_wait(asio::redirect_error(ec));
+
+    // Open() took it out already, unless the caller was cancelled
+    std::lock_guard lk{ m_mutex };
+    std::erase(m_waiters, waiter);
+}
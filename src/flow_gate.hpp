@@ -0,0 +1,27 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Producers park here while any consumer they feed is congested.
+// Waiters must be running on a strand, the wakeup is posted to it.
+class FlowGate
+{
+public:
+    // each Close() holds the gate shut until it's matched by an Open()
+    void Close();
+
+    void Open();
+
+    bool IsOpen();
+
+    asio::awaitable<void> WaitOpen();
+
+private:
+    std::mutex m_mutex{};
+    size_t m_closers{ 0 };
+    std::vector<std::shared_ptr<asio::steady_timer>> m_waiters{};
+};
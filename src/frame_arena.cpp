@@ -0,0 +1,443 @@
+#include "frame_arena.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+// Nothing here may use operator new, it might be what called
+
+namespace
+{
+
+// in front of every block, keeps what follows it aligned like malloc would
+struct alignas(16) Header
+{
+    // nullptr for allocations straight from malloc
+    struct Arena* m_owner;
+    uint32_t m_sizeClass;
+    // from where malloc's allocation starts to the pointer handed out
+    uint32_t m_offset;
+};
+
+constexpr size_t HEADER_BYTES{ sizeof(Header) };
+// what a block holds after its header, 64 bytes to 8 KiB
+constexpr size_t MIN_USABLE_SHIFT{ 6 };
+constexpr size_t MAX_USABLE_SHIFT{ 13 };
+constexpr size_t MIN_USABLE_BYTES{ size_t{ 1 } << MIN_USABLE_SHIFT };
+constexpr size_t MAX_USABLE_BYTES{ size_t{ 1 } << MAX_USABLE_SHIFT };
+// a power of two, and one and a half times it, for every doubling
+constexpr size_t N_SIZE_CLASSES{ 2 * (MAX_USABLE_SHIFT - MIN_USABLE_SHIFT) + 1 };
+constexpr uint32_t FROM_MALLOC{ UINT32_MAX };
+constexpr size_t SLAB_BYTES{ 256 * 1024 };
+// blocks freed for another thread are sent back this many at a time
+constexpr size_t RETURN_BATCH{ 32 };
+// arenas a thread collects blocks for at once
+constexpr size_t OUTBOX_SLOTS{ 4 };
+
+// a free block, where the pointer handed out was
+struct FreeBlock
+{
+    FreeBlock* m_next;
+};
+
+// Only ever written by the thread using the arena, so adding needs no read-modify-write
+struct Counter
+{
+    void Add(uint64_t n) noexcept
+    {
+        m_value.store(m_value.load(std::memory_order::relaxed) + n, std::memory_order::relaxed);
+    }
+
+    uint64_t Get() const noexcept { return m_value.load(std::memory_order::relaxed); }
+
+    std::atomic<uint64_t> m_value{ 0 };
+};
+
+struct Counters
+{
+    Counter m_allocations{};
+    Counter m_hits{};
+    Counter m_mallocs{};
+    Counter m_slabBytes{};
+    Counter m_blocksAllocated{};
+    Counter m_blocksFreed{};
+    Counter m_bytesAllocated{};
+    Counter m_bytesFreed{};
+};
+
+struct Arena
+{
+    std::array<FreeBlock*, N_SIZE_CLASSES> m_free{};
+    std::byte* m_slab{ nullptr };
+    std::byte* m_slabEnd{ nullptr };
+    Counters m_counters{};
+    // every arena, for Stats(). set before the arena is published and never changed
+    Arena* m_nextArena{ nullptr };
+    // guarded by g_orphansMutex
+    Arena* m_nextOrphan{ nullptr };
+
+    // blocks sent back by other threads
+    alignas(64) std::atomic<FreeBlock*> m_returned{ nullptr };
+};
+
+// blocks collected for one other arena
+struct Outbox
+{
+    Arena* m_owner;
+    FreeBlock* m_head;
+    FreeBlock* m_tail;
+    size_t m_count;
+};
+
+constinit std::atomic<Arena*> g_arenas{ nullptr };
+constinit std::mutex g_orphansMutex{};
+// arenas of threads that exited, for the next thread to take over
+constinit Arena* g_orphans{ nullptr };
+
+// what threads without an arena, exiting ones, did. counted with read-modify-writes
+constinit std::atomic<uint64_t> g_strayFreedBlocks{ 0 };
+constinit std::atomic<uint64_t> g_strayFreedBytes{ 0 };
+constinit std::atomic<uint64_t> g_strayAllocations{ 0 };
+constinit std::atomic<uint64_t> g_strayMallocs{ 0 };
+
+thread_local Arena* t_arena{ nullptr };
+thread_local bool t_exited{ false };
+thread_local std::array<Outbox, OUTBOX_SLOTS> t_outbox{};
+
+Header* header_of(void* ptr) noexcept { return reinterpret_cast<Header*>(static_cast<std::byte*>(ptr) - HEADER_BYTES); }
+
+// Rounds up what the caller asked for, not what it takes with the header, so a 4 KiB buffer fits a 4 KiB class
+// instead of doubling to the next power of two. Half steps keep rounding to at most a half
+uint32_t size_class(size_t size) noexcept
+{
+    const size_t usable{ std::max(size, MIN_USABLE_BYTES) };
+    // the smallest power of two usable fits in, and the half step below it
+    const auto shift{ static_cast<size_t>(std::bit_width(usable - 1)) };
+    const size_t below{ size_t{ 1 } << (shift - 1) };
+    if (usable <= below + below / 2)
+    {
+        return static_cast<uint32_t>(2 * (shift - 1 - MIN_USABLE_SHIFT) + 1);
+    }
+    return static_cast<uint32_t>(2 * (shift - MIN_USABLE_SHIFT));
+}
+
+// header included. a multiple of the header, so blocks carved one after the other all stay aligned
+size_t block_bytes(uint32_t sizeClass) noexcept
+{
+    const size_t usable{ (sizeClass % 2 == 0 ? MIN_USABLE_BYTES : MIN_USABLE_BYTES + MIN_USABLE_BYTES / 2)
+                         << (sizeClass / 2) };
+    return HEADER_BYTES + usable;
+}
+
+void send_back(Arena* owner, FreeBlock* head, FreeBlock* tail) noexcept
+{
+    tail->m_next = owner->m_returned.load(std::memory_order::relaxed);
+    while (not owner->m_returned.compare_exchange_weak(
+        tail->m_next, head, std::memory_order::release, std::memory_order::relaxed
+    ))
+    {
+    }
+}
+
+void flush(Outbox& outbox) noexcept
+{
+    if (outbox.m_count > 0)
+    {
+        send_back(outbox.m_owner, outbox.m_head, outbox.m_tail);
+    }
+    outbox = Outbox{};
+}
+
+void return_to_owner(Arena* owner, FreeBlock* block) noexcept
+{
+    block->m_next = nullptr;
+    if (t_exited)
+    {
+        send_back(owner, block, block);
+        return;
+    }
+
+    auto slot{ std::ranges::find(t_outbox, owner, &Outbox::m_owner) };
+    if (slot == t_outbox.end())
+    {
+        slot = std::ranges::find(t_outbox, nullptr, &Outbox::m_owner);
+    }
+    if (slot == t_outbox.end())
+    {
+        // the one collecting the most is the closest to a full batch anyway
+        slot = std::ranges::max_element(t_outbox, {}, &Outbox::m_count);
+        flush(*slot);
+    }
+
+    if (slot->m_count == 0)
+    {
+        *slot = Outbox{ .m_owner = owner, .m_head = block, .m_tail = block, .m_count = 1 };
+    }
+    else
+    {
+        slot->m_tail->m_next = block;
+        slot->m_tail = block;
+        slot->m_count++;
+    }
+
+    if (slot->m_count == RETURN_BATCH)
+    {
+        flush(*slot);
+    }
+}
+
+// Gives the thread's arena to the next thread and sends back what was collected for others
+struct ThreadExit
+{
+    ~ThreadExit()
+    {
+        for (auto& outbox : t_outbox)
+        {
+            flush(outbox);
+        }
+
+        std::lock_guard lk{ g_orphansMutex };
+        t_arena->m_nextOrphan = g_orphans;
+        g_orphans = t_arena;
+        t_arena = nullptr;
+        t_exited = true;
+    }
+};
+
+Arena* make_arena() noexcept
+{
+    {
+        std::lock_guard lk{ g_orphansMutex };
+        if (g_orphans)
+        {
+            Arena* arena{ g_orphans };
+            g_orphans = arena->m_nextOrphan;
+            return arena;
+        }
+    }
+
+    void* storage{ std::aligned_alloc(alignof(Arena), sizeof(Arena)) };
+    if (not storage)
+    {
+        return nullptr;
+    }
+    auto* arena{ new (storage) Arena{} };
+    arena->m_nextArena = g_arenas.load(std::memory_order::relaxed);
+    while (not g_arenas.compare_exchange_weak(
+        arena->m_nextArena, arena, std::memory_order::release, std::memory_order::relaxed
+    ))
+    {
+    }
+    return arena;
+}
+
+// nullptr once the thread is exiting, or without memory for an arena
+Arena* local_arena() noexcept
+{
+    if (t_arena or t_exited)
+    {
+        return t_arena;
+    }
+
+    t_arena = make_arena();
+    if (t_arena)
+    {
+        // constructed on first use, so only threads that allocated pay for the exit hook
+        thread_local ThreadExit exitHook{};
+    }
+    return t_arena;
+}
+
+void* allocate_from_malloc(Arena* arena, size_t size, size_t alignment)
+{
+    if (arena)
+    {
+        arena->m_counters.m_allocations.Add(1);
+        arena->m_counters.m_mallocs.Add(1);
+    }
+    else
+    {
+        g_strayAllocations.fetch_add(1, std::memory_order::relaxed);
+        g_strayMallocs.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    // the header right in front of the pointer handed out, which stays aligned
+    const size_t offset{ std::max(alignment, HEADER_BYTES) };
+    if (size > SIZE_MAX - 2 * offset)
+    {
+        throw std::bad_alloc{};
+    }
+    // aligned_alloc wants a multiple of the alignment
+    const size_t nBytes{ (size + offset + offset - 1) / offset * offset };
+    void* raw{ offset <= alignof(std::max_align_t) ? std::malloc(nBytes) : std::aligned_alloc(offset, nBytes) };
+    if (not raw)
+    {
+        throw std::bad_alloc{};
+    }
+
+    void* ptr{ static_cast<std::byte*>(raw) + offset };
+    *header_of(ptr) = Header{
+        .m_owner = nullptr,
+        .m_sizeClass = FROM_MALLOC,
+        .m_offset = static_cast<uint32_t>(offset),
+    };
+    return ptr;
+}
+
+// picks up the blocks other threads sent back. false if there were none
+bool take_returned(Arena& arena) noexcept
+{
+    FreeBlock* block{ arena.m_returned.exchange(nullptr, std::memory_order::acquire) };
+    if (not block)
+    {
+        return false;
+    }
+
+    while (block)
+    {
+        FreeBlock* next{ block->m_next };
+        auto& free{ arena.m_free[header_of(block)->m_sizeClass] };
+        block->m_next = free;
+        free = block;
+        block = next;
+    }
+    return true;
+}
+
+std::byte* carve(Arena& arena, size_t nBytes)
+{
+    if (static_cast<size_t>(arena.m_slabEnd - arena.m_slab) < nBytes)
+    {
+        // what's left of the old slab is too small for this size, and stays unused
+        auto* slab{ static_cast<std::byte*>(std::aligned_alloc(HEADER_BYTES, SLAB_BYTES)) };
+        if (not slab)
+        {
+            throw std::bad_alloc{};
+        }
+        arena.m_counters.m_mallocs.Add(1);
+        arena.m_counters.m_slabBytes.Add(SLAB_BYTES);
+        arena.m_slab = slab;
+        arena.m_slabEnd = slab + SLAB_BYTES;
+    }
+
+    std::byte* block{ arena.m_slab };
+    arena.m_slab += nBytes;
+    return block;
+}
+
+} // namespace
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    Arena* arena{ local_arena() };
+    if (not arena or alignment > HEADER_BYTES or size > MAX_USABLE_BYTES)
+    {
+        return allocate_from_malloc(arena, size, alignment);
+    }
+
+    const uint32_t sizeClass{ size_class(size) };
+    const size_t nBytes{ block_bytes(sizeClass) };
+    auto& counters{ arena->m_counters };
+    counters.m_allocations.Add(1);
+    counters.m_blocksAllocated.Add(1);
+    counters.m_bytesAllocated.Add(nBytes);
+
+    auto& free{ arena->m_free[sizeClass] };
+    if (not free)
+    {
+        take_returned(*arena);
+    }
+
+    void* ptr{ nullptr };
+    if (free)
+    {
+        ptr = free;
+        free = free->m_next;
+        counters.m_hits.Add(1);
+    }
+    else
+    {
+        ptr = carve(*arena, nBytes) + HEADER_BYTES;
+    }
+
+    *header_of(ptr) = Header{ .m_owner = arena, .m_sizeClass = sizeClass, .m_offset = HEADER_BYTES };
+    return ptr;
+}
+
+void FrameArena::Deallocate(void* ptr) noexcept
+{
+    if (not ptr)
+    {
+        return;
+    }
+
+    const Header header{ *header_of(ptr) };
+    if (header.m_sizeClass == FROM_MALLOC)
+    {
+        std::free(static_cast<std::byte*>(ptr) - header.m_offset);
+        return;
+    }
+
+    const size_t nBytes{ block_bytes(header.m_sizeClass) };
+    // a thread that only frees gets an arena too, for the exit hook that sends back what it collected
+    Arena* arena{ local_arena() };
+    if (arena)
+    {
+        arena->m_counters.m_blocksFreed.Add(1);
+        arena->m_counters.m_bytesFreed.Add(nBytes);
+    }
+    else
+    {
+        g_strayFreedBlocks.fetch_add(1, std::memory_order::relaxed);
+        g_strayFreedBytes.fetch_add(nBytes, std::memory_order::relaxed);
+    }
+
+    auto* block{ new (ptr) FreeBlock{ nullptr } };
+    if (header.m_owner != arena)
+    {
+        return_to_owner(header.m_owner, block);
+        return;
+    }
+
+    auto& free{ arena->m_free[header.m_sizeClass] };
+    block->m_next = free;
+    free = block;
+}
+
+FrameArenaStats FrameArena::Stats() noexcept
+{
+    uint64_t blocksAllocated{ 0 };
+    uint64_t blocksFreed{ g_strayFreedBlocks.load(std::memory_order::relaxed) };
+    uint64_t bytesAllocated{ 0 };
+    uint64_t bytesFreed{ g_strayFreedBytes.load(std::memory_order::relaxed) };
+    FrameArenaStats stats{
+        .m_liveBlocks = 0,
+        .m_liveBytes = 0,
+        .m_slabBytes = 0,
+        .m_allocations = g_strayAllocations.load(std::memory_order::relaxed),
+        .m_hits = 0,
+        .m_mallocs = g_strayMallocs.load(std::memory_order::relaxed),
+    };
+
+    for (Arena* arena{ g_arenas.load(std::memory_order::acquire) }; arena; arena = arena->m_nextArena)
+    {
+        const auto& counters{ arena->m_counters };
+        blocksAllocated += counters.m_blocksAllocated.Get();
+        blocksFreed += counters.m_blocksFreed.Get();
+        bytesAllocated += counters.m_bytesAllocated.Get();
+        bytesFreed += counters.m_bytesFreed.Get();
+        stats.m_slabBytes += counters.m_slabBytes.Get();
+        stats.m_allocations += counters.m_allocations.Get();
+        stats.m_hits += counters.m_hits.Get();
+        stats.m_mallocs += counters.m_mallocs.Get();
+    }
+
+    // counted on different threads, so briefly off while blocks are in flight
+    stats.m_liveBlocks = blocksAllocated > blocksFreed ? blocksAllocated - blocksFreed : 0;
+    stats.m_liveBytes = bytesAllocated > bytesFreed ? bytesAllocated - bytesFreed : 0;
+    return stats;
+}
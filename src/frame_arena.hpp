@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Built with CPP_CORO_FRAME_ARENA these count every allocation of the process, not just coroutine frames
+struct FrameArenaStats
+{
+    // handed out from the arenas and not freed yet, with headers and rounding
+    uint64_t m_liveBlocks;
+    uint64_t m_liveBytes;
+    // taken from malloc to carve blocks from, never given back
+    uint64_t m_slabBytes;
+    uint64_t m_allocations;
+    // allocations served from a free list
+    uint64_t m_hits;
+    // slabs, and allocations too large or too aligned for a block
+    uint64_t m_mallocs;
+
+    double HitRate() const noexcept
+    {
+        return m_allocations ? static_cast<double>(m_hits) / static_cast<double>(m_allocations) : 0.0;
+    }
+};
+
+// Blocks for coroutine frames, out of arenas kept per thread.
+// asio only recycles the last couple of frames a thread freed, so anything nested deeper, or many coroutines
+// starting and finishing at once, goes to malloc. With the CPP_CORO_FRAME_ARENA build option its recycling is
+// turned off and frames come from the global operator new, which frame_arena_new.cpp hands to this. That makes it
+// the allocator for every other small allocation too.
+// Sizes from 64 bytes to 8 KiB are rounded up to a power of two or one and a half times one, with a 16 byte header
+// on top, and every size has a free list per thread, so a block freed where it was allocated is ready for the next
+// allocation of its size without locking.
+// A block freed on another thread is sent back to the one that allocated it, in batches, and picked up once that
+// thread's free list of its size runs dry. Arenas outlive their threads and are handed to new ones. Slabs are never
+// given back, so memory stays at its peak for the rest of the process, which is why the build option is off by
+// default. Larger or over-aligned allocations go straight to malloc.
+class FrameArena
+{
+public:
+    static void* Allocate(size_t size, size_t alignment);
+
+    static void Deallocate(void* ptr) noexcept;
+
+    // summed over every thread
+    static FrameArenaStats Stats() noexcept;
+};
@@ -0,0 +1,21 @@
+// The global operator new and delete, handed to FrameArena. Linked into executables by the CPP_CORO_FRAME_ARENA
+// build option rather than being part of the core library, where a static library's copy could go unused
+
+#include "frame_arena.hpp"
+#include <cstddef>
+#include <new>
+
+void* operator new(size_t size) { return FrameArena::Allocate(size, alignof(std::max_align_t)); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return FrameArena::Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { FrameArena::Deallocate(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { FrameArena::Deallocate(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { FrameArena::Deallocate(ptr); }
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { FrameArena::Deallocate(ptr); }
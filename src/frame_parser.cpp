@@ -0,0 +1,184 @@
+#include "frame_parser.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+size_t find_newline_scalar(const char* data, size_t begin, size_t size) noexcept
+{
+    const void* found{ std::memchr(data + begin, '\n', size - begin) };
+    return found ? static_cast<size_t>(static_cast<const char*>(found) - data) : size;
+}
+
+} // namespace
+
+size_t find_newline(std::string_view data) noexcept
+{
+    const char* ptr{ data.data() };
+    const size_t size{ data.size() };
+    size_t idx{ 0 };
+
+#if defined(__AVX2__)
+    const __m256i newlines{ _mm256_set1_epi8('\n') };
+    for (; idx + sizeof(__m256i) <= size; idx += sizeof(__m256i))
+    {
+        const __m256i chunk{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + idx)) };
+        const auto mask{ static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newlines))) };
+        if (mask != 0)
+        {
+            return idx + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i newlines{ _mm_set1_epi8('\n') };
+    for (; idx + sizeof(__m128i) <= size; idx += sizeof(__m128i))
+    {
+        const __m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + idx)) };
+        const auto mask{ static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newlines))) };
+        if (mask != 0)
+        {
+            return idx + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+#endif
+
+    // the tail shorter than a vector, or everything without SIMD
+    return find_newline_scalar(ptr, idx, size);
+}
+
+FrameParser::FrameParser(FramingConfig cfg) :
+    m_cfg{ cfg }
+{
+}
+
+std::span<char> FrameParser::Prepare()
+{
+    if (m_data.Size() - m_end < MIN_READ_BYTES)
+    {
+        const size_t pending{ Pending() };
+        if (m_begin > 0)
+        {
+            // everything before m_begin has been handed out already, slide the unfinished frame to the front
+            std::memmove(m_data.Data(), m_data.Data() + m_begin, pending);
+            m_scanned -= m_begin;
+            m_begin = 0;
+            m_end = pending;
+        }
+
+        if (m_data.Size() - m_end < MIN_READ_BYTES)
+        {
+            // only a frame bigger than the buffer gets here. Next() caps how far that can go
+            PooledBuffer data{ std::max(m_data.Size() * 2, pending + MIN_READ_BYTES) };
+            if (pending > 0)
+            {
+                std::memcpy(data.Data(), m_data.Data(), pending);
+            }
+            m_data = std::move(data);
+        }
+    }
+
+    return { m_data.Data() + m_end, m_data.Size() - m_end };
+}
+
+void FrameParser::Commit(size_t nBytes) noexcept { m_end += std::min(nBytes, m_data.Size() - m_end); }
+
+void FrameParser::Append(std::string_view data)
+{
+    while (not data.empty())
+    {
+        auto space{ Prepare() };
+        const size_t nBytes{ std::min(space.size(), data.size()) };
+        std::memcpy(space.data(), data.data(), nBytes);
+        Commit(nBytes);
+        data.remove_prefix(nBytes);
+    }
+}
+
+void FrameParser::Release() noexcept
+{
+    if (Pending() > 0)
+    {
+        return;
+    }
+
+    m_data.Reset();
+    m_begin = 0;
+    m_scanned = 0;
+    m_end = 0;
+}
+
+std::optional<Frame> FrameParser::Next()
+{
+    switch (m_cfg.m_mode)
+    {
+        case FramingMode::Newline:
+            return NextLine();
+        case FramingMode::LengthPrefixed:
+            return NextLengthPrefixed();
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Frame> FrameParser::NextLine()
+{
+    const size_t newline{ m_scanned + find_newline({ m_data.Data() + m_scanned, m_end - m_scanned }) };
+    if (newline == m_end)
+    {
+        m_scanned = m_end;
+        if (Pending() > m_cfg.m_maxFrameBytes)
+        {
+            throw FrameTooLarge("line longer than " + std::to_string(m_cfg.m_maxFrameBytes) + " bytes");
+        }
+        return std::nullopt;
+    }
+
+    std::string_view wire{ m_data.Data() + m_begin, newline + 1 - m_begin };
+    std::string_view payload{ wire.substr(0, wire.size() - 1) };
+    if (payload.ends_with('\r'))
+    {
+        payload.remove_suffix(1);
+    }
+    if (payload.size() > m_cfg.m_maxFrameBytes)
+    {
+        throw FrameTooLarge("line longer than " + std::to_string(m_cfg.m_maxFrameBytes) + " bytes");
+    }
+
+    m_begin = newline + 1;
+    m_scanned = m_begin;
+    return Frame{ .m_payload = payload, .m_wire = wire };
+}
+
+std::optional<Frame> FrameParser::NextLengthPrefixed()
+{
+    if (Pending() < LENGTH_PREFIX_BYTES)
+    {
+        return std::nullopt;
+    }
+
+    const auto* prefix{ reinterpret_cast<const unsigned char*>(m_data.Data() + m_begin) };
+    const size_t length{ (static_cast<size_t>(prefix[0]) << 24) | (static_cast<size_t>(prefix[1]) << 16) |
+                         (static_cast<size_t>(prefix[2]) << 8) | static_cast<size_t>(prefix[3]) };
+    if (length > m_cfg.m_maxFrameBytes)
+    {
+        throw FrameTooLarge(
+            "frame of " + std::to_string(length) + " bytes exceeds " + std::to_string(m_cfg.m_maxFrameBytes)
+        );
+    }
+    if (Pending() < LENGTH_PREFIX_BYTES + length)
+    {
+        return std::nullopt;
+    }
+
+    std::string_view wire{ m_data.Data() + m_begin, LENGTH_PREFIX_BYTES + length };
+    m_begin += wire.size();
+    m_scanned = m_begin;
+    return Frame{ .m_payload = wire.substr(LENGTH_PREFIX_BYTES), .m_wire = wire };
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "buffer_pool.hpp"
+#include "server_config.hpp"
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+struct Frame
+{
+    // the message itself
+    std::string_view m_payload;
+    // the message as it came off the wire, delimiter or length prefix included. relayed as is
+    std::string_view m_wire;
+};
+
+// The stream can't be resynchronised after this, the connection has to go
+class FrameTooLarge : public std::length_error
+{
+public:
+    using std::length_error::length_error;
+};
+
+// Splits a client's byte stream into frames without copying it.
+// Reads go straight into the space Prepare() hands out, Commit() makes them visible and Next() then returns every
+// complete frame until it returns nullopt. One read may hold any number of frames and one frame may span any
+// number of reads. Consumed bytes are reclaimed lazily: only the unfinished tail is ever moved, and only once the
+// free space at the end runs out.
+// The buffer comes from the thread's PooledBuffer pool and can be handed back with Release() between frames.
+class FrameParser
+{
+public:
+    static constexpr size_t LENGTH_PREFIX_BYTES{ 4 };
+    // smallest read Prepare() offers
+    static constexpr size_t MIN_READ_BYTES{ 4096 };
+
+    explicit FrameParser(FramingConfig cfg);
+
+    // Space for the next read. Invalidates frames returned so far
+    std::span<char> Prepare();
+
+    void Commit(size_t nBytes) noexcept;
+
+    // Views stay valid until the next Prepare(). Throws FrameTooLarge
+    std::optional<Frame> Next();
+
+    // Copies data in, for reads that didn't go through Prepare()
+    void Append(std::string_view data);
+
+    // received bytes not yet returned as part of a frame
+    size_t Pending() const noexcept { return m_end - m_begin; }
+
+    // Returns the buffer to the pool if there is no unfinished frame in it. Invalidates frames returned so far
+    void Release() noexcept;
+
+    size_t HeldBytes() const noexcept { return m_data.Size(); }
+
+private:
+    std::optional<Frame> NextLine();
+
+    std::optional<Frame> NextLengthPrefixed();
+
+    const FramingConfig m_cfg;
+    PooledBuffer m_data{};
+    // first byte not yet returned in a frame
+    size_t m_begin{ 0 };
+    // newline search resumes here so a frame spanning reads is only scanned once
+    size_t m_scanned{ 0 };
+    size_t m_end{ 0 };
+};
+
+// Position of the first '\n' in data or data.size(). Vectorised for anything longer than a vector
+size_t find_newline(std::string_view data) noexcept;
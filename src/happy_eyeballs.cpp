@@ -0,0 +1,164 @@
+#include "happy_eyeballs.hpp"
+#include "log/logger.hpp"
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace
+{
+
+// Shared by the attempts and the coroutine starting them, all of them on one strand
+struct Race
+{
+    Race(const asio::any_io_executor& strand, std::vector<asio::ip::tcp::endpoint> endpoints) :
+        m_endpoints{ std::move(endpoints) },
+        m_signals(m_endpoints.size()),
+        m_wake{ strand }
+    {
+    }
+
+    const std::vector<asio::ip::tcp::endpoint> m_endpoints;
+    // cancels the attempt of the same index
+    std::vector<asio::cancellation_signal> m_signals;
+    // cancelled whenever an attempt finishes
+    asio::steady_timer m_wake;
+
+    std::optional<asio::ip::tcp::socket> m_winner{};
+    size_t m_failed{ 0 };
+    boost::system::error_code m_lastError{};
+
+    void CancelAll()
+    {
+        for (auto& signal : m_signals)
+        {
+            signal.emit(asio::cancellation_type::terminal);
+        }
+    }
+};
+
+asio::awaitable<void> attempt(std::shared_ptr<Race> race, size_t idx)
+{
+    asio::ip::tcp::socket socket{ co_await asio::this_coro::executor };
+    boost::system::error_code ec;
+    co_await socket.async_connect(race->m_endpoints[idx], asio::redirect_error(ec));
+
+    if (ec)
+    {
+        LOG_DEBUG(
+            "connect to {}:{} failed. {}",
+            race->m_endpoints[idx].address().to_string(),
+            race->m_endpoints[idx].port(),
+            ec.message()
+        );
+        race->m_failed++;
+        race->m_lastError = ec;
+    }
+    else if (not race->m_winner)
+    {
+        race->m_winner.emplace(std::move(socket));
+    }
+    // else a runner up connected before its cancellation landed and is closed here
+
+    race->m_wake.cancel();
+}
+
+asio::awaitable<asio::ip::tcp::socket> run_race(
+    std::vector<asio::ip::tcp::endpoint> endpoints,
+    std::chrono::steady_clock::duration attemptDelay
+)
+{
+    auto strand{ co_await asio::this_coro::executor };
+    auto race{ std::make_shared<Race>(strand, std::move(endpoints)) };
+    const size_t nEndpoints{ race->m_endpoints.size() };
+
+    size_t started{ 0 };
+    size_t failedBefore{ 0 };
+    auto nextStart{ std::chrono::steady_clock::now() };
+    while (not race->m_winner and race->m_failed < nEndpoints)
+    {
+        const bool due{ std::chrono::steady_clock::now() >= nextStart or race->m_failed > failedBefore };
+        if (started < nEndpoints and due)
+        {
+            asio::co_spawn(
+                strand,
+                attempt(race, started),
+                asio::bind_cancellation_slot(race->m_signals[started].slot(), asio::detached)
+            );
+            started++;
+            failedBefore = race->m_failed;
+            nextStart = std::chrono::steady_clock::now() + attemptDelay;
+            continue;
+        }
+
+        race->m_wake.expires_at(started < nEndpoints ? nextStart : std::chrono::steady_clock::time_point::max());
+        boost::system::error_code ec;
+        co_await race->m_wake.async_wait(asio::redirect_error(ec));
+
+        auto cs{ co_await asio::this_coro::cancellation_state };
+        if (cs.cancelled() != asio::cancellation_type::none)
+        {
+            race->CancelAll();
+            throw boost::system::system_error{ asio::error::operation_aborted };
+        }
+    }
+
+    race->CancelAll();
+    if (not race->m_winner)
+    {
+        throw boost::system::system_error{ race->m_lastError };
+    }
+
+    co_return std::move(*race->m_winner);
+}
+
+} // namespace
+
+std::vector<asio::ip::tcp::endpoint> interleave_families(const asio::ip::tcp::resolver::results_type& resolved)
+{
+    std::vector<asio::ip::tcp::endpoint> preferred{};
+    std::vector<asio::ip::tcp::endpoint> other{};
+    for (const auto& entry : resolved)
+    {
+        const auto ep{ entry.endpoint() };
+        if (preferred.empty() or ep.protocol() == preferred.front().protocol())
+        {
+            preferred.push_back(ep);
+        }
+        else
+        {
+            other.push_back(ep);
+        }
+    }
+
+    std::vector<asio::ip::tcp::endpoint> endpoints{};
+    endpoints.reserve(preferred.size() + other.size());
+    for (size_t idx{ 0 }; idx < preferred.size() or idx < other.size(); idx++)
+    {
+        if (idx < preferred.size())
+        {
+            endpoints.push_back(preferred[idx]);
+        }
+        if (idx < other.size())
+        {
+            endpoints.push_back(other[idx]);
+        }
+    }
+
+    return endpoints;
+}
+
+asio::awaitable<asio::ip::tcp::socket> happy_eyeballs_connect(
+    std::vector<asio::ip::tcp::endpoint> endpoints,
+    std::chrono::steady_clock::duration attemptDelay
+)
+{
+    if (endpoints.empty())
+    {
+        throw boost::system::system_error{ asio::error::host_not_found };
+    }
+
+    // the caller's executor may run on several threads, the race needs its own strand
+    auto strand{ asio::make_strand(co_await asio::this_coro::executor) };
+    co_return co_await asio::co_spawn(strand, run_race(std::move(endpoints), attemptDelay), asio::use_awaitable);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <chrono>
+#include <vector>
+
+// The order to try resolved addresses in: the resolver's order with the two address families alternating, starting
+// with the family of its first answer
+std::vector<asio::ip::tcp::endpoint> interleave_families(const asio::ip::tcp::resolver::results_type& resolved);
+
+// Connects to whichever of endpoints accepts first, Happy Eyeballs style (RFC 8305).
+// Attempts start in order, each one attemptDelay after the previous, or right away once a running attempt fails, so
+// an address that never answers only costs attemptDelay. The first connection wins and the attempts still running
+// are cancelled. Throws the last attempt's error when all of them fail. Cancelling the caller cancels every attempt.
+asio::awaitable<asio::ip::tcp::socket> happy_eyeballs_connect(
+    std::vector<asio::ip::tcp::endpoint> endpoints,
+    std::chrono::steady_clock::duration attemptDelay = std::chrono::milliseconds{ 250 }
+);
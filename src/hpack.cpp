@@ -0,0 +1,457 @@
+#include "hpack.hpp"
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace
+{
+
+// RFC 7541 Appendix A
+const std::array<HeaderField, 61> STATIC_TABLE{ {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+} };
+
+struct HuffmanCode
+{
+    uint32_t m_code;
+    uint8_t m_bits;
+};
+
+// RFC 7541 Appendix B, by symbol. 256 is EOS
+constexpr std::array<HuffmanCode, 257> HUFFMAN_CODES{ {
+    { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 }, { 0xfffffe4, 28 }, { 0xfffffe5, 28 },
+    { 0xfffffe6, 28 }, { 0xfffffe7, 28 }, { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+    { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 }, { 0xfffffed, 28 }, { 0xfffffee, 28 },
+    { 0xfffffef, 28 }, { 0xffffff0, 28 }, { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+    { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 }, { 0xffffff8, 28 }, { 0xffffff9, 28 },
+    { 0xffffffa, 28 }, { 0xffffffb, 28 }, { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+    { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 }, { 0x3fa, 10 }, { 0x3fb, 10 },
+    { 0xf9, 8 }, { 0x7fb, 11 }, { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+    { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 }, { 0x1a, 6 }, { 0x1b, 6 },
+    { 0x1c, 6 }, { 0x1d, 6 }, { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+    { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 }, { 0x1ffa, 13 }, { 0x21, 6 },
+    { 0x5d, 7 }, { 0x5e, 7 }, { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+    { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 }, { 0x67, 7 }, { 0x68, 7 },
+    { 0x69, 7 }, { 0x6a, 7 }, { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+    { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 }, { 0xfc, 8 }, { 0x73, 7 },
+    { 0xfd, 8 }, { 0x1ffb, 13 }, { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+    { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 }, { 0x24, 6 }, { 0x5, 5 },
+    { 0x25, 6 }, { 0x26, 6 }, { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+    { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 }, { 0x2b, 6 }, { 0x76, 7 },
+    { 0x2c, 6 }, { 0x8, 5 }, { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+    { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 }, { 0x7fc, 11 }, { 0x3ffd, 14 },
+    { 0x1ffd, 13 }, { 0xffffffc, 28 }, { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+    { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 }, { 0x3fffd6, 22 }, { 0x7fffda, 23 },
+    { 0x7fffdb, 23 }, { 0x7fffdc, 23 }, { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+    { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 }, { 0xffffee, 24 }, { 0x7fffe1, 23 },
+    { 0x7fffe2, 23 }, { 0x7fffe3, 23 }, { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+    { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 }, { 0x3fffda, 22 }, { 0x1fffdd, 21 },
+    { 0xfffe9, 20 }, { 0x3fffdb, 22 }, { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+    { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 }, { 0x1fffdf, 21 }, { 0x3fffdf, 22 },
+    { 0x7fffeb, 23 }, { 0x7fffec, 23 }, { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+    { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 }, { 0xfffea, 20 }, { 0x3fffe2, 22 },
+    { 0x3fffe3, 22 }, { 0x3fffe4, 22 }, { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+    { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 }, { 0x3fffe7, 22 }, { 0x7ffff2, 23 },
+    { 0x3fffe8, 22 }, { 0x1ffffec, 25 }, { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+    { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 }, { 0x7fff2, 19 }, { 0x1fffe3, 21 },
+    { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 }, { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+    { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 }, { 0xffffffd, 28 }, { 0x7ffffe3, 27 },
+    { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 }, { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+    { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 }, { 0x3fffea, 22 }, { 0x3fffeb, 22 },
+    { 0x1ffffee, 25 }, { 0x1ffffef, 25 }, { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+    { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 }, { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 },
+    { 0x7ffffe9, 27 }, { 0x7ffffea, 27 }, { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+    { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 }, { 0x3fffffff, 30 },
+} };
+
+constexpr size_t MAX_CODE_BITS{ 30 };
+
+// every table entry costs its strings plus this (RFC 7541 4.1)
+constexpr size_t ENTRY_OVERHEAD{ 32 };
+
+// The code is canonical: the codes of one length are consecutive and ordered like their symbols. So a code of length
+// n is symbol m_symbols[m_offset[n] + code - m_first[n]] if it's one of the m_count[n] codes from m_first[n]
+struct HuffmanDecodeTable
+{
+    std::array<uint32_t, MAX_CODE_BITS + 1> m_first{};
+    std::array<uint32_t, MAX_CODE_BITS + 1> m_count{};
+    std::array<uint32_t, MAX_CODE_BITS + 1> m_offset{};
+    std::array<uint16_t, HUFFMAN_CODES.size()> m_symbols{};
+
+    HuffmanDecodeTable()
+    {
+        for (uint16_t sym{ 0 }; sym < HUFFMAN_CODES.size(); sym++)
+        {
+            m_symbols[sym] = sym;
+        }
+        std::ranges::sort(
+            m_symbols,
+            [](uint16_t lhs, uint16_t rhs)
+            {
+                return std::pair{ HUFFMAN_CODES[lhs].m_bits, HUFFMAN_CODES[lhs].m_code } <
+                       std::pair{ HUFFMAN_CODES[rhs].m_bits, HUFFMAN_CODES[rhs].m_code };
+            }
+        );
+
+        for (uint32_t idx{ 0 }; idx < m_symbols.size(); idx++)
+        {
+            const auto& code{ HUFFMAN_CODES[m_symbols[idx]] };
+            if (m_count[code.m_bits] == 0)
+            {
+                m_first[code.m_bits] = code.m_code;
+                m_offset[code.m_bits] = idx;
+            }
+            m_count[code.m_bits]++;
+        }
+    }
+};
+
+const HuffmanDecodeTable& huffman_decode_table()
+{
+    static const HuffmanDecodeTable table{};
+    return table;
+}
+
+// An integer with an n bit prefix (RFC 7541 5.1) starting at in[pos]. Advances pos past it
+bool decode_int(std::span<const uint8_t> in, size_t& pos, uint8_t prefixBits, uint64_t& value)
+{
+    if (pos >= in.size())
+    {
+        return false;
+    }
+
+    const uint8_t mask{ static_cast<uint8_t>((1u << prefixBits) - 1) };
+    value = in[pos++] & mask;
+    if (value < mask)
+    {
+        return true;
+    }
+
+    for (unsigned shift{ 0 }; pos < in.size() and shift <= 56; shift += 7)
+    {
+        const uint8_t byte{ in[pos++] };
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// A string literal (RFC 7541 5.2) starting at in[pos]. Advances pos past it
+bool decode_string(std::span<const uint8_t> in, size_t& pos, std::string& out)
+{
+    if (pos >= in.size())
+    {
+        return false;
+    }
+
+    const bool huffman{ (in[pos] & 0x80) != 0 };
+    uint64_t len{ 0 };
+    if (not decode_int(in, pos, 7, len) or len > in.size() - pos)
+    {
+        return false;
+    }
+
+    const auto raw{ in.subspan(pos, len) };
+    pos += len;
+    out.clear();
+    if (huffman)
+    {
+        return huffman_decode(raw, out);
+    }
+
+    out.assign(raw.begin(), raw.end());
+    return true;
+}
+
+void encode_int(uint64_t value, uint8_t prefixBits, uint8_t flags, std::string& out)
+{
+    const uint8_t mask{ static_cast<uint8_t>((1u << prefixBits) - 1) };
+    if (value < mask)
+    {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(flags | mask));
+    value -= mask;
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void encode_string(std::string_view str, std::string& out)
+{
+    encode_int(str.size(), 7, 0x00, out);
+    out.append(str);
+}
+
+} // namespace
+
+HpackDecoder::HpackDecoder(size_t maxTableSize, size_t maxListSize) :
+    m_maxTableSize{ maxTableSize },
+    m_maxListSize{ maxListSize },
+    m_tableLimit{ maxTableSize }
+{
+}
+
+bool HpackDecoder::Decode(std::span<const uint8_t> block, std::vector<HeaderField>& out)
+{
+    size_t listSize{ 0 };
+    bool sawField{ false };
+    size_t pos{ 0 };
+    while (pos < block.size())
+    {
+        const uint8_t first{ block[pos] };
+        uint64_t idx{ 0 };
+
+        // indexed field
+        if (first & 0x80)
+        {
+            if (not decode_int(block, pos, 7, idx))
+            {
+                return false;
+            }
+
+            const auto* field{ Field(idx) };
+            if (not field)
+            {
+                return false;
+            }
+            out.push_back(*field);
+        }
+        // dynamic table size update, only allowed ahead of the first field
+        else if ((first & 0xe0) == 0x20)
+        {
+            uint64_t size{ 0 };
+            if (sawField or not decode_int(block, pos, 5, size) or size > m_maxTableSize)
+            {
+                return false;
+            }
+            m_tableLimit = size;
+            Evict(m_tableLimit);
+            continue;
+        }
+        // literal field. with incremental indexing, without indexing or never indexed
+        else
+        {
+            const bool indexed{ (first & 0xc0) == 0x40 };
+            if (not decode_int(block, pos, indexed ? 6 : 4, idx))
+            {
+                return false;
+            }
+
+            HeaderField field{};
+            if (idx == 0)
+            {
+                if (not decode_string(block, pos, field.m_name))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                const auto* named{ Field(idx) };
+                if (not named)
+                {
+                    return false;
+                }
+                field.m_name = named->m_name;
+            }
+
+            if (not decode_string(block, pos, field.m_value))
+            {
+                return false;
+            }
+
+            if (indexed)
+            {
+                Insert(field);
+            }
+            out.push_back(std::move(field));
+        }
+
+        sawField = true;
+        listSize += out.back().m_name.size() + out.back().m_value.size() + ENTRY_OVERHEAD;
+        if (listSize > m_maxListSize)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const HeaderField* HpackDecoder::Field(uint64_t idx) const noexcept
+{
+    if (idx == 0)
+    {
+        return nullptr;
+    }
+    if (idx <= STATIC_TABLE.size())
+    {
+        return &STATIC_TABLE[idx - 1];
+    }
+
+    idx -= STATIC_TABLE.size() + 1;
+    return idx < m_table.size() ? &m_table[idx] : nullptr;
+}
+
+void HpackDecoder::Insert(HeaderField field)
+{
+    const size_t size{ field.m_name.size() + field.m_value.size() + ENTRY_OVERHEAD };
+    // an entry larger than the table empties it and isn't added (RFC 7541 4.4)
+    if (size > m_tableLimit)
+    {
+        Evict(0);
+        return;
+    }
+
+    Evict(m_tableLimit - size);
+    m_table.push_front(std::move(field));
+    m_tableSize += size;
+}
+
+void HpackDecoder::Evict(size_t maxSize)
+{
+    while (m_tableSize > maxSize)
+    {
+        const auto& oldest{ m_table.back() };
+        m_tableSize -= oldest.m_name.size() + oldest.m_value.size() + ENTRY_OVERHEAD;
+        m_table.pop_back();
+    }
+}
+
+void hpack_encode(std::string_view name, std::string_view value, std::string& out)
+{
+    size_t nameIdx{ 0 };
+    for (size_t idx{ 0 }; idx < STATIC_TABLE.size(); idx++)
+    {
+        if (STATIC_TABLE[idx].m_name != name)
+        {
+            continue;
+        }
+        if (STATIC_TABLE[idx].m_value == value)
+        {
+            encode_int(idx + 1, 7, 0x80, out);
+            return;
+        }
+        if (nameIdx == 0)
+        {
+            nameIdx = idx + 1;
+        }
+    }
+
+    // credentials are marked never indexed, so intermediaries don't compress them either
+    const bool sensitive{ name == "authorization" or name == "proxy-authorization" or name == "cookie" };
+    encode_int(nameIdx, 4, sensitive ? 0x10 : 0x00, out);
+    if (nameIdx == 0)
+    {
+        encode_string(name, out);
+    }
+    encode_string(value, out);
+}
+
+bool huffman_decode(std::span<const uint8_t> in, std::string& out)
+{
+    const auto& table{ huffman_decode_table() };
+
+    uint32_t code{ 0 };
+    size_t nBits{ 0 };
+    for (const uint8_t byte : in)
+    {
+        for (int bit{ 7 }; bit >= 0; bit--)
+        {
+            code = (code << 1) | ((byte >> bit) & 1);
+            nBits++;
+            if (nBits > MAX_CODE_BITS)
+            {
+                return false;
+            }
+
+            if (table.m_count[nBits] == 0 or code < table.m_first[nBits] or
+                code - table.m_first[nBits] >= table.m_count[nBits])
+            {
+                continue;
+            }
+
+            const auto sym{ table.m_symbols[table.m_offset[nBits] + code - table.m_first[nBits]] };
+            if (sym == 256)
+            {
+                return false;
+            }
+            out.push_back(static_cast<char>(sym));
+            code = 0;
+            nBits = 0;
+        }
+    }
+
+    // what's left has to be padding: fewer than 8 bits, all ones (a prefix of EOS)
+    return nBits < 8 and code == (1u << nBits) - 1;
+}
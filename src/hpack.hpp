@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HPACK (RFC 7541), the header compression of HTTP/2
+
+struct HeaderField
+{
+    std::string m_name;
+    std::string m_value;
+};
+
+// Decodes the header blocks one peer sends on one connection, in the order they arrive.
+// A block that fails to decode leaves the table out of sync with the peer, which ends the connection
+class HpackDecoder
+{
+public:
+    // maxTableSize is our SETTINGS_HEADER_TABLE_SIZE, maxListSize our SETTINGS_MAX_HEADER_LIST_SIZE
+    explicit HpackDecoder(size_t maxTableSize = 4096, size_t maxListSize = 64 * 1024);
+
+    // Appends the fields of one complete header block to out. false if it's malformed or too large
+    bool Decode(std::span<const uint8_t> block, std::vector<HeaderField>& out);
+
+private:
+    // by HPACK index, 1 based across the static and the dynamic table
+    const HeaderField* Field(uint64_t idx) const noexcept;
+
+    void Insert(HeaderField field);
+
+    void Evict(size_t maxSize);
+
+    const size_t m_maxTableSize;
+    const size_t m_maxListSize;
+    // newest first
+    std::deque<HeaderField> m_table{};
+    size_t m_tableSize{ 0 };
+    // lowered by the peer with size updates, never above m_maxTableSize
+    size_t m_tableLimit;
+};
+
+// Appends one field to a header block. Never adds to the peer's dynamic table, so the encoder keeps no state and
+// needs nothing from the peer's settings. Names must be lower case
+void hpack_encode(std::string_view name, std::string_view value, std::string& out);
+
+// Decodes a Huffman coded string (RFC 7541 Appendix B). false on invalid codes or padding
+bool huffman_decode(std::span<const uint8_t> in, std::string& out);
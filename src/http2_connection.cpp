@@ -0,0 +1,813 @@
+#include "http2_connection.hpp"
+#include "buffer_pool.hpp"
+#include "deadline.hpp"
+#include "log/logger.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+constexpr std::string_view PREFACE{ "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" };
+constexpr size_t FRAME_HEADER_BYTES{ 9 };
+// the protocol default for SETTINGS_MAX_FRAME_SIZE, which is never raised here
+constexpr size_t MAX_RECV_FRAME_BYTES{ 16'384 };
+constexpr uint32_t MAX_STREAM_ID{ 0x7fff'ffff };
+constexpr int64_t MAX_WINDOW{ 0x7fff'ffff };
+constexpr size_t DEFAULT_WINDOW{ 65'535 };
+// the connection's receive window, raised from the default right after the preface. what a stream can hold is
+// bounded by its own window
+constexpr size_t CONNECTION_WINDOW{ 16 * 1024 * 1024 };
+constexpr size_t MAX_HEADER_LIST_BYTES{ 64 * 1024 };
+
+constexpr uint8_t FLAG_END_STREAM{ 0x1 };
+constexpr uint8_t FLAG_ACK{ 0x1 };
+constexpr uint8_t FLAG_END_HEADERS{ 0x4 };
+constexpr uint8_t FLAG_PADDED{ 0x8 };
+constexpr uint8_t FLAG_PRIORITY{ 0x20 };
+
+constexpr uint16_t SETTINGS_ENABLE_PUSH{ 0x2 };
+constexpr uint16_t SETTINGS_MAX_CONCURRENT_STREAMS{ 0x3 };
+constexpr uint16_t SETTINGS_INITIAL_WINDOW_SIZE{ 0x4 };
+constexpr uint16_t SETTINGS_MAX_FRAME_SIZE{ 0x5 };
+constexpr uint16_t SETTINGS_MAX_HEADER_LIST_SIZE{ 0x6 };
+
+constexpr uint32_t ERROR_FLOW_CONTROL{ 0x3 };
+constexpr uint32_t ERROR_CANCEL{ 0x8 };
+
+// meaningless or forbidden in HTTP/2 (RFC 9113 8.2.2). host becomes :authority
+constexpr std::array<std::string_view, 6> CONNECTION_FIELDS{
+    "connection", "host", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade",
+};
+
+[[noreturn]] void protocol_error(std::string_view what)
+{
+    throw std::runtime_error{ std::format("http2 protocol error: {}", what) };
+}
+
+uint32_t read_u32(std::span<const uint8_t> in)
+{
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+           (static_cast<uint32_t>(in[2]) << 8) | in[3];
+}
+
+void append_u32(std::string& out, uint32_t value)
+{
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void append_setting(std::string& out, uint16_t setting, uint32_t value)
+{
+    out.push_back(static_cast<char>(setting >> 8));
+    out.push_back(static_cast<char>(setting));
+    append_u32(out, value);
+}
+
+std::string_view as_chars(std::span<const uint8_t> bytes)
+{
+    return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+}
+
+std::span<const uint8_t> as_octets(std::string_view chars)
+{
+    return { reinterpret_cast<const uint8_t*>(chars.data()), chars.size() };
+}
+
+// the payload of a frame without its padding
+std::span<const uint8_t> strip_padding(uint8_t flags, std::span<const uint8_t> payload)
+{
+    if ((flags & FLAG_PADDED) == 0)
+    {
+        return payload;
+    }
+    if (payload.empty() or payload[0] >= payload.size())
+    {
+        protocol_error("padding longer than the frame");
+    }
+    return payload.subspan(1, payload.size() - 1 - payload[0]);
+}
+
+// Waits until timer is cancelled. Throws if the waiting coroutine was cancelled instead
+asio::awaitable<void> wait_for_wake(asio::steady_timer& timer)
+{
+    boost::system::error_code ec;
+    co_await timer.async_wait(asio::redirect_error(ec));
+
+    auto cs{ co_await asio::this_coro::cancellation_state };
+    if (cs.cancelled() != asio::cancellation_type::none)
+    {
+        throw boost::system::system_error{ asio::error::operation_aborted };
+    }
+}
+
+// wait_for_wake(), failing with timed_out after limit
+asio::awaitable<void> wait_for_wake(asio::steady_timer& timer, Deadline& deadline, Deadline::Clock::duration limit)
+{
+    boost::system::error_code ec;
+    co_await deadline.Within(limit, timer.async_wait(asio::deferred), asio::redirect_error(asio::deferred, ec));
+    if (ec == asio::error::timed_out)
+    {
+        throw boost::system::system_error{ ec };
+    }
+
+    auto cs{ co_await asio::this_coro::cancellation_state };
+    if (cs.cancelled() != asio::cancellation_type::none)
+    {
+        throw boost::system::system_error{ asio::error::operation_aborted };
+    }
+}
+
+} // namespace
+
+Http2Connection::Http2Connection(
+    std::unique_ptr<Stream> stream,
+    size_t windowBytes,
+    std::chrono::steady_clock::duration timeout
+) :
+    m_stream{ std::move(stream) },
+    m_strand{ asio::make_strand(m_stream->get_executor()) },
+    m_windowBytes{ std::clamp<size_t>(windowBytes, 1, MAX_WINDOW) },
+    m_timeout{ timeout },
+    m_writerWake{ m_strand, asio::steady_timer::time_point::max() },
+    m_connectionWake{ m_strand, asio::steady_timer::time_point::max() }
+{
+}
+
+void Http2Connection::Start()
+{
+    std::string settings{};
+    append_setting(settings, SETTINGS_ENABLE_PUSH, 0);
+    append_setting(settings, SETTINGS_INITIAL_WINDOW_SIZE, static_cast<uint32_t>(m_windowBytes));
+    append_setting(settings, SETTINGS_MAX_HEADER_LIST_SIZE, MAX_HEADER_LIST_BYTES);
+
+    // nothing runs on the strand yet, so this doesn't race the writer
+    m_outbox.emplace_back(PREFACE);
+    Queue(FrameType::Settings, 0, 0, settings);
+    QueueWindowUpdate(0, CONNECTION_WINDOW - DEFAULT_WINDOW);
+
+    asio::co_spawn(
+        m_strand,
+        [self{ shared_from_this() }] -> asio::awaitable<void> { co_await self->RunReader(); },
+        detached_log_exception{ Sage::Logger::Level::Debug }
+    );
+    asio::co_spawn(
+        m_strand,
+        [self{ shared_from_this() }] -> asio::awaitable<void> { co_await self->RunWriter(); },
+        detached_log_exception{ Sage::Logger::Level::Debug }
+    );
+}
+
+asio::awaitable<Http2Connection::ResponseHeader> Http2Connection::Send(
+    std::string authority,
+    const Request& req,
+    BodyConsumer consume
+)
+{
+    co_return co_await asio::co_spawn(
+        m_strand, RunRequest(std::move(authority), req, std::move(consume)), asio::use_awaitable
+    );
+}
+
+asio::awaitable<Http2Connection::ResponseHeader> Http2Connection::RunRequest(
+    std::string authority,
+    const Request& req,
+    BodyConsumer consume
+)
+{
+    // a server that never frees a stream slot or opens its window again fails the request like one gone quiet.
+    // the wake is shared with every other request, so the limit is on the whole wait, not each turn of it
+    const auto giveUp{ Deadline::Clock::now() + m_timeout };
+    // one timer for every wait of the request
+    Deadline deadline{ m_strand };
+    while (Usable() and m_streams.size() >= m_maxConcurrentStreams)
+    {
+        co_await wait_for_wake(m_connectionWake, deadline, giveUp - Deadline::Clock::now());
+    }
+
+    if (m_nextStreamId > MAX_STREAM_ID)
+    {
+        // out of stream ids. the pool opens a new connection for the next request
+        m_usable.store(false, std::memory_order::relaxed);
+    }
+    if (m_error)
+    {
+        std::rethrow_exception(m_error);
+    }
+    if (not Usable())
+    {
+        throw boost::system::system_error{ asio::error::connection_aborted };
+    }
+
+    auto stream{ std::make_shared<PendingStream>(m_strand) };
+    stream->m_id = m_nextStreamId;
+    stream->m_sendWindow = m_initialSendWindow;
+    stream->m_recvWindow = static_cast<int64_t>(m_windowBytes);
+    m_nextStreamId += 2;
+    m_streams.emplace(stream->m_id, stream);
+
+    AtScopeExit forget{ [this, stream]
+                        {
+                            // abandoned halfway, e.g. the consumer threw. the server can stop sending
+                            if (not stream->m_ended and not stream->m_error and not m_error)
+                            {
+                                std::string code{};
+                                append_u32(code, ERROR_CANCEL);
+                                Queue(FrameType::RstStream, 0, stream->m_id, code);
+                            }
+                            m_streams.erase(stream->m_id);
+                            m_connectionWake.cancel();
+                            CloseIfDrained();
+                        } };
+
+    std::string_view path{ req.target() };
+    if (path.empty())
+    {
+        path = "/";
+    }
+
+    std::string block{};
+    hpack_encode(":method", std::string_view{ req.method_string() }, block);
+    hpack_encode(":scheme", "https", block);
+    hpack_encode(":authority", authority, block);
+    hpack_encode(":path", path, block);
+    std::string name{};
+    for (const auto& field : req)
+    {
+        const std::string_view fieldName{ field.name_string() };
+        const std::string_view value{ field.value() };
+        name.resize(fieldName.size());
+        std::ranges::transform(
+            fieldName, name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+        );
+        if (std::ranges::contains(CONNECTION_FIELDS, name) or (name == "te" and value != "trailers"))
+        {
+            continue;
+        }
+        hpack_encode(name, value, block);
+    }
+
+    const std::string_view body{ req.body() };
+    QueueHeaders(stream->m_id, block, body.empty());
+    for (size_t sent{ 0 }; sent < body.size();)
+    {
+        if (stream->m_error)
+        {
+            std::rethrow_exception(stream->m_error);
+        }
+
+        const int64_t window{ std::min(m_connectionSendWindow, stream->m_sendWindow) };
+        if (window <= 0)
+        {
+            co_await wait_for_wake(m_connectionWake, deadline, giveUp - Deadline::Clock::now());
+            continue;
+        }
+
+        const size_t nBytes{ std::min({ static_cast<size_t>(window), m_maxFrameSize, body.size() - sent }) };
+        const bool last{ sent + nBytes == body.size() };
+        Queue(FrameType::Data, last ? FLAG_END_STREAM : 0, stream->m_id, body.substr(sent, nBytes));
+        m_connectionSendWindow -= static_cast<int64_t>(nBytes);
+        stream->m_sendWindow -= static_cast<int64_t>(nBytes);
+        sent += nBytes;
+    }
+
+    // swapped with the stream's buffer, so the two allocations take turns instead of one per chunk
+    std::string chunk{};
+    while (true)
+    {
+        if (stream->m_error)
+        {
+            std::rethrow_exception(stream->m_error);
+        }
+
+        if (stream->m_headerDone and not stream->m_body.empty())
+        {
+            chunk.clear();
+            std::swap(chunk, stream->m_body);
+            co_await consume(stream->m_header, chunk);
+
+            // only now may the server send more
+            stream->m_recvWindow += static_cast<int64_t>(chunk.size());
+            if (not stream->m_ended)
+            {
+                QueueWindowUpdate(stream->m_id, chunk.size());
+            }
+            continue;
+        }
+
+        if (stream->m_headerDone and stream->m_ended)
+        {
+            break;
+        }
+
+        co_await wait_for_wake(stream->m_wake, deadline, m_timeout);
+    }
+
+    co_return std::move(stream->m_header);
+}
+
+asio::awaitable<void> Http2Connection::RunReader()
+{
+    try
+    {
+        while (true)
+        {
+            co_await Fill(FRAME_HEADER_BYTES);
+            const std::span<const uint8_t> header{
+                static_cast<const uint8_t*>(m_in.data().data()), FRAME_HEADER_BYTES
+            };
+            const size_t length{ (static_cast<size_t>(header[0]) << 16) | (static_cast<size_t>(header[1]) << 8) |
+                                 header[2] };
+            const auto type{ static_cast<FrameType>(header[3]) };
+            const uint8_t flags{ header[4] };
+            const uint32_t streamId{ read_u32(header.subspan(5)) & MAX_STREAM_ID };
+            if (length > MAX_RECV_FRAME_BYTES)
+            {
+                protocol_error("frame larger than SETTINGS_MAX_FRAME_SIZE");
+            }
+
+            co_await Fill(FRAME_HEADER_BYTES + length);
+            const std::span<const uint8_t> payload{
+                static_cast<const uint8_t*>(m_in.data().data()) + FRAME_HEADER_BYTES, length
+            };
+            OnFrame(type, flags, streamId, payload);
+            m_in.consume(FRAME_HEADER_BYTES + length);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        LOG_DEBUG("http2 connection closed. {}", e.what());
+        Fail(std::current_exception());
+    }
+}
+
+asio::awaitable<void> Http2Connection::RunWriter()
+{
+    try
+    {
+        while (not m_error)
+        {
+            if (m_outbox.empty())
+            {
+                // Queue() cancels the wait
+                m_writerParked = true;
+                co_await wait_for_wake(m_writerWake);
+                continue;
+            }
+
+            // ssl::stream encrypts one buffer per write_some, so queued frames handed over as a gather list would
+            // each cost a record and a send. copied into one they go out in as few records as OpenSSL allows
+            size_t nBytes{ 0 };
+            for (const auto& frame : m_outbox)
+            {
+                nBytes += frame.size();
+            }
+            PooledBuffer batch{ nBytes };
+            char* out{ batch.Data() };
+            while (not m_outbox.empty())
+            {
+                out = std::ranges::copy(m_outbox.front(), out).out;
+                m_outbox.pop_front();
+            }
+            co_await asio::async_write(*m_stream, asio::buffer(batch.Data(), nBytes));
+        }
+    }
+    catch (const std::exception& e)
+    {
+        LOG_DEBUG("http2 connection closed. {}", e.what());
+        Fail(std::current_exception());
+    }
+}
+
+asio::awaitable<void> Http2Connection::Fill(size_t nBytes)
+{
+    while (m_in.size() < nBytes)
+    {
+        const size_t nWanted{ std::max(nBytes - m_in.size(), MAX_RECV_FRAME_BYTES) };
+        const auto nRead{ co_await m_stream->async_read_some(m_in.prepare(nWanted)) };
+        m_in.commit(nRead);
+    }
+}
+
+void Http2Connection::OnFrame(FrameType type, uint8_t flags, uint32_t streamId, std::span<const uint8_t> payload)
+{
+    if (m_headerBlockStream != 0 and (type != FrameType::Continuation or streamId != m_headerBlockStream))
+    {
+        protocol_error("header block interrupted");
+    }
+
+    switch (type)
+    {
+        case FrameType::Data:
+            OnData(flags, streamId, payload);
+            break;
+
+        case FrameType::Headers:
+        {
+            if (streamId == 0)
+            {
+                protocol_error("HEADERS on stream 0");
+            }
+
+            auto fragment{ strip_padding(flags, payload) };
+            if (flags & FLAG_PRIORITY)
+            {
+                if (fragment.size() < 5)
+                {
+                    protocol_error("HEADERS too short for its priority");
+                }
+                fragment = fragment.subspan(5);
+            }
+
+            m_headerBlock.assign(as_chars(fragment));
+            m_headerBlockStream = streamId;
+            m_headerBlockEndsStream = (flags & FLAG_END_STREAM) != 0;
+            if (flags & FLAG_END_HEADERS)
+            {
+                OnHeaderBlock();
+            }
+            break;
+        }
+
+        case FrameType::Continuation:
+            if (m_headerBlockStream == 0)
+            {
+                protocol_error("CONTINUATION without HEADERS");
+            }
+
+            m_headerBlock.append(as_chars(payload));
+            if (m_headerBlock.size() > MAX_HEADER_LIST_BYTES)
+            {
+                protocol_error("header block too large");
+            }
+            if (flags & FLAG_END_HEADERS)
+            {
+                OnHeaderBlock();
+            }
+            break;
+
+        case FrameType::RstStream:
+            if (streamId == 0 or payload.size() != 4)
+            {
+                protocol_error("malformed RST_STREAM");
+            }
+
+            if (auto stream{ FindStream(streamId) })
+            {
+                stream->m_error = std::make_exception_ptr(std::runtime_error{
+                    std::format("stream {} reset by the server. error code: {}", streamId, read_u32(payload)) });
+                stream->m_wake.cancel();
+            }
+            break;
+
+        case FrameType::Settings:
+            OnSettings(flags, payload);
+            break;
+
+        case FrameType::PushPromise:
+            protocol_error("PUSH_PROMISE while push is disabled");
+
+        case FrameType::Ping:
+            if (payload.size() != 8)
+            {
+                protocol_error("malformed PING");
+            }
+
+            if ((flags & FLAG_ACK) == 0)
+            {
+                Queue(FrameType::Ping, FLAG_ACK, 0, as_chars(payload));
+            }
+            break;
+
+        case FrameType::GoAway:
+            OnGoAway(payload);
+            break;
+
+        case FrameType::WindowUpdate:
+        {
+            if (payload.size() != 4)
+            {
+                protocol_error("malformed WINDOW_UPDATE");
+            }
+
+            const uint32_t increment{ read_u32(payload) & MAX_STREAM_ID };
+            if (increment == 0)
+            {
+                protocol_error("WINDOW_UPDATE of 0");
+            }
+
+            if (streamId == 0)
+            {
+                m_connectionSendWindow += increment;
+                if (m_connectionSendWindow > MAX_WINDOW)
+                {
+                    protocol_error("connection window overflow");
+                }
+            }
+            else if (auto stream{ FindStream(streamId) })
+            {
+                stream->m_sendWindow += increment;
+                // a stream error (RFC 9113 6.9.1), only this request fails
+                if (stream->m_sendWindow > MAX_WINDOW and not stream->m_error)
+                {
+                    std::string code{};
+                    append_u32(code, ERROR_FLOW_CONTROL);
+                    Queue(FrameType::RstStream, 0, streamId, code);
+                    stream->m_error = std::make_exception_ptr(
+                        std::runtime_error{ std::format("http2 stream {} send window overflow", streamId) }
+                    );
+                    stream->m_wake.cancel();
+                }
+            }
+            m_connectionWake.cancel();
+            break;
+        }
+
+        case FrameType::Priority:
+            break;
+
+        default:
+            // unknown frame types are ignored (RFC 9113 4.1)
+            break;
+    }
+}
+
+void Http2Connection::OnData(uint8_t flags, uint32_t streamId, std::span<const uint8_t> payload)
+{
+    if (streamId == 0)
+    {
+        protocol_error("DATA on stream 0");
+    }
+
+    // the whole frame counts against the windows, padding included
+    m_connectionUnacked += payload.size();
+    if (m_connectionUnacked >= CONNECTION_WINDOW / 2)
+    {
+        QueueWindowUpdate(0, std::exchange(m_connectionUnacked, 0));
+    }
+
+    auto stream{ FindStream(streamId) };
+    if (not stream)
+    {
+        // abandoned or reset, whatever is still in flight is dropped
+        return;
+    }
+    if (not stream->m_headerDone)
+    {
+        protocol_error("DATA ahead of the response header");
+    }
+
+    const auto data{ strip_padding(flags, payload) };
+    stream->m_recvWindow -= static_cast<int64_t>(payload.size());
+    // until the server has our settings it may still go by the default window
+    if (m_settingsAcked and stream->m_recvWindow < 0)
+    {
+        protocol_error("DATA beyond the stream's window");
+    }
+
+    stream->m_body.append(as_chars(data));
+    if (flags & FLAG_END_STREAM)
+    {
+        stream->m_ended = true;
+    }
+    // padding never reaches the consumer, so its share of the window goes back right away
+    else if (const size_t padding{ payload.size() - data.size() }; padding > 0)
+    {
+        stream->m_recvWindow += static_cast<int64_t>(padding);
+        QueueWindowUpdate(streamId, padding);
+    }
+    stream->m_wake.cancel();
+}
+
+void Http2Connection::OnHeaderBlock()
+{
+    const uint32_t streamId{ std::exchange(m_headerBlockStream, 0) };
+
+    // decoded even when the stream is gone, the table has to see every block
+    std::vector<HeaderField> fields{};
+    if (not m_decoder.Decode(as_octets(m_headerBlock), fields))
+    {
+        protocol_error("malformed header block");
+    }
+
+    auto stream{ FindStream(streamId) };
+    if (not stream)
+    {
+        return;
+    }
+
+    // a second block is the trailers, which nothing here needs
+    if (not stream->m_headerDone)
+    {
+        ResponseHeader header{};
+        unsigned status{ 0 };
+        for (const auto& field : fields)
+        {
+            if (field.m_name == ":status")
+            {
+                std::from_chars(field.m_value.data(), field.m_value.data() + field.m_value.size(), status);
+            }
+            else if (not field.m_name.starts_with(':'))
+            {
+                header.insert(field.m_name, field.m_value);
+            }
+        }
+
+        if (status < 100 or status > 999)
+        {
+            protocol_error("response without a valid :status");
+        }
+        // informational responses come ahead of the final one
+        if (status < 200)
+        {
+            return;
+        }
+
+        header.version(20);
+        header.result(status);
+        stream->m_header = std::move(header);
+        stream->m_headerDone = true;
+    }
+
+    if (m_headerBlockEndsStream)
+    {
+        stream->m_ended = true;
+    }
+    stream->m_wake.cancel();
+}
+
+void Http2Connection::OnSettings(uint8_t flags, std::span<const uint8_t> payload)
+{
+    if (flags & FLAG_ACK)
+    {
+        m_settingsAcked = true;
+        return;
+    }
+
+    if (payload.size() % 6 != 0)
+    {
+        protocol_error("malformed SETTINGS");
+    }
+
+    for (size_t pos{ 0 }; pos < payload.size(); pos += 6)
+    {
+        const auto setting{ static_cast<uint16_t>((payload[pos] << 8) | payload[pos + 1]) };
+        const uint32_t value{ read_u32(payload.subspan(pos + 2)) };
+        switch (setting)
+        {
+            case SETTINGS_MAX_CONCURRENT_STREAMS:
+                m_maxConcurrentStreams = value;
+                break;
+
+            case SETTINGS_INITIAL_WINDOW_SIZE:
+            {
+                if (value > MAX_WINDOW)
+                {
+                    protocol_error("SETTINGS_INITIAL_WINDOW_SIZE too large");
+                }
+
+                // applies to the streams already open as well
+                const int64_t delta{ static_cast<int64_t>(value) - m_initialSendWindow };
+                for (auto& [id, stream] : m_streams)
+                {
+                    stream->m_sendWindow += delta;
+                    // a connection error this time (RFC 9113 6.9.2)
+                    if (stream->m_sendWindow > MAX_WINDOW)
+                    {
+                        protocol_error("SETTINGS_INITIAL_WINDOW_SIZE overflows a stream's window");
+                    }
+                }
+                m_initialSendWindow = value;
+                break;
+            }
+
+            case SETTINGS_MAX_FRAME_SIZE:
+                if (value < 16'384 or value > 16'777'215)
+                {
+                    protocol_error("SETTINGS_MAX_FRAME_SIZE out of range");
+                }
+                m_maxFrameSize = value;
+                break;
+
+            default:
+                // the header table size doesn't matter to an encoder that never indexes
+                break;
+        }
+    }
+
+    Queue(FrameType::Settings, FLAG_ACK, 0, {});
+    m_connectionWake.cancel();
+}
+
+void Http2Connection::OnGoAway(std::span<const uint8_t> payload)
+{
+    if (payload.size() < 8)
+    {
+        protocol_error("malformed GOAWAY");
+    }
+
+    const uint32_t lastStream{ read_u32(payload) & MAX_STREAM_ID };
+    LOG_DEBUG("http2 server going away. last stream: {} error code: {}", lastStream, read_u32(payload.subspan(4)));
+    m_usable.store(false, std::memory_order::relaxed);
+
+    // the server never looked at these
+    for (auto& [id, stream] : m_streams)
+    {
+        if (id > lastStream and not stream->m_error)
+        {
+            stream->m_error = std::make_exception_ptr(boost::system::system_error{ asio::error::connection_aborted });
+            stream->m_wake.cancel();
+        }
+    }
+    m_connectionWake.cancel();
+    CloseIfDrained();
+}
+
+void Http2Connection::Queue(FrameType type, uint8_t flags, uint32_t streamId, std::string_view payload)
+{
+    std::string frame{};
+    frame.reserve(FRAME_HEADER_BYTES + payload.size());
+    frame.push_back(static_cast<char>(payload.size() >> 16));
+    frame.push_back(static_cast<char>(payload.size() >> 8));
+    frame.push_back(static_cast<char>(payload.size()));
+    frame.push_back(static_cast<char>(type));
+    frame.push_back(static_cast<char>(flags));
+    append_u32(frame, streamId);
+    frame.append(payload);
+
+    m_outbox.push_back(std::move(frame));
+    if (std::exchange(m_writerParked, false))
+    {
+        m_writerWake.cancel();
+    }
+}
+
+void Http2Connection::QueueHeaders(uint32_t streamId, std::string_view block, bool endStream)
+{
+    auto type{ FrameType::Headers };
+    uint8_t flags{ endStream ? FLAG_END_STREAM : uint8_t{ 0 } };
+    do
+    {
+        const auto fragment{ block.substr(0, m_maxFrameSize) };
+        block.remove_prefix(fragment.size());
+        Queue(type, flags | (block.empty() ? FLAG_END_HEADERS : 0), streamId, fragment);
+        type = FrameType::Continuation;
+        flags = 0;
+    } while (not block.empty());
+}
+
+void Http2Connection::QueueWindowUpdate(uint32_t streamId, size_t increment)
+{
+    std::string payload{};
+    append_u32(payload, static_cast<uint32_t>(increment));
+    Queue(FrameType::WindowUpdate, 0, streamId, payload);
+}
+
+void Http2Connection::Fail(std::exception_ptr error)
+{
+    if (m_error)
+    {
+        return;
+    }
+
+    m_error = error;
+    m_usable.store(false, std::memory_order::relaxed);
+    for (auto& [id, stream] : m_streams)
+    {
+        // a response that arrived in full can still be consumed
+        if (not stream->m_error and not (stream->m_headerDone and stream->m_ended))
+        {
+            stream->m_error = error;
+        }
+        stream->m_wake.cancel();
+    }
+    m_connectionWake.cancel();
+    m_writerWake.cancel();
+    boost::system::error_code ec;
+    beast::get_lowest_layer(*m_stream).close(ec);
+}
+
+void Http2Connection::CloseIfDrained()
+{
+    // nothing new is started on a connection that went away or ran out of stream ids. without this the socket, the
+    // reader and the writer stay until the server closes
+    if (not Usable() and m_streams.empty() and not m_error)
+    {
+        LOG_DEBUG("http2 connection drained, closing it");
+        Fail(std::make_exception_ptr(boost::system::system_error{ asio::error::connection_aborted }));
+    }
+}
+
+std::shared_ptr<Http2Connection::PendingStream> Http2Connection::FindStream(uint32_t streamId) const
+{
+    auto it{ m_streams.find(streamId) };
+    return it == m_streams.end() ? nullptr : it->second;
+}
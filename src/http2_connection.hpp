@@ -0,0 +1,149 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "hpack.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One client HTTP/2 connection (RFC 9113) carrying any number of concurrent requests, each on its own stream.
+// Everything runs on the connection's strand: a reader dispatching the frames the server sends, a writer sending the
+// frames the requests queue, and the requests themselves. Server push is turned off.
+// Every response body is flow controlled on its own, with a window of windowBytes that's only handed back to the
+// server once the consumer has taken the data. A slow consumer therefore stalls its stream, not the connection.
+class Http2Connection : public std::enable_shared_from_this<Http2Connection>
+{
+public:
+    using Stream = ssl::stream<beast::tcp_stream>;
+    using Request = beast::http::request<beast::http::string_body>;
+    using ResponseHeader = beast::http::response_header<>;
+    // Takes the next piece of a response body. The span is only valid until it returns
+    using BodyConsumer = std::function<asio::awaitable<void>(const ResponseHeader&, std::span<const char>)>;
+
+    // stream has completed a handshake that negotiated h2 through ALPN. A request fails once its response goes quiet
+    // for longer than timeout, or it waited that long for a stream slot or room in the send window
+    Http2Connection(std::unique_ptr<Stream> stream, size_t windowBytes, std::chrono::steady_clock::duration timeout);
+
+    // Sends the connection preface and starts the reader and the writer
+    void Start();
+
+    // false once the connection failed or the server is shutting it down. Requests already underway may still finish,
+    // and the connection closes after the last of them
+    bool Usable() const noexcept { return m_usable.load(std::memory_order::relaxed); }
+
+    // authority is what HTTP/1.1 would send as Host. Returns the header once consume has taken the whole body.
+    // Safe to call from any thread
+    asio::awaitable<ResponseHeader> Send(std::string authority, const Request& req, BodyConsumer consume);
+
+private:
+    enum class FrameType : uint8_t
+    {
+        Data = 0x0,
+        Headers = 0x1,
+        Priority = 0x2,
+        RstStream = 0x3,
+        Settings = 0x4,
+        PushPromise = 0x5,
+        Ping = 0x6,
+        GoAway = 0x7,
+        WindowUpdate = 0x8,
+        Continuation = 0x9,
+    };
+
+    struct PendingStream
+    {
+        explicit PendingStream(const asio::any_io_executor& strand) :
+            m_wake{ strand, asio::steady_timer::time_point::max() }
+        {
+        }
+
+        uint32_t m_id{ 0 };
+        // cancelled whenever the reader has something new for the stream
+        asio::steady_timer m_wake;
+        ResponseHeader m_header{};
+        bool m_headerDone{ false };
+        // received but not consumed yet. at most the window
+        std::string m_body{};
+        bool m_ended{ false };
+        std::exception_ptr m_error{};
+        int64_t m_sendWindow{ 0 };
+        int64_t m_recvWindow{ 0 };
+    };
+
+    asio::awaitable<ResponseHeader> RunRequest(std::string authority, const Request& req, BodyConsumer consume);
+
+    asio::awaitable<void> RunReader();
+
+    asio::awaitable<void> RunWriter();
+
+    // reads until m_in holds at least nBytes
+    asio::awaitable<void> Fill(size_t nBytes);
+
+    void OnFrame(FrameType type, uint8_t flags, uint32_t streamId, std::span<const uint8_t> payload);
+
+    void OnData(uint8_t flags, uint32_t streamId, std::span<const uint8_t> payload);
+
+    void OnHeaderBlock();
+
+    void OnSettings(uint8_t flags, std::span<const uint8_t> payload);
+
+    void OnGoAway(std::span<const uint8_t> payload);
+
+    void Queue(FrameType type, uint8_t flags, uint32_t streamId, std::string_view payload);
+
+    // HEADERS, and CONTINUATION for whatever doesn't fit
+    void QueueHeaders(uint32_t streamId, std::string_view block, bool endStream);
+
+    void QueueWindowUpdate(uint32_t streamId, size_t increment);
+
+    // fails every stream still underway and closes the connection
+    void Fail(std::exception_ptr error);
+
+    // closes a connection that is no longer usable once its last stream is gone
+    void CloseIfDrained();
+
+    std::shared_ptr<PendingStream> FindStream(uint32_t streamId) const;
+
+    std::unique_ptr<Stream> m_stream;
+    asio::strand<asio::any_io_executor> m_strand;
+    const size_t m_windowBytes;
+    const std::chrono::steady_clock::duration m_timeout;
+    std::atomic<bool> m_usable{ true };
+    std::exception_ptr m_error{};
+
+    beast::flat_buffer m_in{};
+    std::deque<std::string> m_outbox{};
+    bool m_writerParked{ false };
+    asio::steady_timer m_writerWake;
+    // cancelled whenever a send window grows, a stream slot frees up or the connection fails
+    asio::steady_timer m_connectionWake;
+
+    HpackDecoder m_decoder{};
+    // a header block continues over CONTINUATION frames and has to be decoded in one piece
+    std::string m_headerBlock{};
+    uint32_t m_headerBlockStream{ 0 };
+    bool m_headerBlockEndsStream{ false };
+
+    std::unordered_map<uint32_t, std::shared_ptr<PendingStream>> m_streams{};
+    uint32_t m_nextStreamId{ 1 };
+
+    // the server's settings
+    uint32_t m_maxConcurrentStreams{ UINT32_MAX };
+    int64_t m_initialSendWindow{ 65'535 };
+    size_t m_maxFrameSize{ 16'384 };
+    bool m_settingsAcked{ false };
+
+    int64_t m_connectionSendWindow{ 65'535 };
+    // received on the connection and not handed back yet
+    size_t m_connectionUnacked{ 0 };
+};
@@ -0,0 +1,145 @@
+#include "http_batch.hpp"
+#include "deadline.hpp"
+#include "log/logger.hpp"
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <utility>
+
+HttpBatch::HttpBatch(
+    std::shared_ptr<HttpsPool> pool,
+    std::shared_ptr<ResponseCache> cache,
+    asio::any_io_executor executor,
+    HttpBatchConfig cfg
+) :
+    m_pool{ std::move(pool) },
+    m_cache{ std::move(cache) },
+    m_executor{ std::move(executor) },
+    m_cfg{ cfg },
+    m_limit{ cfg.m_maxConcurrent }
+{
+}
+
+asio::awaitable<void> HttpBatch::FetchEach(std::vector<FetchRequest> requests, ResultHandler onResult)
+{
+    // room for every result, so a request never waits for a slow onResult
+    using ResultChannel = asio::experimental::concurrent_channel<void(boost::system::error_code, FetchResult)>;
+    auto results{ std::make_shared<ResultChannel>(co_await asio::this_coro::executor, requests.size()) };
+
+    const size_t nRequests{ requests.size() };
+    for (size_t idx{ 0 }; idx < nRequests; idx++)
+    {
+        asio::co_spawn(
+            asio::make_strand(m_executor),
+            [self{ shared_from_this() }, idx, req{ std::move(requests[idx]) }, results] -> asio::awaitable<void>
+            {
+                // Fetch doesn't throw
+                results->try_send(boost::system::error_code{}, co_await self->Fetch(idx, req));
+            },
+            detached_log_exception{ Sage::Logger::Level::Error }
+        );
+    }
+
+    for (size_t idx{ 0 }; idx < nRequests; idx++)
+    {
+        co_await onResult(co_await results->async_receive());
+    }
+}
+
+asio::awaitable<std::vector<FetchResult>> HttpBatch::FetchAll(std::vector<FetchRequest> requests)
+{
+    std::vector<FetchResult> results(requests.size());
+    co_await FetchEach(
+        std::move(requests),
+        [&results](FetchResult result) -> asio::awaitable<void>
+        {
+            const size_t idx{ result.m_index };
+            results[idx] = std::move(result);
+            co_return;
+        }
+    );
+    co_return results;
+}
+
+HttpBatchStats HttpBatch::Stats() const noexcept
+{
+    return HttpBatchStats{
+        .m_fetched = m_fetched.load(std::memory_order::relaxed),
+        .m_failed = m_failed.load(std::memory_order::relaxed),
+        .m_timedOut = m_timedOut.load(std::memory_order::relaxed),
+    };
+}
+
+asio::awaitable<FetchResult> HttpBatch::Fetch(size_t idx, const FetchRequest& req)
+{
+    const auto start{ std::chrono::steady_clock::now() };
+    const auto deadline{ req.m_deadline > req.m_deadline.zero() ? req.m_deadline : m_cfg.m_deadline };
+
+    FetchResult result{ .m_index = idx };
+    // cancels Run wherever it's waiting, the limits included, once the deadline passes
+    const auto exc{ co_await asio::this_coro::executor };
+    Deadline guard{ exc };
+    try
+    {
+        result.m_response =
+            co_await guard.Within(deadline, asio::co_spawn(exc, Run(req, result.m_cached), asio::deferred));
+        m_fetched.fetch_add(1, std::memory_order::relaxed);
+    }
+    catch (const std::exception& e)
+    {
+        result.m_error = std::current_exception();
+        if (guard.Expired())
+        {
+            m_timedOut.fetch_add(1, std::memory_order::relaxed);
+        }
+        else
+        {
+            LOG_DEBUG("fetching {}{} failed. {}", req.m_host, req.m_target, e.what());
+            m_failed.fetch_add(1, std::memory_order::relaxed);
+        }
+    }
+
+    result.m_elapsed = std::chrono::steady_clock::now() - start;
+    co_return result;
+}
+
+asio::awaitable<HttpsPool::Response> HttpBatch::Run(const FetchRequest& req, bool& cached)
+{
+    HttpsPool::Request httpReq{ beast::http::verb::get, req.m_target, 11 };
+    httpReq.set(beast::http::field::host, req.m_host);
+    httpReq.set(beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    if (m_cache)
+    {
+        if (auto fresh{ m_cache->Prepare(req.m_host, httpReq) })
+        {
+            cached = true;
+            co_return std::move(*fresh);
+        }
+    }
+
+    // the host's limit first, so a request stuck behind its host doesn't hold a slot others could use
+    auto hostLimit{ HostLimit(req.m_host) };
+    auto hostPermit{ co_await hostLimit->Acquire() };
+    auto permit{ co_await m_limit.Acquire() };
+
+    auto res{ co_await m_pool->Send(req.m_host, httpReq) };
+    if (not m_cache)
+    {
+        co_return res;
+    }
+
+    const bool notModified{ res.result() == beast::http::status::not_modified };
+    auto answer{ m_cache->Complete(req.m_host, httpReq, std::move(res)) };
+    // unless the entry was evicted meanwhile, which leaves the 304 as it is
+    cached = notModified and answer.result() != beast::http::status::not_modified;
+    co_return answer;
+}
+
+std::shared_ptr<AsyncSemaphore> HttpBatch::HostLimit(const std::string& host)
+{
+    std::lock_guard lk{ m_hostsMutex };
+    auto& limit{ m_hostLimits[host] };
+    if (not limit)
+    {
+        limit = std::make_shared<AsyncSemaphore>(m_cfg.m_maxPerHost);
+    }
+    return limit;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "async_semaphore.hpp"
+#include "https_pool.hpp"
+#include "response_cache.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct HttpBatchConfig
+{
+    // requests underway at once over all hosts
+    size_t m_maxConcurrent{ 256 };
+    // requests underway at once to one host. the ones waiting for a host don't take from m_maxConcurrent
+    size_t m_maxPerHost{ 6 };
+    // for requests that don't set their own
+    std::chrono::steady_clock::duration m_deadline{ std::chrono::seconds{ 30 } };
+};
+
+struct HttpBatchStats
+{
+    size_t m_fetched;
+    size_t m_failed;
+    // missed their deadline, not counted as failed
+    size_t m_timedOut;
+};
+
+struct FetchRequest
+{
+    std::string m_host;
+    std::string m_target;
+    // for everything, including the wait for the limits. zero for HttpBatchConfig::m_deadline
+    std::chrono::steady_clock::duration m_deadline{ 0 };
+};
+
+struct FetchResult
+{
+    // of the request in its batch
+    size_t m_index{ 0 };
+    HttpsPool::Response m_response{};
+    // set instead of a response when the request failed or missed its deadline
+    std::exception_ptr m_error{};
+    // the body came from the cache, fresh or confirmed by a 304
+    bool m_cached{ false };
+    std::chrono::steady_clock::duration m_elapsed{ 0 };
+};
+
+// Runs batches of GET requests through a pool, all at once within a global and a per-host limit.
+// Every request runs on its own strand of the executor, so a batch spreads over the threads running it, and a host
+// that is slow only holds up the requests to itself. Each request fails on its own, with its error in its result,
+// never the batch.
+// With a cache, repeated requests are answered from it while fresh, without waiting for the limits, and otherwise
+// revalidated with the server.
+class HttpBatch : public std::enable_shared_from_this<HttpBatch>
+{
+public:
+    // Takes each result as it completes. They are handed over one at a time on the caller's executor
+    using ResultHandler = std::function<asio::awaitable<void>(FetchResult)>;
+
+    // cache may be nullptr, or shared with other batches
+    HttpBatch(
+        std::shared_ptr<HttpsPool> pool,
+        std::shared_ptr<ResponseCache> cache,
+        asio::any_io_executor executor,
+        HttpBatchConfig cfg = {}
+    );
+
+    // Returns once every result has been handed to onResult, in the order they completed
+    asio::awaitable<void> FetchEach(std::vector<FetchRequest> requests, ResultHandler onResult);
+
+    // The results in the order of requests
+    asio::awaitable<std::vector<FetchResult>> FetchAll(std::vector<FetchRequest> requests);
+
+    HttpBatchStats Stats() const noexcept;
+
+    const HttpsPool& Pool() const noexcept
+    {
+        return *m_pool;
+    }
+
+    // nullptr without one
+    const ResponseCache* Cache() const noexcept
+    {
+        return m_cache.get();
+    }
+
+private:
+    asio::awaitable<FetchResult> Fetch(size_t idx, const FetchRequest& req);
+
+    // waits for the limits and sends req, unless the cache has a fresh answer
+    asio::awaitable<HttpsPool::Response> Run(const FetchRequest& req, bool& cached);
+
+    std::shared_ptr<AsyncSemaphore> HostLimit(const std::string& host);
+
+    const std::shared_ptr<HttpsPool> m_pool;
+    const std::shared_ptr<ResponseCache> m_cache;
+    const asio::any_io_executor m_executor;
+    const HttpBatchConfig m_cfg;
+
+    AsyncSemaphore m_limit;
+    std::mutex m_hostsMutex{};
+    std::unordered_map<std::string, std::shared_ptr<AsyncSemaphore>> m_hostLimits{};
+
+    std::atomic<size_t> m_fetched{ 0 };
+    std::atomic<size_t> m_failed{ 0 };
+    std::atomic<size_t> m_timedOut{ 0 };
+};
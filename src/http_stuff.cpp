@@ -1,100 +1,117 @@
 #include "http_stuff.hpp"
 #include "log/logger.hpp"
-#include "utils.hpp"
-#include <openssl/tls1.h>
+#include <cstdint>
+#include <exception>
+#include <sstream>
+#include <string>
 
-using namespace std::chrono_literals;
-using namespace boost::asio::experimental::awaitable_operators;
-
-asio::awaitable<void> read_http_once(const std::string& host, const std::string& target, ssl::context& sslCtx)
+void log_result(const FetchRequest& req, const FetchResult& result)
 {
-    try
+    const auto elapsedMs{ std::chrono::duration_cast<std::chrono::milliseconds>(result.m_elapsed).count() };
+    if (result.m_error)
     {
-        auto ctx{ co_await asio::this_coro::executor };
-        ssl::stream<beast::tcp_stream> stream{ ctx, sslCtx };
-        asio::ip::tcp::resolver resolver{ ctx };
-
-        // required for SNI verification
-        if (not SSL_set_tlsext_host_name(stream.native_handle(), host.c_str()))
+        try
         {
-            throw beast::system_error(static_cast<asio::error::ssl_errors>(::ERR_get_error()));
+            std::rethrow_exception(result.m_error);
         }
-
-        auto resolved{ co_await resolver.async_resolve(host, "https") };
-        auto ep{ *resolved.begin() };
-        LOG_DEBUG("resolved host:{} target:{} to '{}:{}'", host, target, ep.host_name(), ep.service_name());
-
-        if (auto res =
-                co_await (beast::get_lowest_layer(stream).async_connect(ep, asio::use_awaitable) or timeout(10s));
-            res.index() == 1)
+        catch (const std::exception& e)
         {
-            LOG_ERROR("async_connect to {} timed out", host);
-            co_return;
+            LOG_ERROR("read from {}{} failed after {}ms. {}", req.m_host, req.m_target, elapsedMs, e.what());
         }
+        return;
+    }
 
-        const auto& socket = stream.next_layer().socket();
-        LOG_DEBUG(
-            "connected to {}:{}", socket.remote_endpoint().address().to_string(), socket.remote_endpoint().port()
+    const auto status{ result.m_response.result() };
+    std::ostringstream oss;
+    oss << status;
+    std::string statusStr{ oss.str() };
+    if (status == beast::http::status::ok)
+    {
+        LOG_INFO(
+            "read {} bytes from {}{} in {}ms{}: {}",
+            result.m_response.body().size(),
+            req.m_host,
+            req.m_target,
+            elapsedMs,
+            result.m_cached ? " (cached)" : "",
+            result.m_response.body()
         );
-
-        std::get<0>(co_await (stream.async_handshake(ssl::stream_base::client, asio::use_awaitable) or timeout(10s)));
-
-        LOG_DEBUG("handshake completed {}", host);
-
-        beast::http::request<beast::http::string_body> req{ beast::http::verb::get, target, 11 };
-        req.set(beast::http::field::version, "2.0");
-        req.set(beast::http::field::host, host);
-        req.set(beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-        auto nBytesWritten =
-            std::get<0>(co_await (beast::http::async_write(stream, req, asio::use_awaitable) or timeout(10s)));
-        LOG_INFO("wrote {} bytes to {}", nBytesWritten, host);
-
-        beast::flat_buffer buff{};
-        beast::http::response<beast::http::string_body> res;
-        auto nBytesRead =
-            std::get<0>(co_await (beast::http::async_read(stream, buff, res, asio::use_awaitable) or timeout(10s)));
-
-        auto status{ res.result() };
-        std::ostringstream oss;
-        oss << status;
-        std::string statusStr{ oss.str() };
-        if (status == beast::http::status::ok)
-        {
-            std::string body{ res.body() };
-            LOG_INFO("read {} bytes from {} status: {} res: {}", nBytesRead, host, statusStr, body);
-        }
-        else
-        {
-            LOG_ERROR("read failed with status: {}", statusStr);
-        }
-
-        boost::system::error_code ec;
-        co_await stream.async_shutdown(asio::redirect_error(ec));
-        if (ec.failed())
-        {
-            LOG_WARNING("read shutdown failed.e: {}", ec.what());
-        }
-        else
-        {
-            LOG_INFO("stream to {} closed", host);
-        }
     }
-    catch (const std::exception& e)
+    else
     {
-        LOG_ERROR("read failed {}", e.what());
+        LOG_ERROR("read from {}{} failed with status: {}", req.m_host, req.m_target, statusStr);
     }
 }
 
-asio::awaitable<void> read_http(std::string host, std::string target, ssl::context& sslCtx)
+asio::awaitable<void> read_http(
+    std::vector<FetchRequest> requests,
+    std::shared_ptr<HttpBatch> batch,
+    std::chrono::steady_clock::duration interval
+)
 {
     auto exc{ co_await asio::this_coro::executor };
     asio::steady_timer timer{ exc };
 
     while (true)
     {
-        co_await read_http_once(host, target, sslCtx);
-        timer.expires_after(10s);
+        timer.expires_after(interval);
+        co_await batch->FetchEach(
+            requests,
+            [&requests](FetchResult result) -> asio::awaitable<void>
+            {
+                log_result(requests[result.m_index], result);
+                co_return;
+            }
+        );
+
+        const auto batchStats{ batch->Stats() };
+        LOG_DEBUG(
+            "http batch fetched: {} failed: {} timed out: {}",
+            batchStats.m_fetched,
+            batchStats.m_failed,
+            batchStats.m_timedOut
+        );
+        if (const auto* cache{ batch->Cache() })
+        {
+            const auto cacheStats{ cache->Stats() };
+            LOG_DEBUG(
+                "response cache fresh: {} not modified: {} misses: {} evicted: {} entries: {} ({} bytes)",
+                cacheStats.m_fresh,
+                cacheStats.m_notModified,
+                cacheStats.m_misses,
+                cacheStats.m_evictions,
+                cacheStats.m_entries,
+                cacheStats.m_bytes
+            );
+        }
+        const auto stats{ batch->Pool().Stats() };
+        LOG_DEBUG(
+            "https pool hits: {} misses: {} stale: {} retries: {} h2 streams: {} (on {} connections) connects: {} "
+            "(avg {}us, max {}us) failed: {} compressed bodies: {} bytes -> {} bytes",
+            stats.m_hits,
+            stats.m_misses,
+            stats.m_stale,
+            stats.m_retries,
+            stats.m_http2Streams,
+            stats.m_http2Connections,
+            stats.m_connects,
+            stats.m_connects ? stats.m_connectTime.count() / static_cast<int64_t>(stats.m_connects) : 0,
+            stats.m_maxConnectTime.count(),
+            stats.m_connectFailures,
+            stats.m_encodedBytes,
+            stats.m_decodedBytes
+        );
+        const auto dnsStats{ batch->Pool().Dns().Stats() };
+        LOG_DEBUG(
+            "dns cache hits: {} stale: {} merged: {} lookups: {} failed: {}",
+            dnsStats.m_hits,
+            dnsStats.m_staleHits,
+            dnsStats.m_merged,
+            dnsStats.m_lookups,
+            dnsStats.m_failures
+        );
+
+        // every interval from the start of the last batch, unless that took longer
         co_await timer.async_wait();
     }
 }
@@ -1,5 +1,14 @@
 #pragma once
 
 #include "async_aliases.hpp"
+#include "http_batch.hpp"
+#include <chrono>
+#include <memory>
+#include <vector>
 
-asio::awaitable<void> read_http(std::string host, std::string target, ssl::context& sslCtx);
+// Fetches requests as one batch every interval and logs what came back
+asio::awaitable<void> read_http(
+    std::vector<FetchRequest> requests,
+    std::shared_ptr<HttpBatch> batch,
+    std::chrono::steady_clock::duration interval
+);
@@ -0,0 +1,460 @@
+#include "https_pool.hpp"
+#include "content_decoder.hpp"
+#include "deadline.hpp"
+#include "happy_eyeballs.hpp"
+#include "log/logger.hpp"
+#include "tls_resumption.hpp"
+#include <array>
+#include <cerrno>
+#include <exception>
+#include <openssl/tls1.h>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+namespace
+{
+
+// h2 first, in the length prefixed wire format of ALPN
+constexpr std::array<unsigned char, 12> ALPN_PROTOCOLS{ 2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1' };
+
+// the header of a decoded body, which has neither its encoding nor its encoded length anymore
+void strip_content_encoding(HttpsPool::ResponseHeader& header)
+{
+    header.erase(beast::http::field::content_encoding);
+    header.erase(beast::http::field::content_length);
+}
+
+// safe to send again after the first attempt may or may not have reached the server
+bool idempotent(beast::http::verb method) noexcept
+{
+    using beast::http::verb;
+    return method == verb::get or method == verb::head or method == verb::options or method == verb::put or
+           method == verb::delete_;
+}
+
+} // namespace
+
+HttpsPool::HttpsPool(ssl::context& ctx, std::shared_ptr<DnsCache> dns, HttpsPoolConfig cfg) :
+    m_ctx{ ctx },
+    m_dns{ std::move(dns) },
+    m_cfg{ cfg }
+{
+}
+
+asio::awaitable<HttpsPool::Response> HttpsPool::Send(const std::string& host, const Request& req)
+{
+    Response res{};
+    auto header{ co_await SendStreaming(
+        host,
+        req,
+        [this, &res](const ResponseHeader&, std::span<const char> chunk) -> asio::awaitable<void>
+        {
+            if (res.body().size() + chunk.size() > m_cfg.m_maxBodyBytes)
+            {
+                throw boost::system::system_error{ beast::http::error::body_limit };
+            }
+            res.body().append(chunk.data(), chunk.size());
+            co_return;
+        }
+    ) };
+    res.base() = std::move(header);
+    co_return res;
+}
+
+asio::awaitable<HttpsPool::ResponseHeader> HttpsPool::SendStreaming(
+    const std::string& host,
+    const Request& req,
+    BodyConsumer consume
+)
+{
+    // a caller that negotiates on its own gets the body as it was sent
+    if (not m_cfg.m_decompress or req.count(beast::http::field::accept_encoding) > 0)
+    {
+        co_return co_await SendEncoded(host, req, std::move(consume));
+    }
+
+    Request offer{ req };
+    offer.set(beast::http::field::accept_encoding, ACCEPT_ENCODING);
+
+    std::optional<ContentDecoder> decoder{};
+    std::optional<ResponseHeader> decodedHeader{};
+    auto header{ co_await SendEncoded(
+        host,
+        offer,
+        [this, &consume, &decoder, &decodedHeader](
+            const ResponseHeader& res, std::span<const char> chunk
+        ) -> asio::awaitable<void>
+        {
+            if (not decodedHeader)
+            {
+                decodedHeader.emplace(res);
+                if (auto encoding{ parse_content_encoding(res[beast::http::field::content_encoding]) })
+                {
+                    decoder.emplace(*encoding, m_cfg.m_maxInFlight);
+                    strip_content_encoding(*decodedHeader);
+                }
+            }
+
+            if (not decoder)
+            {
+                co_await consume(res, chunk);
+                co_return;
+            }
+
+            m_encodedBytes.fetch_add(chunk.size(), std::memory_order::relaxed);
+            decoder->Feed(chunk);
+            for (auto decoded{ decoder->Next() }; not decoded.empty(); decoded = decoder->Next())
+            {
+                m_decodedBytes.fetch_add(decoded.size(), std::memory_order::relaxed);
+                co_await consume(*decodedHeader, decoded);
+            }
+        }
+    ) };
+
+    if (decoder)
+    {
+        decoder->Finish();
+        strip_content_encoding(header);
+    }
+
+    co_return header;
+}
+
+asio::awaitable<HttpsPool::ResponseHeader> HttpsPool::SendEncoded(
+    const std::string& host,
+    const Request& req,
+    BodyConsumer consume
+)
+{
+    if (m_cfg.m_http2)
+    {
+        if (auto connection{ co_await Http2For(host) })
+        {
+            co_return co_await connection->Send(Authority(host), req, std::move(consume));
+        }
+    }
+
+    auto pending{ co_await Begin(host, req) };
+    beast::http::response_parser<beast::http::buffer_body> parser{ std::move(*pending.m_parser) };
+    // nothing accumulates, so there is nothing to limit
+    parser.body_limit(boost::none);
+
+    std::vector<char> chunk(m_cfg.m_maxInFlight);
+    Deadline deadline{ pending.m_stream->get_executor() };
+    while (not parser.is_done())
+    {
+        auto& body{ parser.get().body() };
+        body.data = chunk.data();
+        body.size = chunk.size();
+
+        boost::system::error_code ec;
+        co_await deadline.Within(
+            m_cfg.m_timeout,
+            beast::http::async_read(*pending.m_stream, pending.m_buffer, parser, asio::deferred),
+            asio::redirect_error(asio::deferred, ec)
+        );
+        // the chunk is full, which is what the loop waits for
+        if (ec and ec != beast::http::error::need_buffer)
+        {
+            throw boost::system::system_error{ ec };
+        }
+
+        const size_t nBytes{ chunk.size() - body.size };
+        if (nBytes > 0)
+        {
+            co_await consume(parser.get().base(), std::span<const char>{ chunk.data(), nBytes });
+        }
+    }
+
+    ResponseHeader header{ std::move(parser.get().base()) };
+    if (header.keep_alive())
+    {
+        PutIdle(host, std::move(pending.m_stream));
+    }
+
+    co_return header;
+}
+
+HttpsPoolStats HttpsPool::Stats() const noexcept
+{
+    return HttpsPoolStats{
+        .m_hits = m_hits.load(std::memory_order::relaxed),
+        .m_misses = m_misses.load(std::memory_order::relaxed),
+        .m_stale = m_stale.load(std::memory_order::relaxed),
+        .m_retries = m_retries.load(std::memory_order::relaxed),
+        .m_connects = m_connects.load(std::memory_order::relaxed),
+        .m_connectFailures = m_connectFailures.load(std::memory_order::relaxed),
+        .m_http2Streams = m_http2Streams.load(std::memory_order::relaxed),
+        .m_http2Connections = m_http2Connections.load(std::memory_order::relaxed),
+        .m_encodedBytes = m_encodedBytes.load(std::memory_order::relaxed),
+        .m_decodedBytes = m_decodedBytes.load(std::memory_order::relaxed),
+        .m_connectTime = std::chrono::microseconds{ m_connectMicros.load(std::memory_order::relaxed) },
+        .m_maxConnectTime = std::chrono::microseconds{ m_maxConnectMicros.load(std::memory_order::relaxed) },
+    };
+}
+
+std::unique_ptr<HttpsPool::Stream> HttpsPool::TakeIdle(const std::string& host)
+{
+    const auto now{ std::chrono::steady_clock::now() };
+
+    std::lock_guard lk{ m_idleMutex };
+    auto it{ m_idle.find(host) };
+    if (it == m_idle.end())
+    {
+        return nullptr;
+    }
+
+    // newest first. once one has expired every older one has too
+    auto& idle{ it->second };
+    while (not idle.empty())
+    {
+        auto conn{ std::move(idle.back()) };
+        idle.pop_back();
+        if (now - conn.m_idleSince < m_cfg.m_idleTtl and not ClosedByPeer(*conn.m_stream))
+        {
+            return std::move(conn.m_stream);
+        }
+        m_stale.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    return nullptr;
+}
+
+void HttpsPool::PutIdle(const std::string& host, std::unique_ptr<Stream> stream)
+{
+    std::lock_guard lk{ m_idleMutex };
+    auto& idle{ m_idle[host] };
+    idle.push_back(IdleConnection{ .m_stream = std::move(stream), .m_idleSince = std::chrono::steady_clock::now() });
+    while (idle.size() > m_cfg.m_maxIdlePerHost)
+    {
+        idle.pop_front();
+    }
+}
+
+asio::awaitable<std::unique_ptr<HttpsPool::Stream>> HttpsPool::Connect(const std::string& host)
+{
+    const auto start{ std::chrono::steady_clock::now() };
+    auto exc{ co_await asio::this_coro::executor };
+    auto stream{ std::make_unique<Stream>(exc, m_ctx) };
+
+    try
+    {
+        // required for SNI verification
+        if (not SSL_set_tlsext_host_name(stream->native_handle(), host.c_str()))
+        {
+            throw beast::system_error(static_cast<asio::error::ssl_errors>(::ERR_get_error()));
+        }
+
+        if (m_cfg.m_http2 and
+            SSL_set_alpn_protos(stream->native_handle(), ALPN_PROTOCOLS.data(), ALPN_PROTOCOLS.size()) != 0)
+        {
+            throw beast::system_error(static_cast<asio::error::ssl_errors>(::ERR_get_error()));
+        }
+
+        auto* resumption{ TlsResumption::Of(stream->native_handle()) };
+        if (resumption)
+        {
+            resumption->OfferSession(stream->native_handle(), host);
+        }
+
+        auto resolved{ co_await m_dns->Resolve(host, m_cfg.m_service) };
+
+        Deadline deadline{ exc };
+        auto& lowest{ beast::get_lowest_layer(*stream) };
+        lowest.socket() = co_await deadline.Within(
+            m_cfg.m_timeout,
+            asio::co_spawn(
+                exc, happy_eyeballs_connect(interleave_families(resolved), m_cfg.m_attemptDelay), asio::deferred
+            )
+        );
+        const auto ep{ lowest.socket().remote_endpoint() };
+        LOG_DEBUG("connected to {} at {}:{}", host, ep.address().to_string(), ep.port());
+
+        co_await deadline.Within(m_cfg.m_timeout, stream->async_handshake(ssl::stream_base::client, asio::deferred));
+
+        if (resumption)
+        {
+            resumption->RecordHandshake(stream->native_handle());
+        }
+        LOG_DEBUG("handshake completed {}. resumed: {}", host, SSL_session_reused(stream->native_handle()) == 1);
+    }
+    catch (const std::exception&)
+    {
+        m_connectFailures.fetch_add(1, std::memory_order::relaxed);
+        throw;
+    }
+
+    const auto micros{
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()
+    };
+    m_connects.fetch_add(1, std::memory_order::relaxed);
+    m_connectMicros.fetch_add(micros, std::memory_order::relaxed);
+    int64_t maxMicros{ m_maxConnectMicros.load(std::memory_order::relaxed) };
+    while (micros > maxMicros and
+           not m_maxConnectMicros.compare_exchange_weak(maxMicros, micros, std::memory_order::relaxed))
+    {
+    }
+
+    co_return stream;
+}
+
+asio::awaitable<std::shared_ptr<Http2Connection>> HttpsPool::Http2For(const std::string& host)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    while (true)
+    {
+        std::shared_ptr<asio::steady_timer> waiter{};
+        {
+            std::lock_guard lk{ m_http2Mutex };
+            auto& entry{ m_http2[host] };
+            if (entry.m_http1Only)
+            {
+                co_return nullptr;
+            }
+            if (entry.m_connection and entry.m_connection->Usable())
+            {
+                m_hits.fetch_add(1, std::memory_order::relaxed);
+                m_http2Streams.fetch_add(1, std::memory_order::relaxed);
+                co_return entry.m_connection;
+            }
+            if (not entry.m_connecting)
+            {
+                entry.m_connecting = true;
+                break;
+            }
+
+            waiter = std::make_shared<asio::steady_timer>(exc, asio::steady_timer::time_point::max());
+            entry.m_waiters.push_back(waiter);
+        }
+
+        boost::system::error_code ec;
+        co_await waiter->async_wait(asio::redirect_error(ec));
+    }
+
+    std::unique_ptr<Stream> stream{};
+    std::exception_ptr error{};
+    try
+    {
+        stream = co_await Connect(host);
+    }
+    catch (const std::exception&)
+    {
+        error = std::current_exception();
+    }
+
+    std::shared_ptr<Http2Connection> connection{};
+    if (stream and NegotiatedHttp2(*stream))
+    {
+        connection = std::make_shared<Http2Connection>(std::move(stream), m_cfg.m_maxInFlight, m_cfg.m_timeout);
+        connection->Start();
+        m_misses.fetch_add(1, std::memory_order::relaxed);
+        m_http2Streams.fetch_add(1, std::memory_order::relaxed);
+        m_http2Connections.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    std::vector<std::shared_ptr<asio::steady_timer>> waiters{};
+    {
+        std::lock_guard lk{ m_http2Mutex };
+        auto& entry{ m_http2[host] };
+        entry.m_connecting = false;
+        entry.m_connection = connection;
+        entry.m_http1Only = stream != nullptr;
+        waiters = std::exchange(entry.m_waiters, {});
+    }
+    for (auto& waiter : waiters)
+    {
+        asio::post(waiter->get_executor(), [waiter] { waiter->cancel(); });
+    }
+
+    if (stream)
+    {
+        LOG_INFO("{} doesn't speak HTTP/2, using HTTP/1.1", host);
+        PutIdle(host, std::move(stream));
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    co_return connection;
+}
+
+std::string HttpsPool::Authority(const std::string& host) const
+{
+    return m_cfg.m_service == "https" or m_cfg.m_service == "443" ? host : host + ':' + m_cfg.m_service;
+}
+
+asio::awaitable<HttpsPool::PendingResponse> HttpsPool::Begin(const std::string& host, const Request& req)
+{
+    auto stream{ TakeIdle(host) };
+    const bool pooled{ stream != nullptr };
+    (pooled ? m_hits : m_misses).fetch_add(1, std::memory_order::relaxed);
+
+    if (pooled)
+    {
+        std::exception_ptr pooledError{};
+        try
+        {
+            co_return co_await Exchange(std::move(stream), req);
+        }
+        catch (const boost::system::system_error& e)
+        {
+            // the server may have closed it after the health check, or while the request was on its way
+            LOG_DEBUG("pooled connection to {} failed. {}", host, e.what());
+            pooledError = std::current_exception();
+        }
+
+        if (not idempotent(req.method()))
+        {
+            std::rethrow_exception(pooledError);
+        }
+        m_retries.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    co_return co_await Exchange(co_await Connect(host), req);
+}
+
+asio::awaitable<HttpsPool::PendingResponse> HttpsPool::Exchange(std::unique_ptr<Stream> stream, const Request& req)
+{
+    // a pooled stream may have been opened on another executor than this coroutine's
+    Deadline deadline{ stream->get_executor() };
+    co_await deadline.Within(m_cfg.m_timeout, beast::http::async_write(*stream, req, asio::deferred));
+
+    // the server sends nothing past the response, so nothing is lost with the buffer once the body is read
+    PendingResponse pending{
+        .m_stream = std::move(stream),
+        .m_buffer = beast::flat_buffer{ m_cfg.m_maxInFlight },
+        .m_parser = std::make_unique<beast::http::response_parser<beast::http::empty_body>>(),
+    };
+    co_await deadline.Within(
+        m_cfg.m_timeout,
+        beast::http::async_read_header(*pending.m_stream, pending.m_buffer, *pending.m_parser, asio::deferred)
+    );
+
+    co_return pending;
+}
+
+bool HttpsPool::ClosedByPeer(Stream& stream) noexcept
+{
+    auto& socket{ beast::get_lowest_layer(stream).socket() };
+    if (not socket.is_open())
+    {
+        return true;
+    }
+
+    // nothing is sent between responses, so anything readable is the FIN or the alert ahead of it
+    char byte{};
+    const auto nBytes{ ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT) };
+    return nBytes >= 0 or (errno != EAGAIN and errno != EWOULDBLOCK);
+}
+
+bool HttpsPool::NegotiatedHttp2(Stream& stream) noexcept
+{
+    const unsigned char* protocol{ nullptr };
+    unsigned int length{ 0 };
+    SSL_get0_alpn_selected(stream.native_handle(), &protocol, &length);
+    return std::string_view{ reinterpret_cast<const char*>(protocol), length } == "h2";
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "dns_cache.hpp"
+#include "http2_connection.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct HttpsPoolConfig
+{
+    // offer h2 through ALPN and send every request to a host that accepts it over one multiplexed connection
+    bool m_http2{ false };
+    // port or service name to connect to
+    std::string m_service{ "https" };
+    // idle connections kept per host, the oldest ones go first
+    size_t m_maxIdlePerHost{ 4 };
+    // an idle connection older than this is closed instead of reused
+    std::chrono::steady_clock::duration m_idleTtl{ std::chrono::seconds{ 30 } };
+    // largest read from the socket, and the most body a streamed response holds before its consumer takes it.
+    // response headers must fit too
+    size_t m_maxInFlight{ 64 * 1024 };
+    // largest body Send returns, after decoding
+    size_t m_maxBodyBytes{ 8 * 1024 * 1024 };
+    // offer gzip, deflate and brotli in Accept-Encoding and hand out bodies decoded
+    bool m_decompress{ true };
+    // for each of connect (all addresses together), handshake, write and read
+    std::chrono::steady_clock::duration m_timeout{ std::chrono::seconds{ 10 } };
+    // head start each resolved address gets before the next one is tried alongside it
+    std::chrono::steady_clock::duration m_attemptDelay{ std::chrono::milliseconds{ 250 } };
+};
+
+struct HttpsPoolStats
+{
+    // requests sent on a pooled connection
+    size_t m_hits;
+    // requests that needed a new connection
+    size_t m_misses;
+    // pooled connections dropped for being expired or closed by the server
+    size_t m_stale;
+    // requests repeated on a new connection after a pooled one failed
+    size_t m_retries;
+    size_t m_connects;
+    size_t m_connectFailures;
+    // requests sent on an HTTP/2 connection, also counted as hits or misses
+    size_t m_http2Streams;
+    size_t m_http2Connections;
+    // of the bodies that arrived compressed, before and after decoding
+    size_t m_encodedBytes;
+    size_t m_decodedBytes;
+    // resolve (mostly a cache hit) + TCP connect + TLS handshake of the successful connects
+    std::chrono::microseconds m_connectTime;
+    std::chrono::microseconds m_maxConnectTime;
+};
+
+// Keep-alive HTTPS connections, pooled per host.
+// With m_http2 a host that negotiates h2 gets a single connection that carries all of its requests at once, and
+// everything below is about the HTTP/1.1 connections of the hosts that don't.
+// A request goes out on the most recently used idle connection to its host that is still open, or a new one. If a
+// pooled connection fails before the response header arrives, the request is repeated once on a new connection. A
+// connection goes back to the pool once a response that allows keep-alive has been read completely.
+class HttpsPool
+{
+public:
+    using Stream = ssl::stream<beast::tcp_stream>;
+    using Request = beast::http::request<beast::http::string_body>;
+    using Response = beast::http::response<beast::http::string_body>;
+    using ResponseHeader = Http2Connection::ResponseHeader;
+    // Takes the next piece of a streamed body, at most HttpsPoolConfig::m_maxInFlight bytes. Nothing more is read for
+    // the response until it returns, so a slow consumer holds the server back through TCP or HTTP/2 flow control
+    // instead of growing a buffer. The span is only valid until then
+    using BodyConsumer = Http2Connection::BodyConsumer;
+
+    // ctx must outlive the pool. hosts are resolved through dns, which may be shared with other pools
+    HttpsPool(ssl::context& ctx, std::shared_ptr<DnsCache> dns, HttpsPoolConfig cfg = {});
+
+    asio::awaitable<Response> Send(const std::string& host, const Request& req);
+
+    // Like Send, but the body goes to consume as it arrives instead of into the response, so memory stays at
+    // m_maxInFlight no matter how large the body is. Returns the header once the body has been consumed.
+    // With m_decompress and no Accept-Encoding of its own in req, a compressed body is decoded on the way to consume,
+    // and its header has no Content-Encoding and Content-Length
+    asio::awaitable<ResponseHeader> SendStreaming(const std::string& host, const Request& req, BodyConsumer consume);
+
+    HttpsPoolStats Stats() const noexcept;
+
+    const DnsCache& Dns() const noexcept
+    {
+        return *m_dns;
+    }
+
+private:
+    struct IdleConnection
+    {
+        std::unique_ptr<Stream> m_stream;
+        std::chrono::steady_clock::time_point m_idleSince;
+    };
+
+    struct Http2Host
+    {
+        std::shared_ptr<Http2Connection> m_connection{};
+        bool m_connecting{ false };
+        // the server chose HTTP/1.1
+        bool m_http1Only{ false };
+        // woken once the connect in progress is done
+        std::vector<std::shared_ptr<asio::steady_timer>> m_waiters{};
+    };
+
+    // a request whose response header has been read, the body is still on the connection
+    struct PendingResponse
+    {
+        std::unique_ptr<Stream> m_stream;
+        beast::flat_buffer m_buffer;
+        // not movable by itself
+        std::unique_ptr<beast::http::response_parser<beast::http::empty_body>> m_parser;
+    };
+
+    // SendStreaming, with the body passed on as it was sent
+    asio::awaitable<ResponseHeader> SendEncoded(const std::string& host, const Request& req, BodyConsumer consume);
+
+    // a pooled connection that is still open, or nullptr
+    std::unique_ptr<Stream> TakeIdle(const std::string& host);
+
+    void PutIdle(const std::string& host, std::unique_ptr<Stream> stream);
+
+    asio::awaitable<std::unique_ptr<Stream>> Connect(const std::string& host);
+
+    // The host's HTTP/2 connection, opened by the first caller while the others wait for it. nullptr for a host that
+    // only speaks HTTP/1.1, whose connection then goes to the idle pool
+    asio::awaitable<std::shared_ptr<Http2Connection>> Http2For(const std::string& host);
+
+    std::string Authority(const std::string& host) const;
+
+    // sends req and reads the response header, retrying as described above
+    asio::awaitable<PendingResponse> Begin(const std::string& host, const Request& req);
+
+    asio::awaitable<PendingResponse> Exchange(std::unique_ptr<Stream> stream, const Request& req);
+
+    // whether the server closed, or sent something unasked, while the connection sat in the pool
+    static bool ClosedByPeer(Stream& stream) noexcept;
+
+    static bool NegotiatedHttp2(Stream& stream) noexcept;
+
+    ssl::context& m_ctx;
+    const std::shared_ptr<DnsCache> m_dns;
+    const HttpsPoolConfig m_cfg;
+
+    std::mutex m_idleMutex{};
+    // newest at the back
+    std::unordered_map<std::string, std::deque<IdleConnection>> m_idle{};
+
+    std::mutex m_http2Mutex{};
+    std::unordered_map<std::string, Http2Host> m_http2{};
+
+    std::atomic<size_t> m_hits{ 0 };
+    std::atomic<size_t> m_misses{ 0 };
+    std::atomic<size_t> m_stale{ 0 };
+    std::atomic<size_t> m_retries{ 0 };
+    std::atomic<size_t> m_connects{ 0 };
+    std::atomic<size_t> m_connectFailures{ 0 };
+    std::atomic<size_t> m_http2Streams{ 0 };
+    std::atomic<size_t> m_http2Connections{ 0 };
+    std::atomic<size_t> m_encodedBytes{ 0 };
+    std::atomic<size_t> m_decodedBytes{ 0 };
+    std::atomic<int64_t> m_connectMicros{ 0 };
+    std::atomic<int64_t> m_maxConnectMicros{ 0 };
+};
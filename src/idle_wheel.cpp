@@ -0,0 +1,103 @@
+#include "idle_wheel.hpp"
+#include <algorithm>
+#include <utility>
+
+IdleWatch::IdleWatch(const std::atomic<uint64_t>& now, uint64_t timeoutTicks, std::function<void()> onIdle) :
+    m_now{ now },
+    m_timeoutTicks{ timeoutTicks },
+    m_onIdle{ std::move(onIdle) },
+    m_lastActive{ now.load(std::memory_order::relaxed) }
+{
+}
+
+void IdleWatch::Touch() noexcept
+{
+    m_lastActive.store(m_now.load(std::memory_order::relaxed), std::memory_order::relaxed);
+}
+
+IdleWheel::IdleWheel(std::chrono::steady_clock::duration tick, size_t nSlots) :
+    m_tick{ tick },
+    m_slots(std::max<size_t>(nSlots, 1))
+{
+}
+
+std::shared_ptr<IdleWatch>
+IdleWheel::Watch(std::chrono::steady_clock::duration idleTimeout, std::function<void()> onIdle)
+{
+    // rounded up, a connection is never cut before its full timeout
+    const auto ticks{ (idleTimeout + m_tick - std::chrono::nanoseconds{ 1 }) / m_tick };
+    const auto timeoutTicks{ static_cast<uint64_t>(std::max<int64_t>(ticks, 1)) };
+    std::shared_ptr<IdleWatch> watch{ new IdleWatch{ m_now, timeoutTicks, std::move(onIdle) } };
+
+    std::lock_guard lk{ m_mutex };
+    // the current tick is already partly over, so the deadline is one tick past the timeout
+    const uint64_t deadline{ m_now.load(std::memory_order::relaxed) + timeoutTicks + 1 };
+    m_slots[deadline % m_slots.size()].push_back(watch);
+    m_size++;
+
+    return watch;
+}
+
+asio::awaitable<void> IdleWheel::Run()
+{
+    auto self{ shared_from_this() };
+    asio::steady_timer timer{ co_await asio::this_coro::executor };
+
+    // scheduled off the start time so ticks don't drift, and catch up if the executor falls behind
+    auto next{ std::chrono::steady_clock::now() };
+    while (true)
+    {
+        next += m_tick;
+        timer.expires_at(next);
+        co_await timer.async_wait();
+
+        Advance();
+    }
+}
+
+size_t IdleWheel::Size() const
+{
+    std::lock_guard lk{ m_mutex };
+    return m_size;
+}
+
+void IdleWheel::Advance()
+{
+    // Run() is the only writer
+    const uint64_t now{ m_now.load(std::memory_order::relaxed) + 1 };
+    m_now.store(now, std::memory_order::relaxed);
+
+    {
+        std::lock_guard lk{ m_mutex };
+        m_due.swap(m_slots[now % m_slots.size()]);
+        for (auto& entry : m_due)
+        {
+            auto watch{ entry.lock() };
+            if (not watch)
+            {
+                m_size--;
+                continue;
+            }
+
+            const uint64_t lastActive{ watch->m_lastActive.load(std::memory_order::relaxed) };
+            const uint64_t deadline{ (lastActive == IdleWatch::HELD ? now : lastActive) + watch->m_timeoutTicks + 1 };
+            if (deadline <= now)
+            {
+                m_size--;
+                m_expired.push_back(std::move(watch));
+                continue;
+            }
+
+            // touched since it was filed. a deadline more than a lap away just comes round again
+            m_slots[deadline % m_slots.size()].push_back(std::move(entry));
+        }
+        m_due.clear();
+    }
+
+    for (auto& watch : m_expired)
+    {
+        watch->m_expired.store(true, std::memory_order::relaxed);
+        watch->m_onIdle();
+    }
+    m_expired.clear();
+}
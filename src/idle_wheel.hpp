@@ -0,0 +1,81 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class IdleWheel;
+
+// A connection's entry in an IdleWheel. Dropping the last reference unregisters it
+class IdleWatch
+{
+public:
+    // Marks activity. Just a load of the wheel's clock and a store, meant to be called on every read
+    void Touch() noexcept;
+
+    // Never idle until the next Touch(). For when the connection isn't read on purpose
+    void Hold() noexcept { m_lastActive.store(HELD, std::memory_order::relaxed); }
+
+    // Whether onIdle has been called
+    bool Expired() const noexcept { return m_expired.load(std::memory_order::relaxed); }
+
+private:
+    friend class IdleWheel;
+
+    static constexpr uint64_t HELD{ std::numeric_limits<uint64_t>::max() };
+
+    IdleWatch(const std::atomic<uint64_t>& now, uint64_t timeoutTicks, std::function<void()> onIdle);
+
+    const std::atomic<uint64_t>& m_now;
+    const uint64_t m_timeoutTicks;
+    std::function<void()> m_onIdle;
+    std::atomic<uint64_t> m_lastActive;
+    std::atomic<bool> m_expired{ false };
+};
+
+// Hashed timing wheel for idle timeouts. One timer for every connection instead of one per read.
+// Watches sit in the slot of their deadline tick and are only looked at when the wheel reaches it. One that has
+// been touched since is moved on to its new deadline, one that hasn't is expired with the rest of its slot.
+// Deadlines are rounded up to whole ticks.
+class IdleWheel : public std::enable_shared_from_this<IdleWheel>
+{
+public:
+    static constexpr size_t DEFAULT_SLOTS{ 512 };
+
+    explicit IdleWheel(std::chrono::steady_clock::duration tick, size_t nSlots = DEFAULT_SLOTS);
+
+    // Thread safe. onIdle runs once, from Run(), after idleTimeout without a Touch().
+    // The wheel must outlive the watch
+    std::shared_ptr<IdleWatch> Watch(std::chrono::steady_clock::duration idleTimeout, std::function<void()> onIdle);
+
+    // Advances the wheel once per tick until cancelled
+    asio::awaitable<void> Run();
+
+    size_t Size() const;
+
+private:
+    IdleWheel(const IdleWheel&) = delete;
+    IdleWheel(IdleWheel&&) = delete;
+    IdleWheel& operator=(const IdleWheel&) = delete;
+    IdleWheel& operator=(IdleWheel&&) = delete;
+
+    void Advance();
+
+    const std::chrono::steady_clock::duration m_tick;
+    std::atomic<uint64_t> m_now{ 0 };
+
+    mutable std::mutex m_mutex{};
+    std::vector<std::vector<std::weak_ptr<IdleWatch>>> m_slots;
+    size_t m_size{ 0 };
+
+    // reused between ticks. only touched by Advance()
+    std::vector<std::weak_ptr<IdleWatch>> m_due{};
+    std::vector<std::shared_ptr<IdleWatch>> m_expired{};
+};
@@ -0,0 +1,335 @@
+#include "kernel_tls.hpp"
+#include "log/logger.hpp"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <linux/tls.h>
+#include <memory>
+#include <netinet/tcp.h>
+#include <openssl/core_names.h>
+#include <openssl/kdf.h>
+#include <openssl/params.h>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+namespace
+{
+
+// What the server's side of a connection needs to be handed to the kernel. Lives in the SSL's ex data
+struct TransmitState
+{
+    std::vector<unsigned char> m_secret{};
+    // past the server's Finished every record is under the application traffic key, the session tickets included
+    bool m_applicationKeys{ false };
+    uint64_t m_records{ 0 };
+    // the socket, once the kernel took over sending
+    int m_offloadedFd{ -1 };
+    bool m_abandoned{ false };
+};
+
+void FreeTransmitState(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+{
+    if (auto* state{ static_cast<TransmitState*>(ptr) })
+    {
+        OPENSSL_cleanse(state->m_secret.data(), state->m_secret.size());
+        delete state;
+    }
+}
+
+int CtxExDataIndex()
+{
+    static const int idx{ SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr) };
+    return idx;
+}
+
+int SslExDataIndex()
+{
+    static const int idx{ SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &FreeTransmitState) };
+    return idx;
+}
+
+TransmitState& StateOf(SSL* ssl)
+{
+    auto* state{ static_cast<TransmitState*>(SSL_get_ex_data(ssl, SslExDataIndex())) };
+    if (not state)
+    {
+        state = new TransmitState{};
+        SSL_set_ex_data(ssl, SslExDataIndex(), state);
+    }
+    return *state;
+}
+
+struct KdfCtxFree
+{
+    void operator()(EVP_KDF_CTX* ctx) const noexcept { EVP_KDF_CTX_free(ctx); }
+};
+
+// RFC 8446 7.1 HKDF-Expand-Label with an empty context
+bool ExpandLabel(
+    const EVP_MD* md,
+    std::span<const unsigned char> secret,
+    std::string_view label,
+    std::span<unsigned char> out
+)
+{
+    constexpr std::string_view PREFIX{ "tls13 " };
+    std::vector<unsigned char> hkdfLabel{
+        static_cast<unsigned char>(out.size() >> 8),
+        static_cast<unsigned char>(out.size() & 0xff),
+        static_cast<unsigned char>(PREFIX.size() + label.size()),
+    };
+    hkdfLabel.insert(hkdfLabel.end(), PREFIX.begin(), PREFIX.end());
+    hkdfLabel.insert(hkdfLabel.end(), label.begin(), label.end());
+    hkdfLabel.push_back(0);
+
+    EVP_KDF* kdf{ EVP_KDF_fetch(nullptr, OSSL_KDF_NAME_HKDF, nullptr) };
+    std::unique_ptr<EVP_KDF_CTX, KdfCtxFree> ctx{ EVP_KDF_CTX_new(kdf) };
+    EVP_KDF_free(kdf);
+    if (not ctx)
+    {
+        return false;
+    }
+
+    int mode{ EVP_KDF_HKDF_MODE_EXPAND_ONLY };
+    std::array params{
+        OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode),
+        OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, const_cast<char*>(EVP_MD_get0_name(md)), 0),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, const_cast<unsigned char*>(secret.data()), secret.size()),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, hkdfLabel.data(), hkdfLabel.size()),
+        OSSL_PARAM_construct_end(),
+    };
+    return EVP_KDF_derive(ctx.get(), out.data(), out.size(), params.data()) == 1;
+}
+
+// setsockopt(TLS_TX) payload for any of the kernel's cipher layouts
+struct CryptoInfo
+{
+    std::array<unsigned char, sizeof(tls12_crypto_info_chacha20_poly1305)> m_bytes{};
+    socklen_t m_size{ 0 };
+
+    ~CryptoInfo() { OPENSSL_cleanse(m_bytes.data(), m_bytes.size()); }
+};
+
+template <typename Info>
+std::optional<CryptoInfo>
+DeriveCryptoInfo(uint16_t cipherType, const EVP_MD* md, std::span<const unsigned char> secret, uint64_t seq)
+{
+    static_assert(sizeof(Info) <= sizeof(CryptoInfo::m_bytes));
+
+    Info info{};
+    std::array<unsigned char, 12> iv{};
+    if (not ExpandLabel(md, secret, "key", info.key) or not ExpandLabel(md, secret, "iv", iv))
+    {
+        OPENSSL_cleanse(&info, sizeof(info));
+        return std::nullopt;
+    }
+
+    info.info.version = TLS_1_3_VERSION;
+    info.info.cipher_type = cipherType;
+    // the kernel splits the 12 byte nonce base into an implicit salt and the rest
+    static_assert(sizeof(info.salt) + sizeof(info.iv) == sizeof(iv));
+    std::memcpy(info.salt, iv.data(), sizeof(info.salt));
+    std::memcpy(info.iv, iv.data() + sizeof(info.salt), sizeof(info.iv));
+    for (size_t idx{ 0 }; idx < sizeof(info.rec_seq); idx++)
+    {
+        info.rec_seq[idx] = static_cast<unsigned char>(seq >> (8 * (sizeof(info.rec_seq) - 1 - idx)));
+    }
+
+    std::optional<CryptoInfo> out{ std::in_place };
+    std::memcpy(out->m_bytes.data(), &info, sizeof(info));
+    out->m_size = sizeof(info);
+    OPENSSL_cleanse(&info, sizeof(info));
+    OPENSSL_cleanse(iv.data(), iv.size());
+    return out;
+}
+
+std::optional<CryptoInfo>
+DeriveCryptoInfo(const SSL_CIPHER* cipher, std::span<const unsigned char> secret, uint64_t seq)
+{
+    const EVP_MD* md{ SSL_CIPHER_get_handshake_digest(cipher) };
+    if (not md)
+    {
+        return std::nullopt;
+    }
+
+    switch (SSL_CIPHER_get_id(cipher))
+    {
+        case TLS1_3_CK_AES_128_GCM_SHA256:
+            return DeriveCryptoInfo<tls12_crypto_info_aes_gcm_128>(TLS_CIPHER_AES_GCM_128, md, secret, seq);
+        case TLS1_3_CK_AES_256_GCM_SHA384:
+            return DeriveCryptoInfo<tls12_crypto_info_aes_gcm_256>(TLS_CIPHER_AES_GCM_256, md, secret, seq);
+        case TLS1_3_CK_CHACHA20_POLY1305_SHA256:
+            return DeriveCryptoInfo<tls12_crypto_info_chacha20_poly1305>(
+                TLS_CIPHER_CHACHA20_POLY1305, md, secret, seq
+            );
+        default:
+            return std::nullopt;
+    }
+}
+
+} // namespace
+
+KernelTls::KernelTls(ssl::context& ctx) :
+    m_ctx{ ctx.native_handle() }
+{
+    SSL_CTX_set_ex_data(m_ctx, CtxExDataIndex(), this);
+    SSL_CTX_set_keylog_callback(m_ctx, &KernelTls::KeylogCallback);
+    SSL_CTX_set_msg_callback(m_ctx, &KernelTls::MessageCallback);
+}
+
+KernelTls::~KernelTls()
+{
+    SSL_CTX_set_msg_callback(m_ctx, nullptr);
+    SSL_CTX_set_keylog_callback(m_ctx, nullptr);
+    SSL_CTX_set_ex_data(m_ctx, CtxExDataIndex(), nullptr);
+}
+
+KernelTls* KernelTls::Of(SSL* ssl) noexcept
+{
+    return static_cast<KernelTls*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), CtxExDataIndex()));
+}
+
+bool KernelTls::OffloadTransmit(SSL* ssl, int fd)
+{
+    auto& state{ StateOf(ssl) };
+    const SSL_CIPHER* cipher{ SSL_get_current_cipher(ssl) };
+    std::optional<CryptoInfo> info{};
+    if (SSL_version(ssl) == TLS1_3_VERSION and cipher and not state.m_secret.empty())
+    {
+        info = DeriveCryptoInfo(cipher, state.m_secret, state.m_records);
+    }
+    // never needed again, whether or not the offload works out
+    OPENSSL_cleanse(state.m_secret.data(), state.m_secret.size());
+    state.m_secret.clear();
+
+    if (not info)
+    {
+        m_unsuitable.fetch_add(1, std::memory_order::relaxed);
+        return false;
+    }
+
+    // without keys the ULP passes everything through, so a failed TLS_TX leaves a plain working socket behind
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0 or
+        setsockopt(fd, SOL_TLS, TLS_TX, info->m_bytes.data(), info->m_size) != 0)
+    {
+        if (m_unsupported.fetch_add(1, std::memory_order::relaxed) == 0)
+        {
+            LOG_WARNING("kernel TLS unavailable, staying in user space. {}", std::strerror(errno));
+        }
+        return false;
+    }
+
+    state.m_offloadedFd = fd;
+    m_offloaded.fetch_add(1, std::memory_order::relaxed);
+    return true;
+}
+
+void KernelTls::SendCloseNotify(int fd) noexcept
+{
+    // level warning, description close_notify
+    std::array<unsigned char, 2> alert{ 1, 0 };
+    std::array<char, CMSG_SPACE(sizeof(unsigned char))> control{};
+    iovec iov{ .iov_base = alert.data(), .iov_len = alert.size() };
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    // the record type of what follows, application data otherwise
+    cmsghdr* cmsg{ CMSG_FIRSTHDR(&msg) };
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+
+    [[maybe_unused]] auto sent{ ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) };
+}
+
+KernelTlsStats KernelTls::Stats() const noexcept
+{
+    return KernelTlsStats{
+        .m_offloaded = m_offloaded.load(std::memory_order::relaxed),
+        .m_unsupported = m_unsupported.load(std::memory_order::relaxed),
+        .m_unsuitable = m_unsuitable.load(std::memory_order::relaxed),
+        .m_abandoned = m_abandoned.load(std::memory_order::relaxed),
+    };
+}
+
+void KernelTls::KeylogCallback(const SSL* ssl, const char* line)
+{
+    // "SERVER_TRAFFIC_SECRET_0 <client random> <secret>", all hex
+    constexpr std::string_view LABEL{ "SERVER_TRAFFIC_SECRET_0 " };
+    const std::string_view entry{ line };
+    if (not SSL_is_server(ssl) or not entry.starts_with(LABEL))
+    {
+        return;
+    }
+
+    const auto hex{ entry.substr(entry.rfind(' ') + 1) };
+    auto& state{ StateOf(const_cast<SSL*>(ssl)) };
+    state.m_secret.resize(hex.size() / 2);
+    for (size_t idx{ 0 }; idx < state.m_secret.size(); idx++)
+    {
+        std::from_chars(hex.data() + 2 * idx, hex.data() + 2 * idx + 2, state.m_secret[idx], 16);
+    }
+}
+
+void KernelTls::MessageCallback(
+    int writeP,
+    [[maybe_unused]] int version,
+    int contentType,
+    const void* buf,
+    size_t len,
+    SSL* ssl,
+    [[maybe_unused]] void* arg
+)
+{
+    if (not SSL_is_server(ssl))
+    {
+        return;
+    }
+
+    auto& state{ StateOf(ssl) };
+    const auto* bytes{ static_cast<const unsigned char*>(buf) };
+    if (state.m_offloadedFd >= 0)
+    {
+        // KeyUpdate is the type, three bytes of length and request_update
+        const bool rekeyRequested{ not writeP and contentType == SSL3_RT_HANDSHAKE and len >= 5 and
+                                   bytes[0] == SSL3_MT_KEY_UPDATE and bytes[4] == SSL_KEY_UPDATE_REQUESTED };
+        // a record under OpenSSL's stale keys. the socket is shut before ssl::stream gets to flush it
+        const bool recordWritten{ writeP and contentType == SSL3_RT_HEADER };
+        if ((rekeyRequested or recordWritten) and not state.m_abandoned)
+        {
+            state.m_abandoned = true;
+            ::shutdown(state.m_offloadedFd, SHUT_RDWR);
+            if (auto* self{ Of(ssl) })
+            {
+                self->m_abandoned.fetch_add(1, std::memory_order::relaxed);
+            }
+            LOG_DEBUG("closing a kernel TLS connection. {}", rekeyRequested ? "KeyUpdate requested" : "late record");
+        }
+        return;
+    }
+
+    // only the server's own records move the sequence number the kernel has to continue from
+    if (not writeP)
+    {
+        return;
+    }
+
+    if (contentType == SSL3_RT_HEADER)
+    {
+        state.m_records += state.m_applicationKeys ? 1 : 0;
+    }
+    else if (contentType == SSL3_RT_HANDSHAKE and len > 0 and bytes[0] == SSL3_MT_FINISHED)
+    {
+        // reported once its record is out
+        state.m_applicationKeys = true;
+    }
+}
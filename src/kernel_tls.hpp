@@ -0,0 +1,72 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <atomic>
+#include <cstddef>
+
+struct KernelTlsStats
+{
+    size_t m_offloaded;
+    // the tls module isn't loaded, or the kernel predates kTLS
+    size_t m_unsupported;
+    // TLS 1.2, a cipher the kernel can't do or no traffic secret was seen
+    size_t m_unsuitable;
+    // offloaded, then closed because the client asked for a KeyUpdate or OpenSSL had something to send
+    size_t m_abandoned;
+};
+
+// Linux kernel TLS for the sending side of server connections of one ssl::context.
+// Once the TLS 1.3 handshake is done the server's application traffic key and record sequence number are handed to
+// the socket (TLS_TX). From then on plain writes to the socket go out as TLS records encrypted by the kernel, so
+// gather writes cost one syscall and no user space copy or crypto.
+//
+// Receiving stays with OpenSSL. ssl::stream reads ahead into its own buffer and may already hold records the client
+// sent right behind its Finished, which a kernel receive path (TLS_RX) would never see.
+// OpenSSL's own keys and sequence number for sending are stale from then on. A KeyUpdate from the client with
+// update_requested obliges the server to rekey and answer with its own (RFC 8446 4.6.3), and OpenSSL sends alerts
+// for what it can't read, neither of which can go out under the kernel's key. Either closes the connection instead.
+class KernelTls
+{
+public:
+    // Must outlive every connection made with ctx. Takes over ctx's keylog and message callbacks
+    explicit KernelTls(ssl::context& ctx);
+
+    ~KernelTls();
+
+    // nullptr when ssl's context has none installed
+    static KernelTls* Of(SSL* ssl) noexcept;
+
+    // Server side, right after the handshake and before anything else is written. On success everything sent must
+    // go to the socket directly, including the close_notify. On failure the connection carries on in user space
+    bool OffloadTransmit(SSL* ssl, int fd);
+
+    // Best effort close_notify for an offloaded connection
+    static void SendCloseNotify(int fd) noexcept;
+
+    KernelTlsStats Stats() const noexcept;
+
+private:
+    KernelTls(const KernelTls&) = delete;
+    KernelTls(KernelTls&&) = delete;
+    KernelTls& operator=(const KernelTls&) = delete;
+    KernelTls& operator=(KernelTls&&) = delete;
+
+    static void KeylogCallback(const SSL* ssl, const char* line);
+
+    static void MessageCallback(
+        int writeP,
+        int version,
+        int contentType,
+        const void* buf,
+        size_t len,
+        SSL* ssl,
+        void* arg
+    );
+
+    SSL_CTX* m_ctx;
+
+    std::atomic<size_t> m_offloaded{ 0 };
+    std::atomic<size_t> m_unsupported{ 0 };
+    std::atomic<size_t> m_unsuitable{ 0 };
+    std::atomic<size_t> m_abandoned{ 0 };
+};
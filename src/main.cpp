@@ -1,9 +1,15 @@
 #include "async_aliases.hpp"
 #include "channel_stuff.hpp"
+#include "dns_cache.hpp"
+#include "frame_arena.hpp"
+#include "http_batch.hpp"
 #include "http_stuff.hpp"
+#include "kernel_tls.hpp"
 #include "log/logger.hpp"
+#include "response_cache.hpp"
 #include "socket_stuff.hpp"
 #include "timeout_stuff.hpp"
+#include "tls_resumption.hpp"
 #include <csignal>
 #include <cstddef>
 #include <cstdlib>
@@ -12,16 +18,25 @@
 #include <filesystem>
 #include <format>
 #include <latch>
+#include <memory>
+#include <optional>
 #include <pthread.h>
 #include <source_location>
+#include <span>
 #include <stop_token>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 using namespace std::chrono_literals;
 
-asio::awaitable<void> async_main(ssl::context& sslCtx)
+asio::awaitable<void> async_main(
+    ssl::context& sslCtx,
+    TlsResumption& resumption,
+    ServerConfig cfg,
+    std::vector<asio::any_io_executor> workerExecutors
+)
 {
     auto ctx{ co_await asio::this_coro::executor };
     try
@@ -29,10 +44,18 @@ asio::awaitable<void> async_main(ssl::context& sslCtx)
         LOG_INFO("running async main");
 
         asio::steady_timer tm{ ctx };
-        asio::co_spawn(ctx, accept_client(sslCtx), asio::detached);
-        asio::co_spawn(ctx, read_http("dummyjson.com", "/ip", sslCtx), asio::detached);
+        asio::co_spawn(ctx, accept_client(sslCtx, std::move(cfg), std::move(workerExecutors)), asio::detached);
+        auto dns{ std::make_shared<DnsCache>() };
+        auto pool{ std::make_shared<HttpsPool>(sslCtx, dns, HttpsPoolConfig{ .m_http2 = true }) };
+        auto batch{ std::make_shared<HttpBatch>(std::move(pool), std::make_shared<ResponseCache>(), ctx) };
+        std::vector<FetchRequest> endpoints{
+            { .m_host = "dummyjson.com", .m_target = "/ip" },
+            { .m_host = "dummyjson.com", .m_target = "/test" },
+        };
+        asio::co_spawn(ctx, read_http(std::move(endpoints), std::move(batch), 10s), asio::detached);
         asio::co_spawn(ctx, something_that_timesout(), asio::detached);
         asio::co_spawn(ctx, start_channel_work(), asio::detached);
+        asio::co_spawn(ctx, rotate_ticket_keys(resumption, 1h), asio::detached);
 
         while (true)
         {
@@ -52,7 +75,7 @@ asio::awaitable<void> async_main(ssl::context& sslCtx)
     co_return;
 }
 
-int main()
+int main(int argc, char** argv)
 {
     namespace fs = std::filesystem;
     constexpr auto main_cpp{ std::source_location::current() };
@@ -72,6 +95,7 @@ int main()
         sslCtx.use_certificate_file(certsDir / "example.com.crt", ssl::context::file_format::pem);
         sslCtx.use_private_key_file(certsDir / "example.com.key", ssl::context::file_format::pem);
         sslCtx.set_verify_mode(ssl::verify_peer);
+        TlsResumption resumption{ sslCtx };
 
         // hook signals
         asio::signal_set signals{ ctx };
@@ -87,7 +111,33 @@ int main()
             }
         );
 
-        asio::co_spawn(ctx, async_main(sslCtx), asio::detached);
+        // one registry shard per worker by default so fan-out scales with the thread count
+        ServerConfig cfg{ parse_server_config(std::span{ argv, static_cast<size_t>(argc) }) };
+        if (cfg.m_shards == 0)
+        {
+            cfg.m_shards = nWorkers;
+        }
+
+        // only the server's connections are offloaded, the http client shares the context but stays in user space
+        std::optional<KernelTls> kernelTls{};
+        if (cfg.m_kernelTls)
+        {
+            kernelTls.emplace(sslCtx);
+        }
+
+        // with --reuseport each worker runs its own context, and listener, instead of sharing ctx
+        std::vector<std::unique_ptr<asio::io_context>> workerCtxs{};
+        std::vector<asio::any_io_executor> workerExecutors{};
+        if (cfg.m_reusePort)
+        {
+            for (size_t idx{ 0 }; idx < nWorkers; idx++)
+            {
+                workerCtxs.push_back(std::make_unique<asio::io_context>(1));
+                workerExecutors.push_back(workerCtxs.back()->get_executor());
+            }
+        }
+
+        asio::co_spawn(ctx, async_main(sslCtx, resumption, std::move(cfg), std::move(workerExecutors)), asio::detached);
 
         sigset_t signalsToBlock{};
         sigfillset(&signalsToBlock);
@@ -96,15 +146,17 @@ int main()
         for (size_t idx{ 1 }; auto& worker : workers)
         {
             worker = std::jthread(
-                [&startLatch, &ctx]([[maybe_unused]] std::stop_token token)
+                [&startLatch, &ctx, &runCtx = workerCtxs.empty() ? ctx : *workerCtxs[idx - 1]](
+                    [[maybe_unused]] std::stop_token token
+                )
                 {
                     startLatch.arrive_and_wait();
-                    auto guard{ asio::make_work_guard(ctx) };
+                    auto guard{ asio::make_work_guard(runCtx) };
 
                     try
                     {
                         LOG_INFO("starting");
-                        ctx.run();
+                        runCtx.run();
                         LOG_INFO("stopping");
                     }
                     catch (const std::exception& e)
@@ -138,6 +190,11 @@ int main()
             }
         }
 
+        for (auto& workerCtx : workerCtxs)
+        {
+            workerCtx->stop();
+        }
+
         for (auto& worker : workers)
         {
             if (worker.joinable())
@@ -147,6 +204,33 @@ int main()
             }
         }
 
+        if (kernelTls)
+        {
+            const auto stats{ kernelTls->Stats() };
+            LOG_INFO(
+                "kernel TLS offloaded {} connections, {} closed for a KeyUpdate or late record. {} without kernel "
+                "support, {} unsuitable",
+                stats.m_offloaded,
+                stats.m_abandoned,
+                stats.m_unsupported,
+                stats.m_unsuitable
+            );
+        }
+
+#ifdef CPP_CORO_FRAME_ARENA
+        const auto arenaStats{ FrameArena::Stats() };
+        LOG_INFO(
+            "arenas served {} allocations, {:.1f}% from free lists, with {} mallocs. {} blocks ({} bytes) live, "
+            "{} bytes of slabs",
+            arenaStats.m_allocations,
+            arenaStats.HitRate() * 100.0,
+            arenaStats.m_mallocs,
+            arenaStats.m_liveBlocks,
+            arenaStats.m_liveBytes,
+            arenaStats.m_slabBytes
+        );
+#endif
+
         return 0;
     }
     catch (const boost::system::system_error& e)
@@ -0,0 +1,94 @@
+#include "mpmc_channel.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+asio::awaitable<void> ChannelWaiters::Wait(const std::function<bool()>& ready)
+{
+    auto waiter{ std::make_shared<Waiter>(std::make_shared<asio::steady_timer>(
+        co_await asio::this_coro::executor, asio::steady_timer::time_point::max()
+    )) };
+    {
+        std::lock_guard lk{ m_mutex };
+        m_waiters.push_back(waiter);
+        m_nWaiting.store(m_waiters.size(), std::memory_order::relaxed);
+    }
+
+    // Pairs with the fence in WakeOne: either the other side sees this waiter, or this sees what the other side did
+    // before looking
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+    if (ready())
+    {
+        if (Leave(waiter))
+        {
+            WakeOne();
+        }
+        co_return;
+    }
+
+    // cancelled by WakeOne() or by cancelling the caller
+    boost::system::error_code ec;
+    co_await waiter->m_wake->async_wait(asio::redirect_error(ec));
+
+    const bool woken{ Leave(waiter) };
+    if ((co_await asio::this_coro::cancellation_state).cancelled() != asio::cancellation_type::none)
+    {
+        if (woken)
+        {
+            WakeOne();
+        }
+        throw boost::system::system_error{ asio::error::operation_aborted };
+    }
+}
+
+void ChannelWaiters::WakeOne()
+{
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+    if (m_nWaiting.load(std::memory_order::relaxed) == 0)
+    {
+        return;
+    }
+
+    std::shared_ptr<Waiter> next{};
+    {
+        std::lock_guard lk{ m_mutex };
+        auto it{ std::ranges::find_if(m_waiters, [](const auto& waiter) { return not waiter->m_woken; }) };
+        if (it == m_waiters.end())
+        {
+            return;
+        }
+        next = *it;
+        next->m_woken = true;
+    }
+
+    asio::post(next->m_wake->get_executor(), [wake{ next->m_wake }] { wake->cancel(); });
+}
+
+void ChannelWaiters::WakeAll()
+{
+    std::vector<std::shared_ptr<asio::steady_timer>> wakes{};
+    {
+        std::lock_guard lk{ m_mutex };
+        for (auto& waiter : m_waiters)
+        {
+            if (not waiter->m_woken)
+            {
+                waiter->m_woken = true;
+                wakes.push_back(waiter->m_wake);
+            }
+        }
+    }
+
+    for (auto& wake : wakes)
+    {
+        asio::post(wake->get_executor(), [wake] { wake->cancel(); });
+    }
+}
+
+bool ChannelWaiters::Leave(const std::shared_ptr<Waiter>& waiter)
+{
+    std::lock_guard lk{ m_mutex };
+    m_waiters.erase(std::ranges::find(m_waiters, waiter));
+    m_nWaiting.store(m_waiters.size(), std::memory_order::relaxed);
+    return waiter->m_woken;
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <boost/asio/experimental/channel_error.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// The coroutines parked on one side of an MpmcChannel, waiting for room or for values.
+// Only touched when the ring is full or empty: waking costs a fence and a load while nobody is parked.
+class ChannelWaiters
+{
+public:
+    // Parks until woken, unless ready() holds once parked. Throws operation_aborted when the caller is cancelled.
+    // Must be running on a strand, the wakeup is posted to it
+    asio::awaitable<void> Wait(const std::function<bool()>& ready);
+
+    // after every change that may let a parked coroutine through
+    void WakeOne();
+
+    void WakeAll();
+
+private:
+    struct Waiter
+    {
+        std::shared_ptr<asio::steady_timer> m_wake;
+        bool m_woken{ false };
+    };
+
+    // whether the waiter was woken. Whoever doesn't use a wake passes it on, or it's lost
+    bool Leave(const std::shared_ptr<Waiter>& waiter);
+
+    std::mutex m_mutex{};
+    std::deque<std::shared_ptr<Waiter>> m_waiters{};
+    std::atomic<size_t> m_nWaiting{ 0 };
+};
+
+// A bounded channel for producers and consumers on any threads.
+// Values go through a lock-free ring (Vyukov's bounded MPMC queue), so a send or receive that finds room or a value
+// takes no lock and doesn't suspend. Only a sender facing a full ring or a receiver facing an empty one parks, on its
+// own executor, until the other side makes progress.
+// Named like asio's channels so it can stand in for Channel<T> (send_or_wait, receive_batch). Like theirs, every
+// value comes with an error code that async_receive throws. close() fails senders right away and receivers once the
+// ring is drained, with channel_closed.
+template<typename T> class MpmcChannel
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>, "a value is moved into a slot that's already claimed");
+
+public:
+    // capacity is rounded up to a power of two
+    explicit MpmcChannel(size_t capacity) :
+        m_mask{ std::bit_ceil(std::max<size_t>(capacity, 2)) - 1 },
+        m_cells{ std::make_unique<Cell[]>(m_mask + 1) }
+    {
+        for (size_t idx{ 0 }; idx <= m_mask; idx++)
+        {
+            m_cells[idx].m_seq.store(idx, std::memory_order::relaxed);
+        }
+    }
+
+    ~MpmcChannel()
+    {
+        while (TryPop())
+        {
+        }
+    }
+
+    MpmcChannel(const MpmcChannel&) = delete;
+    MpmcChannel& operator=(const MpmcChannel&) = delete;
+
+    size_t capacity() const noexcept { return m_mask + 1; }
+
+    bool is_open() const noexcept { return not m_closed.load(std::memory_order::acquire); }
+
+    void close()
+    {
+        m_closed.store(true, std::memory_order::seq_cst);
+        m_senders.WakeAll();
+        m_receivers.WakeAll();
+    }
+
+    // false when the ring is full or the channel closed, in which case value is left alone
+    template<typename U> bool try_send(boost::system::error_code ec, U&& value)
+    {
+        if (not is_open() or not TryPush(ec, std::forward<U>(value)))
+        {
+            return false;
+        }
+        m_receivers.WakeOne();
+        return true;
+    }
+
+    template<typename U> asio::awaitable<void> async_send(boost::system::error_code ec, U value)
+    {
+        while (true)
+        {
+            if (not is_open())
+            {
+                throw boost::system::system_error{ asio::experimental::error::channel_closed };
+            }
+            if (try_send(ec, std::move(value)))
+            {
+                co_return;
+            }
+            co_await m_senders.Wait([this] { return CanPush() or not is_open(); });
+        }
+    }
+
+    // Calls handler(error_code, T) with the next value, if there is one
+    template<typename Handler> bool try_receive(Handler&& handler)
+    {
+        auto slot{ TryPop() };
+        if (not slot)
+        {
+            return false;
+        }
+        m_senders.WakeOne();
+        std::forward<Handler>(handler)(slot->first, std::move(slot->second));
+        return true;
+    }
+
+    asio::awaitable<T> async_receive()
+    {
+        while (true)
+        {
+            if (auto slot{ TryPop() })
+            {
+                m_senders.WakeOne();
+                if (slot->first)
+                {
+                    throw boost::system::system_error{ slot->first };
+                }
+                co_return std::move(slot->second);
+            }
+            if (not is_open() and not CanPop())
+            {
+                throw boost::system::system_error{ asio::experimental::error::channel_closed };
+            }
+            co_await m_receivers.Wait([this] { return CanPop() or not is_open(); });
+        }
+    }
+
+private:
+    // m_seq says what the cell is waiting for: equal to the position of the next push that lands on it while free,
+    // one past the position of its value while full
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> m_seq{ 0 };
+        boost::system::error_code m_ec{};
+        alignas(T) std::byte m_value[sizeof(T)];
+    };
+
+    template<typename U> bool TryPush(boost::system::error_code ec, U&& value)
+    {
+        size_t pos{ m_pushPos.load(std::memory_order::relaxed) };
+        Cell* cell{ nullptr };
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq{ cell->m_seq.load(std::memory_order::acquire) };
+            const auto diff{ static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) };
+            if (diff == 0)
+            {
+                if (m_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order::relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_pushPos.load(std::memory_order::relaxed);
+            }
+        }
+
+        cell->m_ec = ec;
+        new (cell->m_value) T(std::forward<U>(value));
+        cell->m_seq.store(pos + 1, std::memory_order::release);
+        return true;
+    }
+
+    std::optional<std::pair<boost::system::error_code, T>> TryPop()
+    {
+        size_t pos{ m_popPos.load(std::memory_order::relaxed) };
+        Cell* cell{ nullptr };
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq{ cell->m_seq.load(std::memory_order::acquire) };
+            const auto diff{ static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) };
+            if (diff == 0)
+            {
+                if (m_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order::relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return std::nullopt;
+            }
+            else
+            {
+                pos = m_popPos.load(std::memory_order::relaxed);
+            }
+        }
+
+        auto* value{ std::launder(reinterpret_cast<T*>(cell->m_value)) };
+        std::optional<std::pair<boost::system::error_code, T>> out{ std::in_place, cell->m_ec, std::move(*value) };
+        value->~T();
+        cell->m_seq.store(pos + m_mask + 1, std::memory_order::release);
+        return out;
+    }
+
+    // whether a push or pop might succeed now. Good enough to decide against parking
+    bool CanPush() const noexcept
+    {
+        const size_t pos{ m_pushPos.load(std::memory_order::relaxed) };
+        return m_cells[pos & m_mask].m_seq.load(std::memory_order::acquire) >= pos;
+    }
+
+    bool CanPop() const noexcept
+    {
+        const size_t pos{ m_popPos.load(std::memory_order::relaxed) };
+        return m_cells[pos & m_mask].m_seq.load(std::memory_order::acquire) >= pos + 1;
+    }
+
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_pushPos{ 0 };
+    alignas(64) std::atomic<size_t> m_popPos{ 0 };
+    alignas(64) std::atomic<bool> m_closed{ false };
+
+    ChannelWaiters m_senders{};
+    ChannelWaiters m_receivers{};
+};
@@ -0,0 +1,248 @@
+#include "response_cache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace
+{
+
+struct CacheControl
+{
+    bool m_noStore{ false };
+    bool m_noCache{ false };
+    std::optional<std::chrono::seconds> m_maxAge{};
+};
+
+bool equals_ignore_case(std::string_view lhs, std::string_view rhs) noexcept
+{
+    return std::ranges::equal(
+        lhs, rhs, [](char l, char r) { return std::tolower(static_cast<unsigned char>(l)) == r; }
+    );
+}
+
+std::string_view trim(std::string_view value) noexcept
+{
+    const auto first{ value.find_first_not_of(" \t") };
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    return value.substr(first, value.find_last_not_of(" \t") - first + 1);
+}
+
+std::optional<int64_t> parse_seconds(std::string_view value) noexcept
+{
+    value = trim(value);
+    if (value.size() >= 2 and value.front() == '"' and value.back() == '"')
+    {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    int64_t seconds{ 0 };
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+    if (ec != std::errc{} or end != value.data() + value.size() or seconds < 0)
+    {
+        return std::nullopt;
+    }
+    return seconds;
+}
+
+CacheControl parse_cache_control(std::string_view value)
+{
+    CacheControl out{};
+    while (not value.empty())
+    {
+        const auto comma{ value.find(',') };
+        const auto directive{ trim(value.substr(0, comma)) };
+        value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+
+        const auto equals{ directive.find('=') };
+        const auto name{ trim(directive.substr(0, equals)) };
+        if (equals_ignore_case(name, "no-store"))
+        {
+            out.m_noStore = true;
+        }
+        else if (equals_ignore_case(name, "no-cache"))
+        {
+            out.m_noCache = true;
+        }
+        else if (equals_ignore_case(name, "max-age") and equals != std::string_view::npos)
+        {
+            if (auto seconds{ parse_seconds(directive.substr(equals + 1)) })
+            {
+                out.m_maxAge = std::chrono::seconds{ *seconds };
+            }
+        }
+    }
+    return out;
+}
+
+// how long after its arrival a response may be served without asking the server. Age is what it spent in caches on
+// the way
+std::chrono::seconds freshness(const HttpsPool::ResponseHeader& header, const CacheControl& cacheControl)
+{
+    if (cacheControl.m_noCache or not cacheControl.m_maxAge)
+    {
+        return std::chrono::seconds{ 0 };
+    }
+
+    const auto age{ parse_seconds(header[beast::http::field::age]).value_or(0) };
+    return std::max(*cacheControl.m_maxAge - std::chrono::seconds{ age }, std::chrono::seconds{ 0 });
+}
+
+size_t entry_bytes(const HttpsPool::Response& res)
+{
+    size_t nBytes{ res.body().size() };
+    for (const auto& field : res.base())
+    {
+        nBytes += field.name_string().size() + field.value().size();
+    }
+    return nBytes;
+}
+
+std::string cache_key(const std::string& host, const ResponseCache::Request& req)
+{
+    const std::string_view target{ req.target() };
+    return host + std::string{ target };
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(ResponseCacheConfig cfg) :
+    m_cfg{ cfg }
+{
+}
+
+std::optional<ResponseCache::Response> ResponseCache::Prepare(const std::string& host, Request& req)
+{
+    if (req.method() != beast::http::verb::get)
+    {
+        return std::nullopt;
+    }
+
+    const auto key{ cache_key(host, req) };
+    std::lock_guard lk{ m_mutex };
+    auto it{ m_index.find(key) };
+    if (it == m_index.end())
+    {
+        return std::nullopt;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    const auto& entry{ *it->second };
+    if (std::chrono::steady_clock::now() < entry.m_freshUntil)
+    {
+        m_fresh++;
+        return entry.m_response;
+    }
+
+    if (auto etag{ entry.m_response[beast::http::field::etag] }; not etag.empty())
+    {
+        req.set(beast::http::field::if_none_match, etag);
+    }
+    if (auto lastModified{ entry.m_response[beast::http::field::last_modified] }; not lastModified.empty())
+    {
+        req.set(beast::http::field::if_modified_since, lastModified);
+    }
+    return std::nullopt;
+}
+
+ResponseCache::Response ResponseCache::Complete(const std::string& host, const Request& req, Response res)
+{
+    if (req.method() != beast::http::verb::get)
+    {
+        return res;
+    }
+
+    const auto key{ cache_key(host, req) };
+    const auto now{ std::chrono::steady_clock::now() };
+    std::lock_guard lk{ m_mutex };
+    auto it{ m_index.find(key) };
+
+    if (res.result() == beast::http::status::not_modified and it != m_index.end())
+    {
+        // the 304's fields replace the stored ones, except those describing a body it doesn't have
+        auto& entry{ *it->second };
+        for (const auto& update : res.base())
+        {
+            using beast::http::field;
+            if (update.name() == field::content_length or update.name() == field::transfer_encoding or
+                update.name() == field::content_encoding)
+            {
+                continue;
+            }
+            entry.m_response.set(update.name_string(), update.value());
+        }
+
+        const auto cacheControl{ parse_cache_control(entry.m_response[beast::http::field::cache_control]) };
+        entry.m_freshUntil = now + freshness(entry.m_response.base(), cacheControl);
+        m_bytes -= entry.m_bytes;
+        entry.m_bytes = entry_bytes(entry.m_response);
+        m_bytes += entry.m_bytes;
+        m_notModified++;
+
+        Response stored{ entry.m_response };
+        Evict();
+        return stored;
+    }
+
+    m_misses++;
+    // anything but a new body leaves the stored one alone
+    if (res.result() != beast::http::status::ok)
+    {
+        return res;
+    }
+
+    if (it != m_index.end())
+    {
+        Erase(it->second);
+    }
+
+    const auto cacheControl{ parse_cache_control(res[beast::http::field::cache_control]) };
+    const auto fresh{ freshness(res.base(), cacheControl) };
+    const bool validated{ res.count(beast::http::field::etag) > 0 or
+                          res.count(beast::http::field::last_modified) > 0 };
+    const size_t nBytes{ entry_bytes(res) };
+    if (cacheControl.m_noStore or (fresh.count() == 0 and not validated) or nBytes > m_cfg.m_maxBytes)
+    {
+        return res;
+    }
+
+    m_lru.push_front(Entry{ .m_key = key, .m_response = res, .m_freshUntil = now + fresh, .m_bytes = nBytes });
+    m_index[key] = m_lru.begin();
+    m_bytes += nBytes;
+    Evict();
+    return res;
+}
+
+ResponseCacheStats ResponseCache::Stats() const
+{
+    std::lock_guard lk{ m_mutex };
+    return ResponseCacheStats{
+        .m_fresh = m_fresh,
+        .m_notModified = m_notModified,
+        .m_misses = m_misses,
+        .m_evictions = m_evictions,
+        .m_entries = m_lru.size(),
+        .m_bytes = m_bytes,
+    };
+}
+
+void ResponseCache::Erase(EntryList::iterator it)
+{
+    m_bytes -= it->m_bytes;
+    m_index.erase(it->m_key);
+    m_lru.erase(it);
+}
+
+void ResponseCache::Evict()
+{
+    while (not m_lru.empty() and (m_lru.size() > m_cfg.m_maxEntries or m_bytes > m_cfg.m_maxBytes))
+    {
+        Erase(std::prev(m_lru.end()));
+        m_evictions++;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include "https_pool.hpp"
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+struct ResponseCacheConfig
+{
+    size_t m_maxEntries{ 1024 };
+    // bodies and header fields of every entry together
+    size_t m_maxBytes{ 64 * 1024 * 1024 };
+};
+
+struct ResponseCacheStats
+{
+    // answered from the cache without asking the server
+    size_t m_fresh;
+    // answered from the cache after the server replied 304
+    size_t m_notModified;
+    // went over the network for a body
+    size_t m_misses;
+    size_t m_evictions;
+    size_t m_entries;
+    size_t m_bytes;
+};
+
+// The last 200 response to each GET of a host and target, for requests that are repeated (RFC 9111, as a private
+// cache). Within its Cache-Control max-age a response is served as is. After that the request asks the server with
+// If-None-Match and If-Modified-Since from the stored ETag and Last-Modified, and a 304 serves the stored body again.
+// Responses with neither validators nor a max-age, or with no-store, aren't kept. Least recently used entries go
+// first once a limit is reached. Safe to use from any thread
+class ResponseCache
+{
+public:
+    using Request = HttpsPool::Request;
+    using Response = HttpsPool::Response;
+
+    explicit ResponseCache(ResponseCacheConfig cfg = {});
+
+    // The stored response to req while it's fresh, so req needn't be sent. Otherwise req gets the validators of a
+    // stale one, if any
+    std::optional<Response> Prepare(const std::string& host, Request& req);
+
+    // What to hand out for res, the answer to req after Prepare: the stored response for a 304, otherwise res, which
+    // is stored if it can be
+    Response Complete(const std::string& host, const Request& req, Response res);
+
+    ResponseCacheStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::string m_key;
+        Response m_response;
+        std::chrono::steady_clock::time_point m_freshUntil;
+        size_t m_bytes;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void Erase(EntryList::iterator it);
+
+    // drops the least recently used entries until the limits hold
+    void Evict();
+
+    const ResponseCacheConfig m_cfg;
+
+    mutable std::mutex m_mutex{};
+    // most recently used first
+    EntryList m_lru{};
+    // "host/target"
+    std::unordered_map<std::string, EntryList::iterator> m_index{};
+    size_t m_bytes{ 0 };
+
+    size_t m_fresh{ 0 };
+    size_t m_notModified{ 0 };
+    size_t m_misses{ 0 };
+    size_t m_evictions{ 0 };
+};
@@ -0,0 +1,101 @@
+#include "server_config.hpp"
+#include "utils.hpp"
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+constexpr std::array<std::pair<SlowConsumerPolicy, std::string_view>, 4> POLICY_NAMES{ {
+    { SlowConsumerPolicy::DropOldest, "drop-oldest" },
+    { SlowConsumerPolicy::DropNewest, "drop-newest" },
+    { SlowConsumerPolicy::Disconnect, "disconnect" },
+    { SlowConsumerPolicy::PauseProducers, "pause-producers" },
+} };
+
+constexpr std::array<std::pair<FramingMode, std::string_view>, 2> FRAMING_NAMES{ {
+    { FramingMode::Newline, "newline" },
+    { FramingMode::LengthPrefixed, "length-prefixed" },
+} };
+
+} // namespace
+
+std::string_view to_string(SlowConsumerPolicy policy) noexcept
+{
+    for (const auto& [value, name] : POLICY_NAMES)
+    {
+        if (value == policy)
+        {
+            return name;
+        }
+    }
+
+    return "unknown";
+}
+
+SlowConsumerPolicy parse_slow_consumer_policy(std::string_view name)
+{
+    for (const auto& [value, policyName] : POLICY_NAMES)
+    {
+        if (policyName == name)
+        {
+            return value;
+        }
+    }
+
+    throw std::invalid_argument("unknown slow consumer policy '" + std::string{ name } + "'");
+}
+
+std::string_view to_string(FramingMode mode) noexcept
+{
+    for (const auto& [value, name] : FRAMING_NAMES)
+    {
+        if (value == mode)
+        {
+            return name;
+        }
+    }
+
+    return "unknown";
+}
+
+FramingMode parse_framing_mode(std::string_view name)
+{
+    for (const auto& [value, modeName] : FRAMING_NAMES)
+    {
+        if (modeName == name)
+        {
+            return value;
+        }
+    }
+
+    throw std::invalid_argument("unknown framing mode '" + std::string{ name } + "'");
+}
+
+ServerConfig parse_server_config(std::span<char* const> args)
+{
+    ServerConfig cfg{};
+    cfg.m_listenHost = arg_or(args, "host", cfg.m_listenHost);
+    cfg.m_listenPort = arg_or(args, "port", cfg.m_listenPort);
+    cfg.m_shards = arg_or(args, "shards", cfg.m_shards);
+    cfg.m_reusePort = arg_or(args, "reuseport", cfg.m_reusePort);
+    cfg.m_outbound.m_maxBytes = arg_or(args, "outbound-max-bytes", cfg.m_outbound.m_maxBytes);
+    cfg.m_outbound.m_maxMessages = arg_or(args, "outbound-max-messages", cfg.m_outbound.m_maxMessages);
+    if (auto policy{ find_arg(args, "slow-consumer") })
+    {
+        cfg.m_outbound.m_policy = parse_slow_consumer_policy(*policy);
+    }
+    cfg.m_outbound.m_writeTimeout =
+        std::chrono::seconds{ arg_or(args, "write-timeout", cfg.m_outbound.m_writeTimeout.count()) };
+    if (auto mode{ find_arg(args, "framing") })
+    {
+        cfg.m_framing.m_mode = parse_framing_mode(*mode);
+    }
+    cfg.m_framing.m_maxFrameBytes = arg_or(args, "max-frame-bytes", cfg.m_framing.m_maxFrameBytes);
+    cfg.m_idleTimeout = std::chrono::seconds{ arg_or(args, "idle-timeout", cfg.m_idleTimeout.count()) };
+    cfg.m_releaseTlsBuffers = arg_or(args, "release-tls-buffers", cfg.m_releaseTlsBuffers);
+    cfg.m_kernelTls = arg_or(args, "ktls", cfg.m_kernelTls);
+
+    return cfg;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+enum class SlowConsumerPolicy
+{
+    // evict the oldest queued messages to make room
+    DropOldest,
+    // refuse the message that doesn't fit
+    DropNewest,
+    // close the consumer that can't keep up
+    Disconnect,
+    // queue it anyway and hold off reading from producers until the consumer catches up
+    PauseProducers,
+};
+
+std::string_view to_string(SlowConsumerPolicy policy) noexcept;
+
+SlowConsumerPolicy parse_slow_consumer_policy(std::string_view name);
+
+enum class FramingMode
+{
+    // one message per '\n' terminated line. a trailing '\r' is not part of the message
+    Newline,
+    // 4 byte big endian payload length followed by the payload
+    LengthPrefixed,
+};
+
+std::string_view to_string(FramingMode mode) noexcept;
+
+FramingMode parse_framing_mode(std::string_view name);
+
+// How the byte stream from a client is split into messages
+struct FramingConfig
+{
+    FramingMode m_mode{ FramingMode::Newline };
+    // a longer message closes the connection
+    size_t m_maxFrameBytes{ 64 * 1024 };
+};
+
+// Per connection budget for messages waiting to be written
+struct OutboundLimits
+{
+    size_t m_maxBytes{ 1024 * 1024 };
+    size_t m_maxMessages{ 4096 };
+    SlowConsumerPolicy m_policy{ SlowConsumerPolicy::DropOldest };
+    // a client that takes none of a write for this long has stopped reading, and is disconnected
+    std::chrono::seconds m_writeTimeout{ 30 };
+};
+
+struct ServerConfig
+{
+    std::string m_listenHost{ "localhost" };
+    std::string m_listenPort{ "8080" };
+    // client registry shards. 0 picks one per hardware thread
+    size_t m_shards{ 0 };
+    // one SO_REUSEPORT listener per worker context instead of a single shared acceptor
+    bool m_reusePort{ false };
+    OutboundLimits m_outbound{};
+    FramingConfig m_framing{};
+    // a client that sends nothing for this long is disconnected
+    std::chrono::seconds m_idleTimeout{ 60 };
+    // SSL_MODE_RELEASE_BUFFERS. less memory per idle connection for an allocation per record on busy ones
+    bool m_releaseTlsBuffers{ false };
+    // hand record encryption of what is sent to the kernel (kTLS) after the handshake, where it's available
+    bool m_kernelTls{ false };
+};
+
+// --host= --port= --shards= --reuseport --outbound-max-bytes= --outbound-max-messages=
+// --slow-consumer=drop-oldest|drop-newest|disconnect|pause-producers --framing=newline|length-prefixed
+// --max-frame-bytes= --idle-timeout=<seconds> --write-timeout=<seconds> --release-tls-buffers --ktls
+ServerConfig parse_server_config(std::span<char* const> args);
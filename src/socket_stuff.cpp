@@ -1,100 +1,349 @@
 #include "socket_stuff.hpp"
+#include "buffer_pool.hpp"
+#include "chat_protocol.hpp"
+#include "client_registry.hpp"
+#include "client_session.hpp"
+#include "deadline.hpp"
+#include "flow_gate.hpp"
+#include "frame_parser.hpp"
+#include "idle_wheel.hpp"
+#include "kernel_tls.hpp"
 #include "log/logger.hpp"
+#include "tls_resumption.hpp"
 #include "utils.hpp"
-#include <map>
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 using namespace boost::asio::experimental::awaitable_operators;
 
-using ClientsMap = std::map<std::string, ssl::stream<asio::ip::tcp::socket>>;
-using SharedClientsMap = std::shared_ptr<ClientsMap>;
+// idle timeouts are only as precise as this
+constexpr std::chrono::steady_clock::duration IDLE_TICK{ 1s };
+// reads land here while the parser holds no unfinished frame, so idle connections don't pin a pooled buffer
+constexpr size_t IDLE_READ_BYTES{ 256 };
 
-asio::awaitable<void> handle_connection(std::string tag, SharedClientsMap clients)
+// the only copy of a relayed frame is made here. every recipient shares it and gets the frame exactly as it was sent
+void dispatch_frame(const Frame& frame, ClientRegistry& registry, ConnectionId id, const std::string& tag)
 {
-    struct ClientDropper
+    const auto command{ parse_command(frame.m_payload) };
+    switch (command.m_kind)
     {
-        const std::string& m_tag;
-        ClientsMap& m_clients;
-
-        ~ClientDropper() { m_clients.erase(m_tag); }
-    } dropper{ .m_tag = tag, .m_clients = *clients };
-
-    auto& socket{ clients->at(tag) };
-    auto shake_res = co_await (
-        socket.async_handshake(ssl::stream_base::handshake_type::server, asio::use_awaitable) or timeout(10s)
-    );
-    if (shake_res.index() == 1)
-    {
-        LOG_INFO("handshake timed out for {}", tag);
-        co_await (socket.async_shutdown(asio::use_awaitable) or timeout(100ms));
-        co_return;
+        case CommandKind::Message:
+            LOG_INFO("client {}: says: '{}'. sending it all other clients", tag, frame.m_payload);
+            registry.Broadcast(make_broadcast_message(frame.m_wire), id);
+            break;
+        case CommandKind::Subscribe:
+            LOG_INFO("client {}: subscribes to '{}'", tag, command.m_topic);
+            registry.Subscribe(id, std::string{ command.m_topic });
+            break;
+        case CommandKind::Unsubscribe:
+            LOG_INFO("client {}: unsubscribes from '{}'", tag, command.m_topic);
+            registry.Unsubscribe(id, std::string{ command.m_topic });
+            break;
+        case CommandKind::Publish:
+            LOG_INFO("client {}: publishes '{}' to '{}'", tag, command.m_body, command.m_topic);
+            registry.Publish(std::string{ command.m_topic }, make_broadcast_message(frame.m_wire), id);
+            break;
+        case CommandKind::Invalid:
+            LOG_INFO("client {}: ignoring malformed command '{}'", tag, frame.m_payload);
+            break;
     }
+}
+
+asio::awaitable<void> read_loop(
+    std::shared_ptr<ClientSession> session,
+    ConnectionId id,
+    std::shared_ptr<ClientRegistry> registry,
+    std::shared_ptr<FlowGate> gate,
+    FramingConfig framing,
+    std::shared_ptr<IdleWatch> idle
+)
+{
+    const auto& tag{ session->Tag() };
+    auto& socket{ session->GetStream() };
 
-    std::array<char, 1024> data{};
+    FrameParser parser{ framing };
+    std::array<char, IDLE_READ_BYTES> idleBuffer;
+    // the parser's buffer goes back to the pool with it
+    AtScopeExit heldReset{ [&session] { session->NoteReadBytesHeld(0); } };
     while (true)
     {
-        data.fill(0);
-        auto res = co_await (socket.async_read_some(asio::buffer(data), asio::use_awaitable) or timeout(1min));
-        if (res.index() == 1)
+        // someone in the room can't keep up. stop feeding them until they drain
+        if (gate and not gate->IsOpen())
+        {
+            // not reading on purpose doesn't count as idle
+            idle->Hold();
+            while (not gate->IsOpen())
+            {
+                co_await gate->WaitOpen();
+            }
+            idle->Touch();
+        }
+
+        // a connection in the middle of a frame, or with decrypted bytes waiting, reads straight into the parser's
+        // buffer. anything else gives the buffer back and waits on the small one
+        const bool idleRead{ parser.Pending() == 0 and SSL_pending(socket.native_handle()) == 0 };
+        if (idleRead)
+        {
+            parser.Release();
+            session->NoteReadBytesHeld(0);
+        }
+        auto space{ idleRead ? std::span<char>{ idleBuffer } : parser.Prepare() };
+
+        // no timer per read. the idle wheel shuts the receive side down once this has waited too long
+        boost::system::error_code ec;
+        const size_t nBytes{
+            co_await socket.async_read_some(asio::buffer(space.data(), space.size()), asio::redirect_error(ec))
+        };
+        if (idle->Expired())
         {
             LOG_INFO("timed out for {}", tag);
             break;
         }
 
-        size_t nBytes{ std::get<0>(res) };
-        if (nBytes == 0)
+        if (ec or nBytes == 0)
         {
             LOG_INFO("connection to {} most likely closed", tag);
             break;
         }
 
-        std::string strData{ data.begin(), nBytes };
-        if (strData.ends_with('\n'))
+        idle->Touch();
+        if (idleRead)
         {
-            strData.resize(strData.size() - 1);
+            parser.Append({ idleBuffer.data(), nBytes });
         }
+        else
+        {
+            parser.Commit(nBytes);
+        }
+        session->NoteReadBytesHeld(parser.HeldBytes());
+
+        try
+        {
+            while (auto frame{ parser.Next() })
+            {
+                dispatch_frame(*frame, *registry, id, tag);
+            }
+        }
+        catch (const FrameTooLarge& e)
+        {
+            LOG_INFO("dropping {}: {}", tag, e.what());
+            break;
+        }
+    }
+}
 
-        LOG_INFO("client {}: n-bytes: {} says: '{}'. sending it all other clients", tag, nBytes, strData);
+asio::awaitable<void> handle_connection(
+    std::shared_ptr<ClientSession> session,
+    std::shared_ptr<ClientRegistry> registry,
+    std::shared_ptr<FlowGate> gate,
+    std::shared_ptr<IdleWheel> idleWheel,
+    FramingConfig framing,
+    std::chrono::seconds idleTimeout,
+    std::optional<size_t> shardIdx
+)
+{
+    const ConnectionId id{ shardIdx ? co_await registry->Add(session, *shardIdx) : co_await registry->Add(session) };
+    AtScopeExit dropper{ [&registry, id] { registry->Remove(id); } };
 
-        for (auto& [clientTag, client] : *clients)
+    const auto& tag{ session->Tag() };
+    auto& socket{ session->GetStream() };
+    Deadline deadline{ socket.get_executor() };
+    boost::system::error_code ec;
+    co_await deadline.Within(
+        10s,
+        socket.async_handshake(ssl::stream_base::handshake_type::server, asio::deferred),
+        asio::redirect_error(asio::deferred, ec)
+    );
+    if (ec == asio::error::timed_out)
+    {
+        LOG_INFO("handshake timed out for {}", tag);
+        co_await deadline.Within(
+            100ms, socket.async_shutdown(asio::deferred), asio::redirect_error(asio::deferred, ec)
+        );
+        co_return;
+    }
+    if (ec)
+    {
+        throw boost::system::system_error{ ec };
+    }
+
+    if (auto* resumption{ TlsResumption::Of(socket.native_handle()) })
+    {
+        resumption->RecordHandshake(socket.native_handle());
+    }
+    if (auto* kernelTls{ KernelTls::Of(socket.native_handle()) };
+        kernelTls and kernelTls->OffloadTransmit(socket.native_handle(), socket.next_layer().native_handle()))
+    {
+        session->UseKernelTransmit();
+    }
+
+    auto idle{ idleWheel->Watch(
+        idleTimeout,
+        [weak{ std::weak_ptr{ session } }]
         {
-            if (tag != clientTag)
+            if (auto session{ weak.lock() })
             {
-                asio::co_spawn(
-                    client.get_executor(),
-                    client.async_write_some(asio::buffer(data, nBytes), asio::use_awaitable) or timeout(1s),
-                    asio::detached
+                // fails the pending read. the writer and the TLS shutdown still get to use the socket
+                asio::post(
+                    session->GetStream().get_executor(),
+                    [session]
+                    {
+                        boost::system::error_code ec;
+                        session->GetStream().next_layer().shutdown(asio::socket_base::shutdown_receive, ec);
+                    }
                 );
             }
         }
+    ) };
+
+    // whichever side stops first takes the other one down with it
+    co_await (read_loop(session, id, registry, gate, framing, idle) or session->RunWriter());
+
+    auto stats{ session->Stats() };
+    LOG_INFO(
+        "closing {}. dropped {} messages ({} bytes), {} still queued, held up to {} bytes of buffers{}",
+        tag,
+        stats.m_droppedMessages,
+        stats.m_droppedBytes,
+        stats.m_queuedMessages,
+        stats.m_peakHeldBytes,
+        stats.m_evicted ? ". evicted as a slow consumer" : ""
+    );
+    const auto pool{ buffer_pool_stats() };
+    LOG_DEBUG("connections hold {} bytes in {} pooled buffers", pool.m_leasedBytes, pool.m_leasedBuffers);
+
+    // OpenSSL's sequence number for what is sent went stale with the offload
+    if (session->KernelTransmit())
+    {
+        KernelTls::SendCloseNotify(socket.next_layer().native_handle());
+        co_return;
+    }
+    co_await deadline.Within(100ms, socket.async_shutdown(asio::deferred), asio::redirect_error(asio::deferred, ec));
+}
+
+asio::ip::tcp::acceptor make_listener(asio::any_io_executor exc, const asio::ip::tcp::endpoint& ep, bool reusePort)
+{
+    using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+    asio::ip::tcp::acceptor acc{ exc };
+    acc.open(ep.protocol());
+    acc.set_option(asio::socket_base::reuse_address{ true });
+    if (reusePort)
+    {
+        acc.set_option(ReusePort{ true });
     }
+    acc.bind(ep);
+    acc.listen();
 
-    co_await (socket.async_shutdown(asio::use_awaitable) or timeout(100ms));
+    return acc;
 }
 
-asio::awaitable<void> accept_client(ssl::context& sslCctx)
+// With a shardIdx the connections stay on the acceptor's (single threaded) executor and that shard.
+// Without, every connection gets its own strand and is spread over the shards round robin.
+asio::awaitable<void> accept_loop(
+    asio::ip::tcp::acceptor acc,
+    ssl::context& sslCctx,
+    ServerConfig cfg,
+    std::shared_ptr<ClientRegistry> registry,
+    std::shared_ptr<FlowGate> gate,
+    std::shared_ptr<IdleWheel> idleWheel,
+    std::optional<size_t> shardIdx
+)
 {
-    auto exc{ co_await asio::this_coro::executor };
-    asio::ip::tcp::resolver resolver{ exc };
-    auto resolve_res = co_await resolver.async_resolve("localhost", "8080", asio::ip::resolver_base::v4_mapped);
-    asio::ip::tcp::acceptor acc{ exc, resolve_res.begin()->endpoint() };
     const auto ep{ acc.local_endpoint() };
 
-    SharedClientsMap clients{ std::make_shared<ClientsMap>() };
-
     while (true)
     {
         LOG_INFO("accepting {}:{}", ep.address().to_string(), ep.port());
 
-        auto socket{ co_await acc.async_accept() };
+        // a strand keeps the connection's reader, writer and wakeups from running concurrently
+        asio::any_io_executor connExc{ acc.get_executor() };
+        if (not shardIdx)
+        {
+            connExc = asio::make_strand(acc.get_executor());
+        }
+
+        asio::ip::tcp::socket socket{ co_await acc.async_accept(connExc) };
         std::string tag{ socket.remote_endpoint().address().to_string() + ":" +
                          std::to_string(socket.remote_endpoint().port()) };
 
         LOG_INFO("accepted {}:{} -> {}", ep.address().to_string(), ep.port(), tag);
 
-        ssl::stream<asio::ip::tcp::socket> stream{ std::move(socket), sslCctx };
-        clients->emplace(tag, std::move(stream));
-        asio::co_spawn(acc.get_executor(), handle_connection(tag, clients), asio::detached);
+        auto session{ std::make_shared<ClientSession>(
+            tag, ssl::stream<asio::ip::tcp::socket>{ std::move(socket), sslCctx }, cfg.m_outbound, gate
+        ) };
+        if (cfg.m_releaseTlsBuffers)
+        {
+            // OpenSSL frees its record buffers whenever they're empty instead of keeping them for the next record
+            SSL_set_mode(session->GetStream().native_handle(), SSL_MODE_RELEASE_BUFFERS);
+        }
+        asio::co_spawn(
+            session->GetStream().get_executor(),
+            handle_connection(session, registry, gate, idleWheel, cfg.m_framing, cfg.m_idleTimeout, shardIdx),
+            asio::detached
+        );
     }
 }
+
+asio::awaitable<void>
+accept_client(ssl::context& sslCctx, ServerConfig cfg, std::vector<asio::any_io_executor> workerExecutors)
+{
+    auto exc{ co_await asio::this_coro::executor };
+    asio::ip::tcp::resolver resolver{ exc };
+    auto resolve_res =
+        co_await resolver.async_resolve(cfg.m_listenHost, cfg.m_listenPort, asio::ip::resolver_base::v4_mapped);
+    const auto ep{ resolve_res.begin()->endpoint() };
+
+    // producers only ever wait on this when the room is configured to pause them
+    std::shared_ptr<FlowGate> gate{};
+    if (cfg.m_outbound.m_policy == SlowConsumerPolicy::PauseProducers)
+    {
+        gate = std::make_shared<FlowGate>();
+    }
+
+    // one wheel for every connection, whichever worker they're on
+    auto idleWheel{ std::make_shared<IdleWheel>(IDLE_TICK) };
+    asio::co_spawn(asio::make_strand(exc), idleWheel->Run(), detached_log_exception{ Sage::Logger::Level::Error });
+
+    if (cfg.m_reusePort and not workerExecutors.empty())
+    {
+        // every worker listens on the same endpoint and the kernel spreads connections between them.
+        // a connection is then handled, and registered, on the worker that accepted it
+        auto registry{ std::make_shared<ClientRegistry>(workerExecutors) };
+        for (size_t idx{ 0 }; idx < workerExecutors.size(); idx++)
+        {
+            asio::co_spawn(
+                workerExecutors[idx],
+                accept_loop(
+                    make_listener(workerExecutors[idx], ep, true),
+                    sslCctx,
+                    cfg,
+                    registry,
+                    gate,
+                    idleWheel,
+                    idx
+                ),
+                detached_log_exception{ Sage::Logger::Level::Error }
+            );
+        }
+        co_return;
+    }
+
+    // each shard is a strand, so fan-out runs on as many threads as there are shards
+    const size_t nShards{ cfg.m_shards ? cfg.m_shards : std::max<size_t>(std::thread::hardware_concurrency(), 1) };
+    std::vector<asio::any_io_executor> shardExecutors(std::min(nShards, ClientRegistry::MAX_SHARDS));
+    for (auto& shardExc : shardExecutors)
+    {
+        shardExc = asio::make_strand(exc);
+    }
+    auto registry{ std::make_shared<ClientRegistry>(std::move(shardExecutors)) };
+
+    co_await accept_loop(make_listener(exc, ep, false), sslCctx, cfg, registry, gate, idleWheel, std::nullopt);
+}
@@ -1,5 +1,13 @@
 #pragma once
 
 #include "async_aliases.hpp"
+#include "server_config.hpp"
+#include <vector>
 
-asio::awaitable<void> accept_client(ssl::context& sslCctx);
+// workerExecutors are only used with ServerConfig::m_reusePort, one listener is opened on each of them.
+// They must be single threaded.
+asio::awaitable<void> accept_client(
+    ssl::context& sslCctx,
+    ServerConfig cfg,
+    std::vector<asio::any_io_executor> workerExecutors = {}
+);
@@ -0,0 +1,260 @@
+#include "tls_resumption.hpp"
+#include "log/logger.hpp"
+#include <algorithm>
+#include <ctime>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/rand.h>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+
+int ExDataIndex()
+{
+    static const int idx{ SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr) };
+    return idx;
+}
+
+bool SetTicketMacKey(EVP_MAC_CTX* macCtx, std::array<unsigned char, 32>& key)
+{
+    std::array params{
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.data(), key.size()),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("sha256"), 0),
+        OSSL_PARAM_construct_end(),
+    };
+    return EVP_MAC_CTX_set_params(macCtx, params.data()) == 1;
+}
+
+bool NotExpired(const SSL_SESSION* session)
+{
+    return SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) > std::time(nullptr);
+}
+
+} // namespace
+
+TlsResumption::TlsResumption(ssl::context& ctx) :
+    m_ctx{ ctx.native_handle() },
+    m_currentKey{ GenerateTicketKey() }
+{
+    // resuming while client certs are requested fails without a session id context
+    constexpr std::string_view SESSION_ID_CONTEXT{ "cpp-coro" };
+    SSL_CTX_set_session_id_context(
+        m_ctx,
+        reinterpret_cast<const unsigned char*>(SESSION_ID_CONTEXT.data()),
+        static_cast<unsigned int>(SESSION_ID_CONTEXT.size())
+    );
+
+    SSL_CTX_set_ex_data(m_ctx, ExDataIndex(), this);
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(m_ctx, &TlsResumption::TicketKeyCallback);
+    // stateless tickets on the server and our own per host store on the client
+    SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_BOTH | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(m_ctx, &TlsResumption::NewSessionCallback);
+    SSL_CTX_set_max_early_data(m_ctx, 0);
+}
+
+TlsResumption::~TlsResumption()
+{
+    SSL_CTX_sess_set_new_cb(m_ctx, nullptr);
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(m_ctx, nullptr);
+    SSL_CTX_set_ex_data(m_ctx, ExDataIndex(), nullptr);
+}
+
+TlsResumption* TlsResumption::Of(SSL* ssl) noexcept
+{
+    return static_cast<TlsResumption*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ExDataIndex()));
+}
+
+void TlsResumption::RotateTicketKeys()
+{
+    auto next{ GenerateTicketKey() };
+
+    std::lock_guard lk{ m_keysMutex };
+    m_previousKey = std::exchange(m_currentKey, next);
+}
+
+void TlsResumption::OfferSession(SSL* ssl, const std::string& host)
+{
+    SessionPtr session{};
+    {
+        std::lock_guard lk{ m_sessionsMutex };
+        if (auto it{ m_sessions.find(host) }; it != m_sessions.end())
+        {
+            // newest first. anything the server would refuse anyway is thrown away
+            auto& tickets{ it->second };
+            while (not tickets.empty() and not session)
+            {
+                SessionPtr candidate{ std::move(tickets.back()) };
+                tickets.pop_back();
+                if (SSL_SESSION_is_resumable(candidate.get()) and NotExpired(candidate.get()))
+                {
+                    session = std::move(candidate);
+                }
+            }
+        }
+    }
+
+    // tickets are single use, SSL_set_session takes its own reference
+    if (session and SSL_set_session(ssl, session.get()) == 1)
+    {
+        m_clientCacheHits.fetch_add(1, std::memory_order::relaxed);
+    }
+    else
+    {
+        m_clientCacheMisses.fetch_add(1, std::memory_order::relaxed);
+    }
+}
+
+void TlsResumption::RecordHandshake(SSL* ssl) noexcept
+{
+    const bool resumed{ SSL_session_reused(ssl) == 1 };
+    if (SSL_is_server(ssl))
+    {
+        (resumed ? m_serverResumed : m_serverFull).fetch_add(1, std::memory_order::relaxed);
+    }
+    else
+    {
+        (resumed ? m_clientResumed : m_clientFull).fetch_add(1, std::memory_order::relaxed);
+    }
+}
+
+TlsResumptionStats TlsResumption::Stats() const noexcept
+{
+    return TlsResumptionStats{
+        .m_serverResumed = m_serverResumed.load(std::memory_order::relaxed),
+        .m_serverFull = m_serverFull.load(std::memory_order::relaxed),
+        .m_serverTicketKeyMisses = m_serverTicketKeyMisses.load(std::memory_order::relaxed),
+        .m_clientCacheHits = m_clientCacheHits.load(std::memory_order::relaxed),
+        .m_clientCacheMisses = m_clientCacheMisses.load(std::memory_order::relaxed),
+        .m_clientResumed = m_clientResumed.load(std::memory_order::relaxed),
+        .m_clientFull = m_clientFull.load(std::memory_order::relaxed),
+    };
+}
+
+int TlsResumption::TicketKeyCallback(
+    SSL* ssl,
+    unsigned char* keyName,
+    unsigned char* iv,
+    EVP_CIPHER_CTX* cipherCtx,
+    EVP_MAC_CTX* macCtx,
+    int encrypt
+)
+{
+    auto* self{ Of(ssl) };
+    if (not self)
+    {
+        return -1;
+    }
+
+    std::lock_guard lk{ self->m_keysMutex };
+    if (encrypt)
+    {
+        auto& key{ self->m_currentKey };
+        if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) != 1)
+        {
+            return -1;
+        }
+
+        std::ranges::copy(key.m_name, keyName);
+        if (EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key.m_aesKey.data(), iv) != 1 or
+            not SetTicketMacKey(macCtx, key.m_hmacKey))
+        {
+            return -1;
+        }
+        return 1;
+    }
+
+    // 2 asks OpenSSL to re-issue the ticket under the current key
+    int found{ 1 };
+    TicketKey* key{ nullptr };
+    if (std::ranges::equal(self->m_currentKey.m_name, std::span{ keyName, 16 }))
+    {
+        key = &self->m_currentKey;
+    }
+    else if (self->m_previousKey and std::ranges::equal(self->m_previousKey->m_name, std::span{ keyName, 16 }))
+    {
+        key = &*self->m_previousKey;
+        found = 2;
+    }
+
+    if (not key)
+    {
+        self->m_serverTicketKeyMisses.fetch_add(1, std::memory_order::relaxed);
+        return 0;
+    }
+
+    if (EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key->m_aesKey.data(), iv) != 1 or
+        not SetTicketMacKey(macCtx, key->m_hmacKey))
+    {
+        return -1;
+    }
+
+    return found;
+}
+
+int TlsResumption::NewSessionCallback(SSL* ssl, SSL_SESSION* session)
+{
+    auto* self{ Of(ssl) };
+    const char* host{ SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name) };
+    // 0 leaves the reference with OpenSSL
+    if (not self or SSL_is_server(ssl) or not host)
+    {
+        return 0;
+    }
+
+    std::lock_guard lk{ self->m_sessionsMutex };
+    if (self->m_sessions.size() >= MAX_CACHED_HOSTS and not self->m_sessions.contains(host))
+    {
+        self->m_sessions.erase(self->m_sessions.begin());
+    }
+
+    auto& tickets{ self->m_sessions[host] };
+    tickets.emplace_back(session);
+    if (tickets.size() > MAX_TICKETS_PER_HOST)
+    {
+        tickets.pop_front();
+    }
+
+    return 1;
+}
+
+TlsResumption::TicketKey TlsResumption::GenerateTicketKey()
+{
+    TicketKey key{};
+    if (RAND_bytes(key.m_name.data(), static_cast<int>(key.m_name.size())) != 1 or
+        RAND_bytes(key.m_aesKey.data(), static_cast<int>(key.m_aesKey.size())) != 1 or
+        RAND_bytes(key.m_hmacKey.data(), static_cast<int>(key.m_hmacKey.size())) != 1)
+    {
+        throw std::runtime_error("failed to generate a session ticket key");
+    }
+
+    return key;
+}
+
+asio::awaitable<void> rotate_ticket_keys(TlsResumption& resumption, std::chrono::steady_clock::duration interval)
+{
+    asio::steady_timer timer{ co_await asio::this_coro::executor };
+    while (true)
+    {
+        timer.expires_after(interval);
+        co_await timer.async_wait();
+
+        resumption.RotateTicketKeys();
+
+        auto stats{ resumption.Stats() };
+        LOG_INFO(
+            "rotated tls ticket keys. server resumed: {} full: {} key misses: {}. "
+            "client cache hits: {} misses: {} resumed: {} full: {}",
+            stats.m_serverResumed,
+            stats.m_serverFull,
+            stats.m_serverTicketKeyMisses,
+            stats.m_clientCacheHits,
+            stats.m_clientCacheMisses,
+            stats.m_clientResumed,
+            stats.m_clientFull
+        );
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "async_aliases.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+struct TlsResumptionStats
+{
+    size_t m_serverResumed;
+    size_t m_serverFull;
+    // an unknown or expired ticket key forces a full handshake
+    size_t m_serverTicketKeyMisses;
+    size_t m_clientCacheHits;
+    size_t m_clientCacheMisses;
+    size_t m_clientResumed;
+    size_t m_clientFull;
+};
+
+// Session resumption for both roles of one ssl::context.
+// Server: TLS 1.3 tickets sealed with in-process keys that RotateTicketKeys() replaces. The previous key is kept
+// for one more rotation so outstanding tickets still resume and get re-issued under the new key.
+// Client: tickets received per host, each offered once on a later connection to that host.
+//
+// 0-RTT stays off. The chat protocol broadcasts every message so a replay is visible to the whole room, and
+// ssl::stream has no early data write path for the idempotent HTTP GETs.
+class TlsResumption
+{
+public:
+    // tickets kept per host. the server hands out two per connection
+    static constexpr size_t MAX_TICKETS_PER_HOST{ 8 };
+    static constexpr size_t MAX_CACHED_HOSTS{ 1024 };
+
+    // Must outlive every connection made with ctx
+    explicit TlsResumption(ssl::context& ctx);
+
+    ~TlsResumption();
+
+    // nullptr when ssl's context has none installed
+    static TlsResumption* Of(SSL* ssl) noexcept;
+
+    void RotateTicketKeys();
+
+    // Client side. Call after SNI is set and before the handshake
+    void OfferSession(SSL* ssl, const std::string& host);
+
+    // Either side. Call once the handshake has completed
+    void RecordHandshake(SSL* ssl) noexcept;
+
+    TlsResumptionStats Stats() const noexcept;
+
+private:
+    TlsResumption(const TlsResumption&) = delete;
+    TlsResumption(TlsResumption&&) = delete;
+    TlsResumption& operator=(const TlsResumption&) = delete;
+    TlsResumption& operator=(TlsResumption&&) = delete;
+
+    struct TicketKey
+    {
+        std::array<unsigned char, 16> m_name;
+        std::array<unsigned char, 32> m_aesKey;
+        std::array<unsigned char, 32> m_hmacKey;
+    };
+
+    struct SessionFree
+    {
+        void operator()(SSL_SESSION* session) const noexcept { SSL_SESSION_free(session); }
+    };
+
+    using SessionPtr = std::unique_ptr<SSL_SESSION, SessionFree>;
+
+    static int TicketKeyCallback(
+        SSL* ssl,
+        unsigned char* keyName,
+        unsigned char* iv,
+        EVP_CIPHER_CTX* cipherCtx,
+        EVP_MAC_CTX* macCtx,
+        int encrypt
+    );
+
+    static int NewSessionCallback(SSL* ssl, SSL_SESSION* session);
+
+    static TicketKey GenerateTicketKey();
+
+    SSL_CTX* m_ctx;
+
+    std::mutex m_keysMutex{};
+    TicketKey m_currentKey{};
+    std::optional<TicketKey> m_previousKey{};
+
+    std::mutex m_sessionsMutex{};
+    std::unordered_map<std::string, std::deque<SessionPtr>> m_sessions{};
+
+    std::atomic<size_t> m_serverResumed{ 0 };
+    std::atomic<size_t> m_serverFull{ 0 };
+    std::atomic<size_t> m_serverTicketKeyMisses{ 0 };
+    std::atomic<size_t> m_clientCacheHits{ 0 };
+    std::atomic<size_t> m_clientCacheMisses{ 0 };
+    std::atomic<size_t> m_clientResumed{ 0 };
+    std::atomic<size_t> m_clientFull{ 0 };
+};
+
+// Rotates the ticket keys every interval and logs the resumption counters
+asio::awaitable<void> rotate_ticket_keys(TlsResumption& resumption, std::chrono::steady_clock::duration interval);
@@ -8,3 +8,33 @@ asio::awaitable<void> timeout(const std::chrono::steady_clock::duration& timeout
     timer.expires_after(timeout);
     co_await timer.async_wait();
 }
+
+std::optional<std::string_view> find_arg(std::span<char* const> args, std::string_view name)
+{
+    for (std::string_view arg : args.subspan(args.empty() ? 0 : 1))
+    {
+        if (not arg.starts_with("--"))
+        {
+            continue;
+        }
+
+        arg.remove_prefix(2);
+        if (not arg.starts_with(name))
+        {
+            continue;
+        }
+
+        arg.remove_prefix(name.size());
+        if (arg.empty())
+        {
+            return arg;
+        }
+
+        if (arg.front() == '=')
+        {
+            return arg.substr(1);
+        }
+    }
+
+    return std::nullopt;
+}
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "async_aliases.hpp"
+#include <charconv>
 #include <chrono>
 #include <concepts>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
 
 asio::awaitable<void> timeout(const std::chrono::steady_clock::duration& ms);
 
@@ -14,3 +20,30 @@ template<std::invocable<> Func> struct AtScopeExit final
 
     Func m_exitCb;
 };
+
+// Value of a "--name=value" command line argument. A bare "--name" yields an empty value
+std::optional<std::string_view> find_arg(std::span<char* const> args, std::string_view name);
+
+template<typename T> T arg_or(std::span<char* const> args, std::string_view name, T fallback)
+{
+    auto value{ find_arg(args, name) };
+    if (not value)
+    {
+        return fallback;
+    }
+
+    if constexpr (std::same_as<T, bool>)
+    {
+        return value->empty() or *value == "1" or *value == "true";
+    }
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+        T out{};
+        auto [_, ec] = std::from_chars(value->data(), value->data() + value->size(), out);
+        return ec == std::errc{} ? out : fallback;
+    }
+    else
+    {
+        return T{ *value };
+    }
+}